@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+
+// Where frames go: a GLFW window, or a headless EGL context that renders into an FBO.
+// Headless uses EGL_MESA_platform_surfaceless, so it needs no window system and no GPU (Mesa's
+// llvmpipe will do) and never calls into GLFW. The render loop gets everything it used to ask
+// GLFW for (time, events, framebuffer size, swaps, the context) from here.
+class Display {
+public:
+    Display() = default;
+    ~Display();
+    Display(const Display&) = delete;
+    Display& operator=(const Display&) = delete;
+
+    // Both create a GL 3.3 core context and make it current. Return false (after printing why)
+    // on failure. createHeadless also needs a build with EGL (HAVE_EGL).
+    bool createWindow(int width, int height, const char* title);
+    bool createHeadless(int width, int height);
+    void destroy();
+
+    bool headless() const { return window == nullptr && headlessContext != nullptr; }
+    GLFWwindow* glfwWindow() const { return window; } // nullptr when headless
+    GLADloadproc loader() const;
+    // What "the screen" is: 0 for the window, the offscreen target when headless
+    GLuint framebuffer() const { return fbo; }
+
+    // Seconds since the display was created
+    double time() const;
+    bool shouldClose() const;
+    void close();
+    void pollEvents();
+    // Blocks until an event arrives or timeout seconds pass (0 just polls). Headless there are no events, it
+    // just sleeps.
+    void waitEvents(double timeout);
+    // GLFW key codes, always up when headless
+    bool keyDown(int key) const;
+    void framebufferSize(int& width, int& height) const;
+    void swapBuffers();
+    void setSwapInterval(int interval);
+    // Binds the context to the calling thread, or releases it
+    void makeCurrent(bool current);
+
+    // The last finished frame as a binary PPM. Call after the swap, with the context current.
+    bool saveScreenshot(const char* path);
+
+private:
+    GLFWwindow* window = nullptr;
+    void* headlessDisplay = nullptr;  // EGLDisplay/EGLContext, kept out of the header
+    void* headlessContext = nullptr;
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    int width = 0, height = 0;
+    bool closeRequested = false;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <ostream>
+
+// Decides when the on-demand loop has to draw. Whatever changes the picture (input, a resize, the
+// window system asking for a repaint, a reloaded shader) marks the frame dirty, animations keep it
+// drawing every frame until they end. The rest of the time the loop sleeps in waitEvents(), waking
+// at least every pollInterval seconds to look for changed files.
+class RedrawScheduler {
+public:
+    explicit RedrawScheduler(double pollInterval = 0.5) : pollInterval(pollInterval) {}
+
+    void markDirty() { dirty = true; }
+    void animateUntil(double time);
+    bool animating(double now) const { return now < animationEnd; }
+    bool needsFrame(double now) const { return dirty || animating(now); }
+    // A frame drawn mid-animation leaves it dirty, so the first frame after the animation ends
+    // still gets drawn and the picture settles on its final state
+    void frameDrawn(double now) { dirty = animating(now); }
+    // How long the loop may block waiting for events, 0 when there is something to draw
+    double waitTimeout(double now) const;
+
+private:
+    double pollInterval;
+    double animationEnd = 0.0;
+    bool dirty = true; // the first frame
+};
+
+// Where the loop's time, CPU time and frames go, split into active (the picture changes) and idle
+// (nothing changes, whether the loop draws anyway or sleeps). CPU time is the whole process's.
+class ActivityMeter {
+public:
+    ActivityMeter();
+
+    // Closes the span since the last call (or since the start) and books it
+    void add(bool active, int frames);
+    bool reportDue(double interval) const;
+    // CPU use and frames per minute of both states since the last report
+    void report(std::ostream& out);
+
+private:
+    struct State {
+        double wall = 0.0, cpu = 0.0;
+        int frames = 0;
+    };
+
+    std::chrono::steady_clock::time_point spanStart, reportStart;
+    std::clock_t cpuStart;
+    State idle, active;
+};
+
+// Last modification time of a file, -1 when it can't be read
+long long fileModifiedTime(const char* path);
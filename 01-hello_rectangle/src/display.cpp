@@ -0,0 +1,241 @@
+#include "../include/utilities/display.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+
+#ifdef HAVE_EGL
+void* eglLoader(const char* name) {
+    return (void*)eglGetProcAddress(name);
+}
+#endif
+
+} // namespace
+
+Display::~Display() {
+    destroy();
+}
+
+bool Display::createWindow(int w, int h, const char* title) {
+    glfwInit();
+    // OpenGL version 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // If on macOS...
+# ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    window = glfwCreateWindow(w, h, title, nullptr, nullptr);
+    if (window == nullptr) {
+        // If unable to create the window...
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    width = w;
+    height = h;
+    epoch = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool Display::createHeadless(int w, int h) {
+#ifdef HAVE_EGL
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (getPlatformDisplay && extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    else {
+        // Not Mesa: the default display still works if it can do surfaceless contexts
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cout << "Failed to initialize EGL (error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return false;
+    }
+    const char* displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!displayExtensions || !strstr(displayExtensions, "EGL_KHR_surfaceless_context") ||
+        (major == 1 && minor < 5 && !strstr(displayExtensions, "EGL_KHR_create_context"))) {
+        std::cout << "Failed to create a headless context: EGL " << major << "." << minor
+                  << " without surfaceless or core profile contexts" << std::endl;
+        eglTerminate(display);
+        return false;
+    }
+
+    // No surface type: the default asks for window surfaces, there won't be any
+    EGLint configAttributes[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configs = 0;
+    eglBindAPI(EGL_OPENGL_API);
+    eglChooseConfig(display, configAttributes, &config, 1, &configs);
+    EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                  EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context = configs > 0 ? eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes) : EGL_NO_CONTEXT;
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "Failed to create a GL 3.3 core context (EGL error 0x" << std::hex << eglGetError() << std::dec
+                  << ")" << std::endl;
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+    headlessDisplay = display;
+    headlessContext = context;
+    width = w;
+    height = h;
+
+    // There's no default framebuffer, frames go into this one. Needs glad for the GL calls.
+    if (!gladLoadGLLoader(eglLoader)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        destroy();
+        return false;
+    }
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Failed to create the " << width << "x" << height << " offscreen framebuffer" << std::endl;
+        destroy();
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    epoch = std::chrono::steady_clock::now();
+    return true;
+#else
+    (void)w;
+    (void)h;
+    std::cout << "Failed to create a headless context: built without EGL" << std::endl;
+    return false;
+#endif
+}
+
+void Display::destroy() {
+    if (window) {
+        glfwTerminate();
+        window = nullptr;
+    }
+#ifdef HAVE_EGL
+    if (headlessContext) {
+        EGLDisplay display = (EGLDisplay)headlessDisplay;
+        if (eglGetCurrentContext() == (EGLContext)headlessContext) {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+        }
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, (EGLContext)headlessContext);
+        eglTerminate(display);
+        headlessContext = headlessDisplay = nullptr;
+    }
+#endif
+    fbo = colorBuffer = depthBuffer = 0;
+}
+
+GLADloadproc Display::loader() const {
+#ifdef HAVE_EGL
+    if (headless()) return eglLoader;
+#endif
+    return (GLADloadproc)glfwGetProcAddress;
+}
+
+double Display::time() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+bool Display::shouldClose() const {
+    return closeRequested || (window && glfwWindowShouldClose(window));
+}
+
+void Display::close() {
+    closeRequested = true;
+}
+
+void Display::pollEvents() {
+    if (window) glfwPollEvents();
+}
+
+void Display::waitEvents(double timeout) {
+    // GLFW wants a positive timeout
+    if (timeout <= 0.0) pollEvents();
+    else if (window) glfwWaitEventsTimeout(timeout);
+    else std::this_thread::sleep_for(std::chrono::duration<double>(timeout));
+}
+
+bool Display::keyDown(int key) const {
+    return window && glfwGetKey(window, key) == GLFW_PRESS;
+}
+
+void Display::framebufferSize(int& w, int& h) const {
+    if (window) {
+        glfwGetFramebufferSize(window, &w, &h);
+        return;
+    }
+    w = width;
+    h = height;
+}
+
+void Display::swapBuffers() {
+    if (window) glfwSwapBuffers(window);
+    // Nothing to present, but hand the frame to the driver like a swap would
+    else glFlush();
+}
+
+void Display::setSwapInterval(int interval) {
+    if (window) glfwSwapInterval(interval);
+}
+
+void Display::makeCurrent(bool current) {
+    if (window) {
+        glfwMakeContextCurrent(current ? window : nullptr);
+        return;
+    }
+#ifdef HAVE_EGL
+    if (headlessContext) {
+        eglMakeCurrent((EGLDisplay)headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       current ? (EGLContext)headlessContext : EGL_NO_CONTEXT);
+    }
+#endif
+}
+
+bool Display::saveScreenshot(const char* path) {
+    int w, h;
+    framebufferSize(w, h);
+    std::vector<unsigned char> pixels((size_t)w * h * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    // The window's new back buffer is undefined after the swap, the frame is in the front one
+    glReadBuffer(fbo ? GL_COLOR_ATTACHMENT0 : GL_FRONT);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        std::cout << "Failed to write the screenshot " << path << std::endl;
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", w, h);
+    // GL rows go bottom-up, PPM top-down
+    for (int y = h - 1; y >= 0; --y) fwrite(&pixels[(size_t)y * w * 3], 1, (size_t)w * 3, file);
+    return fclose(file) == 0;
+}
@@ -4,64 +4,44 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <string>
 
+#include "utilities/display.h"
+#include "utilities/redraw.h"
 #include "utilities/utilities.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
+const char* vertexShaderPath = "../assets/vertex_core.glsl";
+const char* fragmentShaderPath = "../assets/fragment_core.glsl";
+// How long the space bar flash lasts, how often the shader files are checked for changes
+const double kFlashTime = 0.5;
+const double kFileCheckInterval = 0.5;
 
+// What the window callbacks can reach, through the window's user pointer
+struct WindowEvents {
+    RedrawScheduler* redraw = nullptr;
+    bool flash = false; // space was pressed
+};
 
-
-int main(){
-
+// Compiles and links the two shaders, 0 if anything failed (the reason is printed)
+unsigned int createShaderProgram(const char* vertexPath, const char* fragmentPath) {
     int success;
     char info[512];
 
-    glfwInit();
-    // OpenGL version 3.3
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    // If on macOS...
-# ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Hello World!", nullptr, nullptr);
-    if (window == nullptr) {
-        // If unable to create the window...
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-
-    // Where to locate the window? how big?
-    glViewport(0, 0, 800, 600);
-
-    // If I resize the window, add a callback
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
     // Shaders
     // Compile vertex shader
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    std::string vertexShaderSource = loadShaderSrc("../assets/vertex_core.glsl");
+    std::string vertexShaderSource = loadShaderSrc(vertexPath);
     const GLchar* vShaderSource = vertexShaderSource.c_str();
     glShaderSource(vertexShader, 1, &vShaderSource, nullptr);
     glCompileShader(vertexShader);
 
     // Catch if an error happens -> is everything going according to plan?
-    // Note that success is an integer defined at the start of the main function
     glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
     if (!success) {
         glGetShaderInfoLog(vertexShader, 512, nullptr, info);
@@ -70,7 +50,7 @@ int main(){
 
     // Compile fragment shader
     unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    std::string fragmentShaderSource = loadShaderSrc("../assets/fragment_core.glsl");
+    std::string fragmentShaderSource = loadShaderSrc(fragmentPath);
     const GLchar* pShaderSource = fragmentShaderSource.c_str();
     glShaderSource(fragmentShader, 1, &pShaderSource, nullptr);
     glCompileShader(fragmentShader);
@@ -91,11 +71,84 @@ int main(){
     if (!success) {
         glGetProgramInfoLog(shaderProgram, 512, nullptr, info);
         std::cout << "Error linking shader program: " << info << std::endl;
+        glDeleteProgram(shaderProgram);
+        shaderProgram = 0;
     }
 
     // Cleaning stuff
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    return shaderProgram;
+}
+
+int main(int argc, char** argv){
+
+    // --headless: no window, render into an offscreen framebuffer through EGL (works without a display)
+    // --frames <n>: quit after n frames, --screenshot <file>: write the last one to file (PPM)
+    // --on-demand: only draw when something changed, --stats: CPU use and frames/min, idle vs active
+    // --seconds <s>: quit after s seconds
+    bool headless = false, onDemand = false, stats = false;
+    int maxFrames = 0;
+    double maxSeconds = 0.0;
+    const char* screenshotPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) maxFrames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc) screenshotPath = argv[++i];
+        else if (strcmp(argv[i], "--on-demand") == 0) onDemand = true;
+        else if (strcmp(argv[i], "--stats") == 0) stats = true;
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) maxSeconds = atof(argv[++i]);
+        else {
+            std::cout << "Usage: " << argv[0] << " [--headless] [--frames n] [--screenshot file.ppm] [--on-demand]"
+                      << " [--stats] [--seconds s]" << std::endl;
+            return -1;
+        }
+    }
+
+    // The window (GLFW, OpenGL 3.3 core), or the offscreen framebuffer
+    Display display;
+    if (!(headless ? display.createHeadless(800, 600) : display.createWindow(800, 600, "Hello World!"))) {
+        return -1;
+    }
+
+    if (!gladLoadGLLoader(display.loader())) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        display.destroy();
+        return -1;
+    }
+
+    // Where to locate the window? how big?
+    glViewport(0, 0, 800, 600);
+
+    // Everything that changes the picture marks the frame dirty, with --on-demand nothing else is drawn
+    RedrawScheduler redraw(kFileCheckInterval);
+    WindowEvents events;
+    events.redraw = &redraw;
+    if (GLFWwindow* window = display.glfwWindow()) {
+        glfwSetWindowUserPointer(window, &events);
+        // If I resize the window, add a callback
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int width, int height) {
+            framebuffer_size_callback(w, width, height);
+            ((WindowEvents*)glfwGetWindowUserPointer(w))->redraw->markDirty();
+        });
+        // The window system lost the picture (uncovered, restored...) and wants it again
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) {
+            ((WindowEvents*)glfwGetWindowUserPointer(w))->redraw->markDirty();
+        });
+        glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int, int action, int) {
+            WindowEvents* events = (WindowEvents*)glfwGetWindowUserPointer(w);
+            events->redraw->markDirty();
+            if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) events->flash = true;
+        });
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int, int, int) {
+            ((WindowEvents*)glfwGetWindowUserPointer(w))->redraw->markDirty();
+        });
+        glfwSetScrollCallback(window, [](GLFWwindow* w, double, double) {
+            ((WindowEvents*)glfwGetWindowUserPointer(w))->redraw->markDirty();
+        });
+    }
+
+    unsigned int shaderProgram = createShaderProgram(vertexShaderPath, fragmentShaderPath);
 
     // Vertex array -> uses Normalize Device Coordinate.
     // Bottom left is (-1,-1), Top right is (1,1). So (0,0) is the center
@@ -167,37 +220,85 @@ int main(){
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    while (!glfwWindowShouldClose(window)) {
+    long long shaderTimes[2] = {fileModifiedTime(vertexShaderPath), fileModifiedTime(fragmentShaderPath)};
+    double lastFileCheck = 0.0, flashStart = 0.0;
+    ActivityMeter meter;
+    int frame = 0;
+    while (!display.shouldClose()) {
+        // The rectangle never moves by itself: with --on-demand, sleep until an event arrives, an animation
+        // runs or it's time to look at the files again. The wait is idle time, nothing was changing.
+        if (onDemand) display.waitEvents(redraw.waitTimeout(display.time()));
+        else display.pollEvents();
+        meter.add(false, 0);
+
         // Process inputs
-        processInput(window);
-
-        // render some colors
-        glClearColor(0.2f, 0.3f, 0.5f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // draw shapes
-        // Which VAO should I look at?
-        glBindVertexArray(VAO);
-        // Which program?
-        glUseProgram(shaderProgram);
-
-        //glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // The gpu generate the next frame at the same time we are showing the current frame.
-        // So everytime I generate a new frame, swap so it can be shown
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-        // A single buffer would cause flickering, because you are showing a frame that is being generated.
-        // Using a double buffer like so, we avoid this issue because the generation can finish properly before displaying
-        // the new frame
+        if (display.glfwWindow()) processInput(display.glfwWindow());
+        double now = display.time();
+        if (events.flash) {
+            events.flash = false;
+            flashStart = now;
+            redraw.animateUntil(now + kFlashTime);
+        }
+
+        // Edited shaders are rebuilt on the fly, a broken one keeps the old program
+        if (now - lastFileCheck >= kFileCheckInterval) {
+            lastFileCheck = now;
+            long long times[2] = {fileModifiedTime(vertexShaderPath), fileModifiedTime(fragmentShaderPath)};
+            if (times[0] != shaderTimes[0] || times[1] != shaderTimes[1]) {
+                shaderTimes[0] = times[0];
+                shaderTimes[1] = times[1];
+                unsigned int program = createShaderProgram(vertexShaderPath, fragmentShaderPath);
+                if (program) {
+                    glDeleteProgram(shaderProgram);
+                    shaderProgram = program;
+                    redraw.markDirty();
+                    std::cout << "Reloaded the shaders" << std::endl;
+                }
+            }
+        }
+
+        bool changed = redraw.needsFrame(now);
+        bool draw = changed || !onDemand;
+        if (draw) {
+            // render some colors (space flashes the background)
+            glm::vec3 background(0.2f, 0.3f, 0.5f);
+            if (redraw.animating(now)) background = glm::mix(glm::vec3(0.9f), background, (float)((now - flashStart) / kFlashTime));
+            glClearColor(background.x, background.y, background.z, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // draw shapes
+            // Which VAO should I look at?
+            glBindVertexArray(VAO);
+            // Which program?
+            glUseProgram(shaderProgram);
+
+            //glDrawArrays(GL_TRIANGLES, 0, 6);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+            // The gpu generate the next frame at the same time we are showing the current frame.
+            // So everytime I generate a new frame, swap so it can be shown
+            display.swapBuffers();
+            // A single buffer would cause flickering, because you are showing a frame that is being generated.
+            // Using a double buffer like so, we avoid this issue because the generation can finish properly before displaying
+            // the new frame
+            redraw.frameDrawn(now);
+            ++frame;
+        }
+        meter.add(changed, draw ? 1 : 0);
+        if (stats && meter.reportDue(10.0)) meter.report(std::cout);
+        if (maxFrames > 0 && frame >= maxFrames) display.close();
+        if (maxSeconds > 0.0 && now >= maxSeconds) display.close();
+    }
+    if (stats) meter.report(std::cout);
+    if (screenshotPath && display.saveScreenshot(screenshotPath)) {
+        std::cout << "Wrote the last frame to " << screenshotPath << std::endl;
     }
 
     // delete stuff
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glfwTerminate();
+    display.destroy();
     return 0;
 }
 
@@ -0,0 +1,56 @@
+#include "../include/utilities/redraw.h"
+
+#include <algorithm>
+#include <sys/stat.h>
+
+void RedrawScheduler::animateUntil(double time) {
+    animationEnd = std::max(animationEnd, time);
+}
+
+double RedrawScheduler::waitTimeout(double now) const {
+    return needsFrame(now) ? 0.0 : pollInterval;
+}
+
+ActivityMeter::ActivityMeter()
+    : spanStart(std::chrono::steady_clock::now()), reportStart(spanStart), cpuStart(std::clock()) {}
+
+void ActivityMeter::add(bool isActive, int frames) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::clock_t cpu = std::clock();
+    State& state = isActive ? active : idle;
+    state.wall += std::chrono::duration<double>(now - spanStart).count();
+    state.cpu += (double)(cpu - cpuStart) / CLOCKS_PER_SEC;
+    state.frames += frames;
+    spanStart = now;
+    cpuStart = cpu;
+}
+
+bool ActivityMeter::reportDue(double interval) const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - reportStart).count() >= interval;
+}
+
+void ActivityMeter::report(std::ostream& out) {
+    const char* names[2] = {"idle", "active"};
+    State* states[2] = {&idle, &active};
+    for (int i = 0; i < 2; ++i) {
+        const State& s = *states[i];
+        out << (i ? " | " : "") << names[i] << " " << s.wall << " s: ";
+        if (s.wall > 0.0) out << s.cpu * 100.0 / s.wall << "% CPU, " << s.frames * 60.0 / s.wall << " frames/min";
+        else out << "-";
+    }
+    out << std::endl;
+    idle = active = State();
+    reportStart = std::chrono::steady_clock::now();
+}
+
+long long fileModifiedTime(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0) return -1;
+#if defined(__APPLE__)
+    return (long long)info.st_mtimespec.tv_sec * 1000000000ll + info.st_mtimespec.tv_nsec;
+#elif defined(__unix__)
+    return (long long)info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec;
+#else
+    return (long long)info.st_mtime;
+#endif
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+
+uniform sampler2D scene;
+uniform float threshold; // luminance where the glow starts
+
+void main() {
+    vec3 color = texture(scene, TexCoord).rgb;
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    FragColor = vec4(color * smoothstep(threshold, threshold + 0.25, luminance), 1.0);
+}
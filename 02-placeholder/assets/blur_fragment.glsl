@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+
+uniform sampler2D image;
+uniform vec2 direction; // one texel along the blur axis
+
+// 9 tap gaussian, run once horizontally and once vertically
+const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+
+void main() {
+    vec3 color = texture(image, TexCoord).rgb * weights[0];
+    for (int i = 1; i < 5; ++i) {
+        color += texture(image, TexCoord + direction * i).rgb * weights[i];
+        color += texture(image, TexCoord - direction * i).rgb * weights[i];
+    }
+    FragColor = vec4(color, 1.0);
+}
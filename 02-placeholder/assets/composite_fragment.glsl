@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float strength; // 0: the scene as is, bloom isn't bound
+
+void main() {
+    vec3 color = texture(scene, TexCoord).rgb;
+    if (strength > 0.0) color += texture(bloom, TexCoord).rgb * strength;
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+// One triangle covering the screen, no vertex buffer needed (draw 3 vertices with an empty VAO)
+out vec2 TexCoord;
+
+void main() {
+    vec2 position = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    TexCoord = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
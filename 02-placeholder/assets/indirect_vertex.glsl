@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uint aDrawID; // which draw we belong to, see IndirectRenderer
+
+out vec2 TexCoord;
+out vec4 Tint;
+
+uniform samplerBuffer drawData; // 5 texels per draw: transform columns, then tint
+
+void main() {
+    int base = int(aDrawID) * 5;
+    mat4 transform = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                          texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    gl_Position = transform * vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+    Tint = texelFetch(drawData, base + 4);
+}
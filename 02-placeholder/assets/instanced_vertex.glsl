@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+
+// per instance (glVertexAttribDivisor = 1)
+layout (location = 3) in mat4 aTransform; // takes locations 3, 4, 5, 6
+layout (location = 7) in vec4 aUVRect;
+layout (location = 8) in vec4 aTint;
+
+out vec2 TexCoord;
+out vec4 Tint;
+
+void main() {
+    gl_Position = aTransform * vec4(aPos, 1.0);
+    TexCoord = aUVRect.xy + aTexCoord * aUVRect.zw;
+    Tint = aTint;
+}
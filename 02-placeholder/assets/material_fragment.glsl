@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+in vec3 ourColor;
+in vec2 TexCoord;
+
+uniform sampler2D texture1;
+uniform sampler2D texture2; // the material's color, alpha < 1 for translucent ones
+
+void main () {
+    vec4 material = texture(texture2, TexCoord);
+    FragColor = vec4(texture(texture1, TexCoord).rgb * material.rgb, material.a);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+in vec4 ourColor;
+in vec2 TexCoord;
+
+uniform sampler2D sprite;
+
+void main () {
+    FragColor = texture(sprite, TexCoord) * ourColor;
+}
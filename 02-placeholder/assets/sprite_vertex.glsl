@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec4 aColor;
+layout (location = 2) in vec2 aTexCoord;
+
+out vec4 ourColor;
+out vec2 TexCoord;
+
+uniform mat4 projection; // pixels -> NDC, set by the sprite batch
+
+void main() {
+    gl_Position = projection * vec4(aPos, 0.0, 1.0);
+    ourColor = aColor;
+    TexCoord = aTexCoord;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+
+uniform sampler2D scene;
+uniform vec2 uvScale;    // the part of the target the scene was drawn into
+uniform vec2 uvMax;      // half a texel inside it, so bilinear never reads outside
+uniform float sharpness; // 0: plain bilinear
+
+void main() {
+    vec2 uv = min(TexCoord * uvScale, uvMax);
+    vec3 color = texture(scene, uv).rgb;
+    if (sharpness > 0.0) {
+        // Unsharp mask over the 4 neighbours, one scene texel away
+        vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+        vec3 blur = texture(scene, min(uv + vec2(texel.x, 0.0), uvMax)).rgb + texture(scene, max(uv - vec2(texel.x, 0.0), 0.0)).rgb
+                  + texture(scene, min(uv + vec2(0.0, texel.y), uvMax)).rgb + texture(scene, max(uv - vec2(0.0, texel.y), 0.0)).rgb;
+        color = clamp(color + sharpness * (color - blur * 0.25), 0.0, 1.0);
+    }
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "benchmarks.h"
+#include "../include/utilities/bvh.h"
+#include "../include/utilities/culling.h"
+
+template <typename Fn>
+static double averageMs(int runs, Fn fn) {
+    fn();
+    BenchTimer timer;
+    for (int i = 0; i < runs; ++i) fn();
+    return timer.ms() / runs;
+}
+
+// Brute force versions of the BVH queries, to check results and to have something to beat
+static bool raycastFlat(const std::vector<AABB>& boxes, const Ray& ray, uint32_t& object, float& distance) {
+    glm::vec3 inverse(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    bool hit = false;
+    float best = 1e30f;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        glm::vec3 t1 = (boxes[i].min - ray.origin) * inverse, t2 = (boxes[i].max - ray.origin) * inverse;
+        float tNear = std::max(std::max(std::min(t1.x, t2.x), std::min(t1.y, t2.y)), std::max(std::min(t1.z, t2.z), 0.0f));
+        float tFar = std::min(std::min(std::max(t1.x, t2.x), std::max(t1.y, t2.y)), std::max(t1.z, t2.z));
+        if (tNear <= tFar && tNear < best) {
+            best = tNear;
+            object = (uint32_t)i;
+            hit = true;
+        }
+    }
+    if (hit) distance = best;
+    return hit;
+}
+
+static void querySphereFlat(const std::vector<AABB>& boxes, const glm::vec3& c, float radius, std::vector<uint32_t>& out) {
+    out.clear();
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        glm::vec3 d = glm::max(glm::max(boxes[i].min - c, glm::vec3(0.0f)), c - boxes[i].max);
+        if (glm::dot(d, d) <= radius * radius) out.push_back((uint32_t)i);
+    }
+}
+
+static int runSize(size_t count, unsigned int threads) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.5f, 2.0f), unit(-1.0f, 1.0f);
+    std::vector<AABB> boxes(count);
+    BoundingBoxes flat;
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 c(position(rng), position(rng), position(rng));
+        float r = size(rng);
+        boxes[i].min = c - glm::vec3(r);
+        boxes[i].max = c + glm::vec3(r);
+        flat.add(boxes[i].min, boxes[i].max);
+    }
+    printf("%zu objects\n", count);
+
+    BVH bvh;
+    BenchTimer timer;
+    bvh.build(boxes, 1);
+    double build1 = timer.ms();
+    timer.reset();
+    bvh.build(boxes, threads);
+    double buildN = timer.ms();
+    printf("  build     1 thread %8.2f ms, %u threads %8.2f ms, %zu nodes (%zu KB), depth %u\n", build1, threads,
+           buildN, bvh.nodeCount(), bvh.nodeCount() * 128 / 1024, bvh.treeDepth());
+
+    // 1% of the objects drift a bit, then everything drifts
+    std::vector<uint32_t> moved;
+    for (size_t i = 0; i < count; i += 100) moved.push_back((uint32_t)i);
+    for (uint32_t i : moved) {
+        glm::vec3 d(unit(rng), unit(rng), unit(rng));
+        boxes[i].min += d;
+        boxes[i].max += d;
+    }
+    double refitPartial = averageMs(10, [&]() { bvh.refit(boxes, moved); });
+    double refitFull = averageMs(10, [&]() { bvh.refit(boxes); });
+    printf("  refit     1%% moved %8.3f ms, all %8.3f ms\n", refitPartial, refitFull);
+    flat.clear();
+    for (size_t i = 0; i < count; ++i) flat.add(boxes[i].min, boxes[i].max);
+
+    // Frustum: a camera in the middle of the cloud looking down -z, like the cull bench
+    Camera camera;
+    camera.position = glm::vec3(0.0f);
+    camera.target = glm::vec3(0.0f, 0.0f, -1.0f);
+    Frustum frustum = Frustum::fromMatrix(camera.viewProjection());
+    std::vector<uint32_t> visible, expected;
+    double treeMs = averageMs(10, [&]() { bvh.queryFrustum(frustum, visible); });
+    double flatMs = averageMs(10, [&]() { cullBoxes(frustum, flat, expected, 1); });
+    std::sort(visible.begin(), visible.end());
+    printf("  frustum   bvh %8.3f ms, flat %8.3f ms (%zu visible)%s\n", treeMs, flatMs, visible.size(),
+           visible == expected ? "" : "  MISMATCH");
+    bool ok = visible == expected;
+
+    // Rays and proximity from random points inside the cloud
+    const int queries = 200;
+    std::vector<Ray> rays(queries);
+    for (Ray& ray : rays) {
+        ray.origin = glm::vec3(position(rng), position(rng), position(rng));
+        ray.direction = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)));
+    }
+    int mismatches = 0;
+    timer.reset();
+    // Compared by distance, rays starting inside several boxes hit all of them at 0
+    std::vector<float> treeHits(queries, -1.0f);
+    for (int i = 0; i < queries; ++i) {
+        uint32_t object;
+        bvh.raycast(rays[i], object, treeHits[i]);
+    }
+    treeMs = timer.ms() / queries;
+    timer.reset();
+    for (int i = 0; i < queries; ++i) {
+        uint32_t object;
+        float d = -1.0f;
+        raycastFlat(boxes, rays[i], object, d);
+        if (d != treeHits[i]) ++mismatches;
+    }
+    flatMs = timer.ms() / queries;
+    printf("  raycast   bvh %8.4f ms, flat %8.3f ms per ray%s\n", treeMs, flatMs, mismatches ? "  MISMATCH" : "");
+    ok = ok && mismatches == 0;
+
+    size_t found = 0;
+    mismatches = 0;
+    std::vector<std::vector<uint32_t> > treeFound(queries);
+    timer.reset();
+    for (int i = 0; i < queries; ++i) bvh.querySphere(rays[i].origin, 5.0f, treeFound[i]);
+    treeMs = timer.ms() / queries;
+    timer.reset();
+    for (int i = 0; i < queries; ++i) {
+        querySphereFlat(boxes, rays[i].origin, 5.0f, expected);
+        std::sort(treeFound[i].begin(), treeFound[i].end());
+        if (treeFound[i] != expected) ++mismatches;
+        found += expected.size();
+    }
+    flatMs = timer.ms() / queries;
+    printf("  proximity bvh %8.4f ms, flat %8.3f ms per query (r = 5, %.1f found on average)%s\n", treeMs, flatMs,
+           (double)found / queries, mismatches ? "  MISMATCH" : "");
+    return ok && mismatches == 0 ? 0 : 1;
+}
+
+// Clusters of identical boxes, each twice as far out as the last: SAH can only peel a few
+// clusters off per split, so the tree gets as deep as float range allows and a cluster subtree is
+// left pending at every level of a traversal
+static int runDeep() {
+    std::vector<AABB> boxes;
+    BoundingBoxes flat;
+    float x = 1e-30f;
+    for (int cluster = 0; cluster < 160; ++cluster, x *= 2.0f) {
+        for (int i = 0; i < 10; ++i) {
+            AABB box;
+            box.min = glm::vec3(-1.5f * x, -x, -x);
+            box.max = glm::vec3(-x, x, x);
+            boxes.push_back(box);
+            flat.add(box.min, box.max);
+        }
+    }
+    BVH bvh;
+    bvh.build(boxes, 1);
+
+    std::vector<uint32_t> found, expected;
+    bvh.querySphere(glm::vec3(0.0f), 1e19f, found); // everything
+    bool ok = found.size() == boxes.size();
+
+    Camera camera;
+    camera.position = glm::vec3(10.0f, 0.0f, 0.0f);
+    camera.target = glm::vec3(0.0f);
+    bvh.queryFrustum(Frustum::fromMatrix(camera.viewProjection()), found);
+    cullBoxes(Frustum::fromMatrix(camera.viewProjection()), flat, expected, 1);
+    std::sort(found.begin(), found.end());
+    ok = ok && found == expected;
+
+    // Along the row from outside, and back from the far end
+    Ray rays[2] = {{glm::vec3(10.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f)},
+                   {glm::vec3(-2.0f * x, 0.1f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f)}};
+    for (const Ray& ray : rays) {
+        uint32_t object;
+        float treeHit = -1.0f, flatHit = -1.0f;
+        bvh.raycast(ray, object, treeHit);
+        raycastFlat(boxes, ray, object, flatHit);
+        ok = ok && treeHit == flatHit;
+    }
+    printf("%zu objects in a row: depth %u, queries %s\n", boxes.size(), bvh.treeDepth(), ok ? "match" : "MISMATCH");
+    return ok ? 0 : 1;
+}
+
+int benchBvh(int argc, char** argv) {
+    unsigned int threads = argc >= 2 ? (unsigned int)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> sizes;
+    if (argc >= 1) sizes.push_back((size_t)atol(argv[0]));
+    else sizes = {10000, 100000, 1000000};
+
+    int result = 0;
+    for (size_t count : sizes) result |= runSize(count, threads);
+    return result | runDeep();
+}
@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "benchmarks.h"
+#include "../include/utilities/culling.h"
+
+template <typename Fn>
+static double averageMs(int runs, Fn fn) {
+    fn(); // warm up caches and page in the output
+    BenchTimer timer;
+    for (int i = 0; i < runs; ++i) fn();
+    return timer.ms() / runs;
+}
+
+int benchCulling(int argc, char** argv) {
+    size_t count = argc >= 1 ? (size_t)atol(argv[0]) : 1000000;
+    unsigned int maxThreads = argc >= 2 ? (unsigned int)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+
+    // Objects scattered in a 200^3 box around a camera at the origin looking down -z
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.5f, 2.0f);
+    BoundingSpheres spheres;
+    BoundingBoxes boxes;
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 c(position(rng), position(rng), position(rng));
+        float r = size(rng);
+        spheres.add(c, r);
+        boxes.add(c - glm::vec3(r), c + glm::vec3(r));
+    }
+
+    Camera camera;
+    camera.position = glm::vec3(0.0f);
+    camera.target = glm::vec3(0.0f, 0.0f, -1.0f);
+    Frustum frustum = Frustum::fromMatrix(camera.viewProjection());
+
+    printf("%zu objects, best path %s\n", count, cullPathName(CullPath::Auto));
+    // Only what this CPU runs: an explicit path past bestCullPath() would just fall back to it
+    std::vector<CullPath> paths;
+    for (CullPath path : {CullPath::Scalar, CullPath::SSE, CullPath::AVX}) {
+        if (path <= bestCullPath()) paths.push_back(path);
+        else printf("%s not supported here, skipped\n", path == CullPath::AVX ? "avx" : "sse");
+    }
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    std::vector<uint32_t> visible;
+    for (CullPath path : paths) {
+        for (unsigned int threads : threadCounts) {
+            double sphereMs = averageMs(20, [&]() { cullSpheres(frustum, spheres, visible, threads, path); });
+            size_t sphereVisible = visible.size();
+            double boxMs = averageMs(20, [&]() { cullBoxes(frustum, boxes, visible, threads, path); });
+            printf("%-7s threads %2u  spheres %7.3f ms (%zu visible)  boxes %7.3f ms (%zu visible)\n",
+                   cullPathName(path), threads, sphereMs, sphereVisible, boxMs, visible.size());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "benchmarks.h"
+#include "../include/utilities/camera.h"
+#include "../include/utilities/ecs.h"
+
+namespace {
+
+struct Position {
+    glm::vec3 value;
+};
+struct Velocity {
+    glm::vec3 value;
+};
+struct Spin {
+    float angle, speed;
+};
+struct Transform {
+    glm::mat4 matrix;
+};
+struct Tint {
+    glm::vec4 color;
+};
+struct Selected {
+    uint32_t frame;
+};
+
+// The same data the way it would sit in a plain object list
+struct GameObject {
+    glm::vec3 position, velocity;
+    float angle, speed;
+    glm::mat4 transform;
+    glm::vec4 tint;
+};
+
+inline glm::mat4 spinTransform(const glm::vec3& p, float angle) {
+    float c = std::cos(angle), s = std::sin(angle);
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(c, s, 0.0f, 0.0f);
+    m[1] = glm::vec4(-s, c, 0.0f, 0.0f);
+    m[3] = glm::vec4(p, 1.0f);
+    return m;
+}
+
+} // namespace
+
+int benchEcs(int argc, char** argv) {
+    size_t count = argc >= 1 ? (size_t)atol(argv[0]) : 1000000;
+    unsigned int threads = argc >= 2 ? (unsigned int)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    const float dt = 1.0f / 60.0f;
+
+    World world;
+    std::vector<Entity> entities;
+    entities.reserve(count);
+    BenchTimer timer;
+    for (size_t i = 0; i < count; ++i) {
+        float f = (float)i;
+        Position p = {glm::vec3(std::fmod(f * 0.37f, 200.0f) - 100.0f, std::fmod(f * 0.73f, 200.0f) - 100.0f,
+                                std::fmod(f * 0.11f, 200.0f) - 100.0f)};
+        Velocity v = {glm::vec3(std::sin(f), std::cos(f), 0.0f)};
+        Spin s = {0.0f, 1.0f + (i % 7)};
+        Transform t = {glm::mat4(1.0f)};
+        Tint c = {glm::vec4(1.0f)};
+        entities.push_back(world.create(p, v, s, t, c));
+    }
+    printf("%zu entities, create %.1f ms\n", count, timer.ms());
+
+    std::vector<GameObject> objects(count);
+    for (size_t i = 0; i < count; ++i) {
+        objects[i].position = world.get<Position>(entities[i])->value;
+        objects[i].velocity = world.get<Velocity>(entities[i])->value;
+        objects[i].angle = 0.0f;
+        objects[i].speed = world.get<Spin>(entities[i])->speed;
+    }
+
+    // Iteration: a system touching two small components reads only their arrays
+    const int runs = 10;
+    timer.reset();
+    for (int r = 0; r < runs; ++r) {
+        world.eachChunk<Position, Velocity>([&](uint32_t n, Entity*, Position* p, Velocity* v) {
+            for (uint32_t i = 0; i < n; ++i) p[i].value = p[i].value + v[i].value * dt;
+        });
+    }
+    double ecsMove = timer.ms() / runs;
+    timer.reset();
+    for (int r = 0; r < runs; ++r) {
+        world.each<Position, Velocity>([&](Position& p, Velocity& v) { p.value = p.value + v.value * dt; });
+    }
+    double ecsEach = timer.ms() / runs;
+    timer.reset();
+    for (int r = 0; r < runs; ++r) {
+        for (GameObject& o : objects) o.position = o.position + o.velocity * dt;
+    }
+    double aosMove = timer.ms() / runs;
+    printf("  move      chunks %7.3f ms, each %7.3f ms, object list %7.3f ms\n", ecsMove, ecsEach, aosMove);
+
+    auto transformSystem = [&](uint32_t n, Entity*, const Position* p, Spin* s, Transform* t) {
+        for (uint32_t i = 0; i < n; ++i) {
+            s[i].angle += s[i].speed * dt;
+            t[i].matrix = spinTransform(p[i].value, s[i].angle);
+        }
+    };
+    timer.reset();
+    for (int r = 0; r < runs; ++r) world.eachChunk<Position, Spin, Transform>(transformSystem);
+    double ecsTransform = timer.ms() / runs;
+    timer.reset();
+    for (int r = 0; r < runs; ++r) world.eachChunkParallel<Position, Spin, Transform>(threads, transformSystem);
+    double ecsTransformN = timer.ms() / runs;
+    timer.reset();
+    for (int r = 0; r < runs; ++r) {
+        for (GameObject& o : objects) {
+            o.angle += o.speed * dt;
+            o.transform = spinTransform(o.position, o.angle);
+        }
+    }
+    double aosTransform = timer.ms() / runs;
+    printf("  transform chunks %7.3f ms, %u threads %7.3f ms, object list %7.3f ms\n", ecsTransform, threads,
+           ecsTransformN, aosTransform);
+
+    // A frame: move and tint don't touch the same components so they run side by side, then
+    // transform, then culling
+    Camera camera;
+    camera.position = glm::vec3(0.0f);
+    camera.target = glm::vec3(0.0f, 0.0f, -1.0f);
+    Frustum frustum = Frustum::fromMatrix(camera.viewProjection());
+    std::vector<size_t> visiblePerChunk;
+    size_t visible = 0;
+    Schedule schedule;
+    schedule.add("move", maskOf<Velocity>(), maskOf<Position>(), [&](World& w) {
+        w.eachChunk<Position, Velocity>([&](uint32_t n, Entity*, Position* p, Velocity* v) {
+            for (uint32_t i = 0; i < n; ++i) p[i].value = p[i].value + v[i].value * dt;
+        });
+    });
+    schedule.add("tint", 0, maskOf<Tint>(), [&](World& w) {
+        w.eachChunk<Tint>([&](uint32_t n, Entity*, Tint* c) {
+            for (uint32_t i = 0; i < n; ++i) c[i].color.w = 0.5f + 0.5f * c[i].color.x;
+        });
+    });
+    schedule.add("transform", maskOf<Position>(), maskOf<Spin, Transform>(), [&](World& w) {
+        w.eachChunkParallel<Position, Spin, Transform>(threads, transformSystem);
+    });
+    schedule.add("cull", maskOf<Transform>(), 0, [&](World& w) {
+        visible = 0;
+        w.eachChunk<Transform>([&](uint32_t n, Entity*, const Transform* t) {
+            for (uint32_t i = 0; i < n; ++i) {
+                const glm::vec4& p = t[i].matrix[3];
+                visible += frustum.containsSphere(glm::vec3(p.x, p.y, p.z), 1.0f);
+            }
+        });
+    });
+    timer.reset();
+    for (int r = 0; r < runs; ++r) schedule.run(world);
+    double frameMs = timer.ms() / runs;
+    printf("  schedule  %7.3f ms per frame, %zu visible, stages:", frameMs, visible);
+    for (const std::vector<const char*>& stage : schedule.stages()) {
+        printf(" [");
+        for (size_t i = 0; i < stage.size(); ++i) printf(i ? " %s" : "%s", stage[i]);
+        printf("]");
+    }
+    printf("\n");
+
+    // Structural changes: every one moves the entity's row to another archetype
+    timer.reset();
+    for (size_t i = 0; i < count; i += 2) world.add(entities[i], Selected{0});
+    double addMs = timer.ms();
+    timer.reset();
+    for (size_t i = 0; i < count; i += 2) world.remove<Selected>(entities[i]);
+    double removeMs = timer.ms();
+    // Rows got shuffled around by the swap-removes, every entity must still find its own data
+    size_t wrong = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Spin* s = world.get<Spin>(entities[i]);
+        if (!s || s->speed != 1.0f + (i % 7) || world.get<Selected>(entities[i])) ++wrong;
+    }
+    timer.reset();
+    for (size_t i = 0; i < count; ++i) world.destroy(entities[i]);
+    double destroyMs = timer.ms();
+    printf("  changes   add %7.1f ms, remove %7.1f ms (%zu entities each), destroy all %7.1f ms, %zu archetypes\n",
+           addMs, removeMs, (count + 1) / 2, destroyMs, world.archetypeCount());
+    if (wrong) printf("MISMATCH: %zu entities lost their components\n", wrong);
+    bool empty = world.size() == 0;
+
+    // Stale handles do nothing, even once their slot is reused by a new entity
+    Entity reused = world.create(Spin{0.0f, 2.0f});
+    for (size_t i = 0; i < count; ++i) {
+        world.add(entities[i], Selected{0});
+        world.remove<Spin>(entities[i]);
+    }
+    const Spin* spin = world.get<Spin>(reused);
+    bool stale = world.size() == 1 && spin && spin->speed == 2.0f && !world.get<Selected>(reused);
+    if (!stale) printf("MISMATCH: a stale handle changed the entity reusing its slot\n");
+    return wrong == 0 && empty && stale ? 0 : 1;
+}
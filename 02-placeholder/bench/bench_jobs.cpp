@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "benchmarks.h"
+#include "../include/utilities/camera.h"
+#include "../include/utilities/culling.h"
+#include "../include/utilities/jobs.h"
+#include "../include/utilities/scene_graph.h"
+
+template <typename Fn>
+static double averageMs(int runs, Fn fn) {
+    BenchTimer timer;
+    for (int r = 0; r < runs; ++r) fn();
+    return timer.ms() / runs;
+}
+
+int benchJobs(int argc, char** argv) {
+    size_t count = argc >= 1 ? (size_t)atol(argv[0]) : 1000000;
+    unsigned int maxThreads = argc >= 2 ? (unsigned int)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    const char* tracePath = argc >= 3 ? argv[2] : nullptr;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // Inputs shared by every thread count
+    std::vector<float> values(count), results(count), expectedResults(count);
+    for (size_t i = 0; i < count; ++i) values[i] = unit(rng);
+    for (size_t i = 0; i < count; ++i) expectedResults[i] = std::sin(values[i]) * std::cos(values[i] * 3.0f);
+
+    BoundingSpheres spheres;
+    for (size_t i = 0; i < count; ++i) {
+        spheres.add(glm::vec3(unit(rng) * 100.0f, unit(rng) * 100.0f, unit(rng) * 100.0f), 0.5f + 0.5f * unit(rng));
+    }
+    Camera camera;
+    camera.position = glm::vec3(0.0f, 0.0f, 120.0f);
+    camera.target = glm::vec3(10.0f, 5.0f, 0.0f);
+    Frustum frustum = Frustum::fromMatrix(camera.viewProjection());
+    std::vector<uint32_t> expectedVisible, visible;
+    cullSpheres(frustum, spheres, expectedVisible, 1);
+
+    SceneGraph graph;
+    std::vector<uint32_t> handles;
+    size_t nodes = std::min<size_t>(count, 200000);
+    for (size_t i = 0; i < nodes; ++i) {
+        uint32_t parent = i % 100 == 0 ? SceneGraph::kNoParent : handles[i - 1 - rng() % (i % 100)];
+        handles.push_back(graph.add(parent, glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng), unit(rng), 0.0f))));
+    }
+    graph.update(1);
+    SceneGraph reference = graph;
+
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int t = 1; t < maxThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    int wrong = 0;
+    double base[3] = {0.0, 0.0, 0.0};
+    for (unsigned int threads : threadCounts) {
+        JobSystem jobs(threads);
+        bool trace = tracePath && threads == maxThreads;
+
+        // Scheduling overhead: lots of jobs that do nothing
+        const int empty = 100000;
+        double emptyMs = averageMs(5, [&]() {
+            JobCounter counter;
+            for (int i = 0; i < empty; ++i) jobs.run("empty", []() {}, &counter);
+            jobs.wait(counter);
+        });
+        if (trace) jobs.startTrace();
+
+        double forMs = averageMs(10, [&]() {
+            jobs.parallelFor("math", count, sizeof(float), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) results[i] = std::sin(values[i]) * std::cos(values[i] * 3.0f);
+            });
+        });
+        if (results != expectedResults) {
+            printf("MISMATCH: parallelFor results differ with %u threads\n", threads);
+            ++wrong;
+        }
+        // 12-byte items: batches must start on a line (16 items), whatever the count
+        std::atomic<int> misaligned{0};
+        jobs.parallelFor("align", count + 5, 12, [&](size_t begin, size_t) {
+            if (begin * 12 % 64) ++misaligned;
+        }, 1);
+        if (misaligned) {
+            printf("MISMATCH: %d parallelFor batches start mid line with %u threads\n", misaligned.load(), threads);
+            ++wrong;
+        }
+
+        double cullMs = averageMs(10, [&]() { cullSpheres(frustum, spheres, visible, jobs); });
+        if (visible != expectedVisible) {
+            printf("MISMATCH: job culling differs with %u threads\n", threads);
+            ++wrong;
+        }
+
+        double sceneMs = averageMs(10, [&]() {
+            // Same matrices, but every node counts as moved
+            for (uint32_t h : handles) graph.setLocal(h, glm::mat4(graph.local(h)));
+            graph.update(jobs);
+        });
+        for (size_t i = 0; i < nodes; ++i) {
+            glm::vec4 d = graph.world(handles[i])[3] - reference.world(handles[i])[3];
+            if (glm::dot(d, d) > 1e-8f) {
+                printf("MISMATCH: job scene graph update differs with %u threads\n", threads);
+                ++wrong;
+                break;
+            }
+        }
+
+        // Dependencies: a -> (b, c) -> d. Jobs are started in that order, so a counter already
+        // counts everything it stands for by the time a job waits on it.
+        std::atomic<int> order(0);
+        int seenA = -1, seenB = -1, seenC = -1, seenD = -1;
+        {
+            JobCounter first, second, last;
+            jobs.run("a", [&]() { seenA = order++; }, &first);
+            jobs.run("b", [&]() { seenB = order++; }, &second, &first);
+            jobs.run("c", [&]() { seenC = order++; }, &second, &first);
+            jobs.run("d", [&]() { seenD = order++; }, &last, &second);
+            jobs.wait(last);
+        }
+        if (!(seenA == 0 && seenB > seenA && seenC > seenA && seenD > std::max(seenB, seenC))) {
+            printf("MISMATCH: dependencies ran out of order with %u threads\n", threads);
+            ++wrong;
+        }
+
+        if (threads == 1) {
+            base[0] = forMs;
+            base[1] = cullMs;
+            base[2] = sceneMs;
+        }
+        JobStats stats = jobs.stats();
+        printf("threads %2u: %6.1f ns/empty job, parallel for %8.3f ms (%.2fx), cull %8.3f ms (%.2fx), "
+               "scene graph %8.3f ms (%.2fx), %zu jobs, %zu stolen\n",
+               threads, emptyMs * 1e6 / empty, forMs, base[0] / forMs, cullMs, base[1] / cullMs, sceneMs,
+               base[2] / sceneMs, stats.executed, stats.stolen);
+        if (trace && jobs.writeTrace(tracePath)) printf("wrote %s\n", tracePath);
+    }
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_aligned.hpp>
+
+#include "benchmarks.h"
+#include "../include/utilities/batch_math.h"
+
+// The bench target is built with GLM_FORCE_INTRINSICS: the default (packed) GLM types stay
+// scalar, the aligned_* ones use GLM's own SSE code, so both baselines can live in one binary.
+
+template <typename Fn>
+static double averageMs(int runs, Fn fn) {
+    fn();
+    BenchTimer timer;
+    for (int i = 0; i < runs; ++i) fn();
+    return timer.ms() / runs;
+}
+
+static float maxError(const float* a, const float* b, size_t count) {
+    float worst = 0.0f;
+    for (size_t i = 0; i < count; ++i) worst = std::max(worst, std::fabs(a[i] - b[i]) / std::max(1.0f, std::fabs(b[i])));
+    return worst;
+}
+
+int benchMath(int argc, char** argv) {
+    size_t count = argc >= 1 ? (size_t)atol(argv[0]) : 100000;
+    const int runs = 20;
+
+    TransformArrays transforms;
+    std::vector<glm::vec3> points(count);
+    for (size_t i = 0; i < count; ++i) {
+        float f = (float)i;
+        glm::vec3 position(std::sin(f) * 50.0f, std::cos(f * 0.7f) * 50.0f, std::sin(f * 0.3f) * 50.0f);
+        glm::quat rotation = glm::angleAxis(f * 0.01f, glm::normalize(glm::vec3(std::sin(f), 1.0f, std::cos(f))));
+        transforms.add(position, rotation, glm::vec3(1.0f + (i % 3), 1.0f, 0.5f + (i % 5)));
+        points[i] = position;
+    }
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 20.0f, 80.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::vector<glm::mat4> models(count), expected(count), result(count);
+    std::vector<glm::aligned_mat4> alignedModels(count), alignedResult(count);
+    std::vector<glm::vec4> expectedPoints(count), resultPoints(count);
+    std::vector<glm::aligned_vec4> alignedPoints(count);
+    printf("%zu items, best path %s\n", count, mathPathName(MathPath::Auto));
+    // Only what this CPU runs: an explicit path past bestMathPath() would just fall back to it
+    std::vector<MathPath> paths;
+    for (MathPath path : {MathPath::Scalar, MathPath::SSE, MathPath::AVX2}) {
+        if (path <= bestMathPath()) paths.push_back(path);
+        else printf("%s not supported here, skipped\n", path == MathPath::AVX2 ? "avx2" : "sse");
+    }
+
+    // TRS from SoA
+    double glmMs = averageMs(runs, [&]() {
+        for (size_t i = 0; i < count; ++i) {
+            glm::quat q(transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i]);
+            expected[i] = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.px[i], transforms.py[i], transforms.pz[i])) *
+                          glm::mat4_cast(q) *
+                          glm::scale(glm::mat4(1.0f), glm::vec3(transforms.sx[i], transforms.sy[i], transforms.sz[i]));
+        }
+    });
+    double glmSimdMs = averageMs(runs, [&]() {
+        for (size_t i = 0; i < count; ++i) {
+            glm::quat q(transforms.qw[i], transforms.qx[i], transforms.qy[i], transforms.qz[i]);
+            glm::aligned_mat4 m = glm::aligned_mat4(glm::mat4_cast(q));
+            m[0] *= transforms.sx[i];
+            m[1] *= transforms.sy[i];
+            m[2] *= transforms.sz[i];
+            m[3] = glm::aligned_vec4(transforms.px[i], transforms.py[i], transforms.pz[i], 1.0f);
+            alignedModels[i] = m;
+        }
+    });
+    printf("compose TRS     glm %8.3f ms  glm intrinsics %8.3f ms", glmMs, glmSimdMs);
+    for (MathPath path : paths) {
+        double ms = averageMs(runs, [&]() { composeTRS(transforms, result.data(), path); });
+        printf("  %s %8.3f ms (err %.1e)", mathPathName(path), ms, maxError(&result[0][0][0], &expected[0][0][0], count * 16));
+    }
+    printf("\n");
+    models = expected;
+    for (size_t i = 0; i < count; ++i) alignedModels[i] = glm::aligned_mat4(models[i]);
+
+    // viewProjection * model
+    glm::aligned_mat4 alignedVP(viewProjection);
+    glmMs = averageMs(runs, [&]() {
+        for (size_t i = 0; i < count; ++i) expected[i] = viewProjection * models[i];
+    });
+    glmSimdMs = averageMs(runs, [&]() {
+        for (size_t i = 0; i < count; ++i) alignedResult[i] = alignedVP * alignedModels[i];
+    });
+    printf("mat4 x VP       glm %8.3f ms  glm intrinsics %8.3f ms", glmMs, glmSimdMs);
+    for (MathPath path : paths) {
+        double ms = averageMs(runs, [&]() { multiplyMatrices(viewProjection, models.data(), result.data(), count, path); });
+        printf("  %s %8.3f ms (err %.1e)", mathPathName(path), ms, maxError(&result[0][0][0], &expected[0][0][0], count * 16));
+    }
+    printf("\n");
+
+    // Points through viewProjection
+    glmMs = averageMs(runs, [&]() {
+        for (size_t i = 0; i < count; ++i) expectedPoints[i] = viewProjection * glm::vec4(points[i], 1.0f);
+    });
+    glmSimdMs = averageMs(runs, [&]() {
+        for (size_t i = 0; i < count; ++i) alignedPoints[i] = alignedVP * glm::aligned_vec4(points[i], 1.0f);
+    });
+    printf("transform point glm %8.3f ms  glm intrinsics %8.3f ms", glmMs, glmSimdMs);
+    for (MathPath path : paths) {
+        double ms = averageMs(runs, [&]() { transformPoints(viewProjection, points.data(), resultPoints.data(), count, path); });
+        printf("  %s %8.3f ms (err %.1e)", mathPathName(path), ms, maxError(&resultPoints[0].x, &expectedPoints[0].x, count * 4));
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "benchmarks.h"
+#include "../include/utilities/mesh.h"
+
+// Writes a (side x side) grid with positions, uvs and normals, 2 * side^2 triangles
+static bool writeGridOBJ(const std::string& path, int side) {
+    std::ofstream file(path.c_str());
+    if (!file.is_open()) return false;
+    char line[256];
+    for (int y = 0; y <= side; ++y) {
+        for (int x = 0; x <= side; ++x) {
+            float fx = (float)x / side, fy = (float)y / side;
+            snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0 0 1\n", fx - 0.5f, fy - 0.5f, 0.0f, fx, fy);
+            file << line;
+        }
+    }
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            int a = y * (side + 1) + x + 1, b = a + 1, c = a + side + 1, d = c + 1;
+            snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, d, d, d, c, c, c);
+            file << line;
+        }
+    }
+    return (bool)file;
+}
+
+static void report(const char* label, const MeshLoader& loader, double totalMs) {
+    const MeshLoadStats& s = loader.lastStats();
+    printf("%-18s threads %2u  read %8.1f ms  parse %8.1f ms  weld %8.1f ms  total %8.1f ms  (%zu corners -> %zu vertices, %zu tris)\n",
+           label, loader.threadCount(), s.readMs, s.parseMs, s.weldMs, totalMs, s.corners, s.vertices, s.triangles);
+}
+
+int benchMesh(int argc, char** argv) {
+    long triangles = argc >= 1 ? atol(argv[0]) : 2000000;
+    std::string path = argc >= 2 ? argv[1] : "bench_grid.obj";
+    int side = 1;
+    while (2L * side * side < triangles) ++side;
+
+    std::ifstream existing(path.c_str());
+    if (!existing.good()) {
+        std::cout << "Writing " << path << " (" << 2L * side * side << " triangles)..." << std::endl;
+        if (!writeGridOBJ(path, side)) {
+            std::cout << "Failed to write " << path << std::endl;
+            return 1;
+        }
+    }
+    std::remove(MeshLoader::cachePath(path.c_str()).c_str());
+
+    MeshData mesh;
+    BenchTimer timer;
+    MeshLoader single(1);
+    single.loadOBJ(path.c_str(), mesh);
+    report("obj", single, timer.ms());
+
+    MeshLoader parallel;
+    timer.reset();
+    parallel.loadOBJ(path.c_str(), mesh);
+    report("obj", parallel, timer.ms());
+
+    std::string cache = MeshLoader::cachePath(path.c_str());
+    timer.reset();
+    MeshLoader::writeCache(cache.c_str(), path.c_str(), mesh);
+    printf("%-18s %8.1f ms\n", "cache write", timer.ms());
+
+    // Cold-ish: the mapping is fresh, but the page cache probably still has it
+    MeshData cached;
+    timer.reset();
+    MappedFile mapped;
+    mapped.open(cache.c_str());
+    volatile unsigned int sum = 0;
+    for (size_t i = 0; i < mapped.size(); i += 4096) sum += (unsigned char)mapped.data()[i];
+    printf("%-18s %8.1f ms  (%zu MB touched through mmap)\n", "cache map", timer.ms(), mapped.size() >> 20);
+
+    timer.reset();
+    MeshLoader::readCache(cache.c_str(), cached);
+    printf("%-18s %8.1f ms  (%zu vertices, %zu tris)\n", "cache read", timer.ms(), cached.vertices.size(), cached.indices.size() / 3);
+    return 0;
+}
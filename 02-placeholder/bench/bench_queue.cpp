@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "benchmarks.h"
+#include "../include/utilities/render_queue.h"
+
+template <typename Fn>
+static double averageMs(int runs, Fn fn) {
+    BenchTimer timer;
+    for (int r = 0; r < runs; ++r) fn();
+    return timer.ms() / runs;
+}
+
+int benchQueue(int argc, char** argv) {
+    size_t count = argc >= 1 ? (size_t)atol(argv[0]) : 100000;
+    unsigned int threads = argc >= 2 ? (unsigned int)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+
+    // A frame of draws in scene order: 4 programs, 256 materials (each its own texture pair),
+    // one in 8 translucent, random depths
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    RenderQueue queue;
+    std::vector<SortEntry> keys;
+    for (size_t i = 0; i < count; ++i) {
+        DrawCommand draw;
+        draw.material = rng() % 256;
+        draw.program = 1 + draw.material % 4;
+        draw.textures[0] = 10 + draw.material;
+        draw.textures[1] = 300 + draw.material / 16;
+        draw.vao = 1;
+        draw.indexCount = 6;
+        draw.translucent = draw.material % 8 == 7;
+        float depth = unit(rng);
+        queue.add(draw, 0, depth);
+        SortEntry entry = {RenderQueue::makeKey(0, draw.translucent, draw.program, draw.material, depth), (uint32_t)i};
+        keys.push_back(entry);
+    }
+    size_t unsorted = queue.countStateChanges();
+    queue.sort(threads);
+    size_t sorted = queue.countStateChanges();
+    printf("%zu draws: %zu state changes in scene order, %zu sorted (%.1fx fewer)\n", count, unsorted, sorted,
+           (double)unsorted / sorted);
+
+    std::vector<SortEntry> expected = keys;
+    double stdMs = averageMs(10, [&]() {
+        expected = keys;
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+    });
+    printf("  std::stable_sort       %8.3f ms\n", stdMs);
+
+    int wrong = 0;
+    std::vector<SortEntry> entries, scratch;
+    for (unsigned int t = 1; t <= threads; t = (t == threads ? t + 1 : std::min(t * 2, threads))) {
+        double ms = averageMs(10, [&]() {
+            entries = keys;
+            radixSort(entries, scratch, t);
+        });
+        printf("  radix sort, threads %2u %8.3f ms (%.1fx)\n", t, ms, stdMs / ms);
+        for (size_t i = 0; i < count; ++i) {
+            if (entries[i].key != expected[i].key || entries[i].index != expected[i].index) {
+                printf("MISMATCH: radix sort with %u threads differs at %zu\n", t, i);
+                ++wrong;
+                break;
+            }
+        }
+    }
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "benchmarks.h"
+#include "../include/utilities/readback.h"
+
+// AsyncReadback against a fake GL: glad's function pointers go to the functions below. Pack
+// buffers are plain memory, glReadPixels stamps the frame number into the bound one, and fences
+// signal after a set number of polls, so some copies "finish" before older ones.
+namespace {
+
+struct FakeFence {
+    int pollsLeft;
+};
+
+std::map<GLuint, std::vector<unsigned char> > storage;
+GLuint nextBuffer = 1, boundPack = 0;
+int drawnFrame = 0;
+int stallEvery = 7, stallPolls = 3;
+
+void APIENTRY fakeGenBuffers(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) names[i] = nextBuffer++;
+}
+void APIENTRY fakeDeleteBuffers(GLsizei n, const GLuint* names) {
+    for (GLsizei i = 0; i < n; ++i) storage.erase(names[i]);
+}
+void APIENTRY fakeBindBuffer(GLenum target, GLuint buffer) {
+    if (target == GL_PIXEL_PACK_BUFFER) boundPack = buffer;
+}
+void APIENTRY fakeBufferData(GLenum, GLsizeiptr size, const void*, GLenum) {
+    storage[boundPack].assign((size_t)size, 0);
+}
+void APIENTRY fakeBindFramebuffer(GLenum, GLuint) {}
+void APIENTRY fakeReadBuffer(GLenum) {}
+void APIENTRY fakePixelStorei(GLenum, GLint) {}
+void APIENTRY fakeFlush() {}
+void APIENTRY fakeReadPixels(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void* pixels) {
+    unsigned char* out = boundPack ? storage[boundPack].data() : (unsigned char*)pixels;
+    memcpy(out, &drawnFrame, sizeof(drawnFrame));
+}
+GLsync APIENTRY fakeFenceSync(GLenum, GLbitfield) {
+    FakeFence* fence = new FakeFence();
+    fence->pollsLeft = drawnFrame % stallEvery == 2 ? stallPolls : 0;
+    return (GLsync)fence;
+}
+GLenum APIENTRY fakeClientWaitSync(GLsync sync, GLbitfield, GLuint64) {
+    FakeFence* fence = (FakeFence*)sync;
+    return fence->pollsLeft-- > 0 ? GL_TIMEOUT_EXPIRED : GL_ALREADY_SIGNALED;
+}
+void APIENTRY fakeDeleteSync(GLsync sync) {
+    delete (FakeFence*)sync;
+}
+void* APIENTRY fakeMapBufferRange(GLenum, GLintptr, GLsizeiptr, GLbitfield) {
+    return storage[boundPack].data();
+}
+GLboolean APIENTRY fakeUnmapBuffer(GLenum) {
+    return GL_TRUE;
+}
+
+void installFakeGL() {
+    glad_glGenBuffers = fakeGenBuffers;
+    glad_glDeleteBuffers = fakeDeleteBuffers;
+    glad_glBindBuffer = fakeBindBuffer;
+    glad_glBufferData = fakeBufferData;
+    glad_glBindFramebuffer = fakeBindFramebuffer;
+    glad_glReadBuffer = fakeReadBuffer;
+    glad_glPixelStorei = fakePixelStorei;
+    glad_glFlush = fakeFlush;
+    glad_glReadPixels = fakeReadPixels;
+    glad_glFenceSync = fakeFenceSync;
+    glad_glClientWaitSync = fakeClientWaitSync;
+    glad_glDeleteSync = fakeDeleteSync;
+    glad_glMapBufferRange = fakeMapBufferRange;
+    glad_glUnmapBuffer = fakeUnmapBuffer;
+}
+
+} // namespace
+
+int benchReadback(int argc, char** argv) {
+    int frames = argc >= 1 ? atoi(argv[0]) : 10000;
+    int slots = argc >= 2 ? std::max(1, atoi(argv[1])) : 3;
+    installFakeGL();
+
+    // Every request waits for a slot, like --record, so every frame has to come out, in order
+    std::vector<int> order, stamped;
+    AsyncReadback readback;
+    readback.init(slots);
+    BenchTimer timer;
+    for (int f = 0; f < frames; ++f) {
+        drawnFrame = f;
+        readback.request(0, 4, 4, f, [&](const ReadbackFrame& pixels) {
+            int stamp;
+            memcpy(&stamp, pixels.pixels, sizeof(stamp));
+            order.push_back(pixels.frame);
+            stamped.push_back(stamp);
+        }, true);
+        readback.update();
+    }
+    double ms = timer.ms();
+    readback.flush();
+    ReadbackStats stats = readback.takeStats();
+    readback.destroy();
+    printf("%d frames, %d slots, every %dth fence %d polls late: %.4f ms per frame on this thread, %.2f frames "
+           "late, %d waits\n",
+           frames, slots, stallEvery, stallPolls, ms / frames, stats.latencyFrames, stats.waited);
+
+    int wrong = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (order[i] != (int)i || stamped[i] != (int)i) {
+            if (wrong < 5) printf("  handler %zu got frame %d (pixels of frame %d)\n", i, order[i], stamped[i]);
+            ++wrong;
+        }
+    }
+    if (order.size() != (size_t)frames || wrong) {
+        printf("MISMATCH: %zu of %d frames handled, %d out of order\n", order.size(), frames, wrong);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "benchmarks.h"
+#include "../include/utilities/scene_graph.h"
+
+int benchScene(int argc, char** argv) {
+    size_t count = argc >= 1 ? (size_t)atol(argv[0]) : 100000;
+    unsigned int threads = argc >= 2 ? (unsigned int)atoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+
+    // A forest of ~100 node objects (a root and a random tree of parts under it), created in
+    // random order so the first update has to sort it
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    SceneGraph graph;
+    std::vector<uint32_t> handles, parents;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t parent = SceneGraph::kNoParent;
+        if (i % 100 != 0) parent = handles[i - 1 - rng() % (i % 100)];
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng), unit(rng), unit(rng)));
+        handles.push_back(graph.add(parent, local));
+        parents.push_back(parent);
+    }
+
+    BenchTimer timer;
+    graph.update(1);
+    printf("%zu nodes, first update (sort + all) %.3f ms\n", count, timer.ms());
+
+    std::vector<uint32_t> moving;
+    const double fractions[] = {0.01, 1.0};
+    for (double fraction : fractions) {
+        moving.clear();
+        for (size_t i = 0; i < count; ++i) {
+            if (rng() % 10000 < fraction * 10000) moving.push_back(handles[i]);
+        }
+        for (unsigned int t = 1; t <= threads; t = (t == threads ? t + 1 : std::min(t * 2, threads))) {
+            const int frames = 20;
+            double ms = 0.0;
+            for (int f = 0; f < frames; ++f) {
+                glm::mat4 spin = glm::rotate(glm::mat4(1.0f), 0.01f * f, glm::vec3(0.0f, 1.0f, 0.0f));
+                for (uint32_t node : moving) graph.setLocal(node, graph.local(node) * spin);
+                timer.reset();
+                graph.update(t);
+                ms += timer.ms();
+            }
+            printf("  %5.1f%% moving, threads %2u: %8.3f ms per update (%zu nodes recomputed)\n", fraction * 100.0, t,
+                   ms / frames, graph.lastUpdated());
+        }
+    }
+
+    // A root added after a threaded update, when the task plan already exists
+    unsigned int planned = std::max(2u, threads);
+    graph.update(planned);
+    uint32_t late = graph.add(SceneGraph::kNoParent, glm::mat4(1.0f));
+    graph.setLocal(late, glm::translate(glm::mat4(1.0f), glm::vec3(7.0f, 0.0f, 0.0f)));
+    graph.update(planned);
+    handles.push_back(late);
+    parents.push_back(SceneGraph::kNoParent);
+    count = handles.size();
+
+    // Check against the plain recursive definition (parents were created before their children)
+    std::vector<glm::mat4> expected(count);
+    size_t wrong = 0;
+    for (size_t i = 0; i < count; ++i) {
+        expected[i] = parents[i] == SceneGraph::kNoParent ? graph.local(handles[i])
+                                                          : expected[parents[i]] * graph.local(handles[i]);
+        const glm::mat4& world = graph.world(handles[i]);
+        for (int c = 0; c < 4; ++c) {
+            glm::vec4 d = world[c] - expected[i][c];
+            if (glm::dot(d, d) > 1e-6f) {
+                ++wrong;
+                break;
+            }
+        }
+    }
+    if (wrong) printf("MISMATCH: %zu world matrices differ\n", wrong);
+    return wrong ? 1 : 0;
+}
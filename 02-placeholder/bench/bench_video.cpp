@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "benchmarks.h"
+#include "../include/utilities/video_recorder.h"
+
+// A frame with some structure: gradients plus a bit of noise so the chroma averages aren't trivial
+static void fillFrame(std::vector<uint8_t>& rgba, int width, int height, int seed) {
+    uint32_t state = 12345u + seed;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+            p[0] = (uint8_t)((x + seed) * 255 / width);
+            p[1] = (uint8_t)(y * 255 / height);
+            p[2] = (uint8_t)(state >> 24);
+            p[3] = 255;
+        }
+    }
+}
+
+int benchVideo(int argc, char** argv) {
+    int width = argc >= 1 ? atoi(argv[0]) : 1920;
+    int height = argc >= 2 ? atoi(argv[1]) : 1080;
+    int frames = argc >= 3 ? atoi(argv[2]) : 120;
+    const char* path = argc >= 4 ? argv[3] : "bench_video.y4m";
+    const int runs = 20;
+
+    std::vector<uint8_t> rgba((size_t)width * height * 4);
+    fillFrame(rgba, width, height, 0);
+    size_t lumaSize = (size_t)width * height, chromaSize = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    std::vector<uint8_t> scalar(lumaSize + chromaSize * 2), simd(scalar.size());
+    printf("%dx%d, RGBA to YUV 4:2:0 (%s)\n", width, height, mathPathName(yuvConvertPath()));
+
+    const MathPath paths[] = {MathPath::Scalar, MathPath::Auto};
+    std::vector<uint8_t>* outputs[] = {&scalar, &simd};
+    for (int i = 0; i < 2; ++i) {
+        uint8_t* y = outputs[i]->data();
+        convertToYUV420(rgba.data(), width, height, y, y + lumaSize, y + lumaSize + chromaSize, paths[i]);
+        BenchTimer timer;
+        for (int r = 0; r < runs; ++r) {
+            convertToYUV420(rgba.data(), width, height, y, y + lumaSize, y + lumaSize + chromaSize, paths[i]);
+        }
+        double ms = timer.ms() / runs;
+        printf("  convert %-6s %7.3f ms/frame  %7.1f Mpixel/s\n", i ? mathPathName(yuvConvertPath()) : "scalar", ms,
+               width * height / (ms * 1000.0));
+    }
+    size_t mismatches = 0;
+    for (size_t i = 0; i < scalar.size(); ++i) mismatches += scalar[i] != simd[i];
+    printf("  %zu bytes differ between the paths\n", mismatches);
+
+    // The recorder end to end: frames handed over like the readback worker does, written behind
+    VideoRecorder recorder;
+    if (!recorder.open(path, width, height, 60)) return 1;
+    ReadbackFrame frame;
+    frame.width = width;
+    frame.height = height;
+    frame.pixels = rgba.data();
+    BenchTimer timer;
+    for (int i = 0; i < frames; ++i) {
+        frame.frame = i;
+        recorder.addFrame(frame);
+    }
+    recorder.close();
+    double ms = timer.ms();
+    VideoRecorderStats stats = recorder.stats();
+    printf("  record %d frames: %.1f ms (%.1f frames/s, %.1f MB/s), convert %.3f ms/frame, write %.3f ms/frame, "
+           "%d stalls\n",
+           stats.frames, ms, stats.frames * 1000.0 / ms, stats.bytes / (1024.0 * 1024.0) / (ms / 1000.0), stats.convertMs,
+           stats.writeMs, stats.stalls);
+    remove(path);
+
+    // Frames arriving out of order are skipped, not written in arrival order: 0 1 3 2 4 -> 0 1 3 4
+    std::string rawPath = std::string(path) + ".rgba";
+    const int order[] = {0, 1, 3, 2, 4}, expected[] = {0, 1, 3, 4};
+    std::vector<uint8_t> tiny(4 * 2 * 4);
+    if (!recorder.open(rawPath.c_str(), 4, 2, 60)) return 1;
+    frame.width = 4;
+    frame.height = 2;
+    frame.pixels = tiny.data();
+    for (int f : order) {
+        std::fill(tiny.begin(), tiny.end(), (uint8_t)f);
+        frame.frame = f;
+        recorder.addFrame(frame);
+        if (f == 3) {
+            // A frame of another size is skipped too, and doesn't count as the last one written
+            frame.width = 2;
+            frame.frame = 5;
+            recorder.addFrame(frame);
+            frame.width = 4;
+        }
+    }
+    recorder.close();
+    std::vector<uint8_t> written(tiny.size() * 8);
+    FILE* file = fopen(rawPath.c_str(), "rb");
+    size_t read = file ? fread(written.data(), 1, written.size(), file) : 0;
+    if (file) fclose(file);
+    remove(rawPath.c_str());
+    bool inOrder = read == tiny.size() * 4 && recorder.stats().outOfOrder == 1 && recorder.stats().wrongSize == 1;
+    for (int i = 0; inOrder && i < 4; ++i) inOrder = written[i * tiny.size()] == expected[i];
+    printf("  out of order and wrong size frames: %s\n", inOrder ? "skipped" : "MISMATCH");
+
+    // Frame buffers too big to allocate (3 x 4 TB): open() has to fail cleanly
+    bool refused = !recorder.open(rawPath.c_str(), 1 << 20, 1 << 20, 60) && !recorder.isOpen();
+    FILE* leftover = fopen(rawPath.c_str(), "rb");
+    if (leftover) fclose(leftover);
+    refused = refused && !leftover;
+    printf("  huge frames: %s\n", refused ? "refused" : "MISMATCH");
+    return mismatches || !inOrder || !refused ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+
+// CPU-side benchmarks, no window or GL context needed.
+// Each one reads its own extra arguments and returns the exit code.
+int benchMesh(int argc, char** argv);
+int benchCulling(int argc, char** argv);
+int benchBvh(int argc, char** argv);
+int benchScene(int argc, char** argv);
+int benchEcs(int argc, char** argv);
+int benchMath(int argc, char** argv);
+int benchQueue(int argc, char** argv);
+int benchJobs(int argc, char** argv);
+int benchVideo(int argc, char** argv);
+int benchReadback(int argc, char** argv);
+
+class BenchTimer {
+public:
+    BenchTimer() : start(std::chrono::steady_clock::now()) {}
+    void reset() { start = std::chrono::steady_clock::now(); }
+    double ms() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
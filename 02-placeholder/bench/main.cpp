@@ -0,0 +1,34 @@
+#include <cstring>
+#include <iostream>
+
+#include "benchmarks.h"
+
+struct Benchmark {
+    const char* name;
+    int (*run)(int argc, char** argv);
+    const char* usage;
+};
+
+static const Benchmark benchmarks[] = {
+    {"mesh", benchMesh, "mesh [triangles] [file.obj]  - OBJ parse/weld, 1 vs N threads, binary cache"},
+    {"cull", benchCulling, "cull [objects] [threads]    - frustum culling of spheres/boxes, scalar/SSE/AVX, 1..N threads"},
+    {"bvh", benchBvh, "bvh [objects] [threads]     - BVH build/refit/queries vs a flat list (10k, 100k, 1M by default)"},
+    {"scene", benchScene, "scene [nodes] [threads]     - scene graph update with 1% and 100% of the nodes moving"},
+    {"ecs", benchEcs, "ecs [entities] [threads]    - ECS iteration, scheduled systems and structural changes (1M default)"},
+    {"math", benchMath, "math [count]                - batched TRS / mat4 x VP / point kernels vs GLM (scalar and intrinsics)"},
+    {"queue", benchQueue, "queue [draws] [threads]     - render queue: state changes unsorted/sorted, radix sort 1..N threads"},
+    {"jobs", benchJobs, "jobs [items] [threads] [trace.json] - job system overhead and scaling, 1..N threads"},
+    {"readback", benchReadback, "readback [frames] [slots]   - async readback against a fake GL, checks handlers run in order"},
+    {"video", benchVideo, "video [w] [h] [frames] [file] - RGBA to YUV 4:2:0 scalar vs SSE, recorder write throughput"},
+};
+
+int main(int argc, char** argv) {
+    if (argc >= 2) {
+        for (const Benchmark& b : benchmarks) {
+            if (strcmp(argv[1], b.name) == 0) return b.run(argc - 2, argv + 2);
+        }
+    }
+    std::cout << "Usage: openGL_bench <benchmark> [args]" << std::endl;
+    for (const Benchmark& b : benchmarks) std::cout << "  " << b.usage << std::endl;
+    return 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Transforms in structure-of-arrays form, the input of composeTRS()
+struct TransformArrays {
+    std::vector<float> px, py, pz;       // translation
+    std::vector<float> qx, qy, qz, qw;   // rotation, unit quaternion
+    std::vector<float> sx, sy, sz;       // scale
+
+    void add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    void resize(size_t count);
+    void clear();
+    size_t size() const { return px.size(); }
+};
+
+enum class MathPath {
+    Auto,     // best the CPU supports
+    Scalar,
+    SSE,
+    AVX2      // AVX2 + FMA
+};
+
+// Batched matrix kernels. Strides are in bytes, so the matrices can live inside bigger
+// structs (e.g. InstanceData); by default they are packed.
+
+// out[i] = left * in[i]
+void multiplyMatrices(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count,
+                      MathPath path = MathPath::Auto, size_t inStride = sizeof(glm::mat4),
+                      size_t outStride = sizeof(glm::mat4));
+// out[i] = m * vec4(in[i], 1)
+void transformPoints(const glm::mat4& m, const glm::vec3* in, glm::vec4* out, size_t count,
+                     MathPath path = MathPath::Auto);
+// out[i] = translate(p[i]) * mat4_cast(q[i]) * scale(s[i])
+void composeTRS(const TransformArrays& transforms, glm::mat4* out, MathPath path = MathPath::Auto,
+                size_t outStride = sizeof(glm::mat4));
+
+// What Auto resolves to on this machine
+MathPath bestMathPath();
+const char* mathPathName(MathPath path);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Percentiles {
+    double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+// Nearest-rank percentiles of samples (any unit)
+Percentiles percentiles(std::vector<double> samples);
+// FNV-1a over the bytes, for comparing frames between builds
+uint64_t hashBytes(const std::vector<unsigned char>& bytes);
+
+struct BenchResult {
+    std::string scene;     // which scene the options picked
+    std::string arguments; // the command line, to tell runs apart
+    std::string renderer;  // GL_RENDERER
+    int width = 0, height = 0;
+    double simulatedFrameTime = 0.0; // seconds the fixed clock advances per frame
+    uint64_t framebufferHash = 0;    // of the last frame
+};
+
+// Per-frame CPU and GPU times for --bench.
+// CPU time runs from beginFrame() to endFrame(). GPU time is a GL_TIME_ELAPSED query over the
+// GL commands in between. Queries sit in a small ring and are read when their slot comes round
+// again, by which time the GPU is long done with them, so recording doesn't stall the frame;
+// finish() collects the last few at the end. The first frames pay for lazy shader compiles,
+// buffer allocations and the like (and some drivers report nonsense for the very first query),
+// so they are recorded but left out of the statistics.
+class BenchRecorder {
+public:
+    BenchRecorder() = default;
+    ~BenchRecorder();
+    BenchRecorder(const BenchRecorder&) = delete;
+    BenchRecorder& operator=(const BenchRecorder&) = delete;
+
+    // With the context current
+    void init(int warmupFrames);
+    void destroy();
+
+    // Before the frame's work, and after its last GL call (before the swap)
+    void beginFrame();
+    void endFrame();
+    void finish();
+
+    // Milliseconds per frame after the warm-up
+    std::vector<double> cpuTimes() const;
+    std::vector<double> gpuTimes() const;
+
+    // Everything as one JSON object
+    void writeJson(std::ostream& out, const BenchResult& result) const;
+
+private:
+    static const int kQueries = 8;
+
+    void collect(int slot);
+
+    GLuint queries[kQueries] = {};
+    int queryFrame[kQueries];  // frame each slot measures, -1 when free
+    int frame = 0;
+    int warmup = 0;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<double> cpuMs, gpuMs;
+};
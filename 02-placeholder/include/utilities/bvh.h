@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+
+struct AABB {
+    glm::vec3 min = glm::vec3(1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    void grow(const AABB& other);
+    void grow(const glm::vec3& point);
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    float surfaceArea() const;
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// Bounding volume hierarchy over object AABBs.
+// Built as a binary tree with binned SAH (top levels split across threads), then collapsed into
+// 4-wide nodes: the 4 child boxes are stored SoA so one node is exactly two cache lines and a
+// query tests all 4 children at once.
+// Objects are referred to by their index in the boxes vector given to build()/refit().
+class BVH {
+public:
+    // threads == 0 -> one per hardware thread
+    void build(const std::vector<AABB>& boxes, unsigned int threads = 0);
+
+    // Same tree, new boxes: every node is recomputed bottom-up
+    void refit(const std::vector<AABB>& boxes);
+    // Only the leaves holding these objects and their ancestors are recomputed
+    void refit(const std::vector<AABB>& boxes, const std::vector<uint32_t>& moved);
+
+    void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+    // Closest object whose box the ray hits, returns false if none
+    bool raycast(const Ray& ray, uint32_t& object, float& distance) const;
+    // Objects whose boxes overlap the sphere
+    void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const;
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t objectCount() const { return objects.size(); }
+    uint32_t treeDepth() const { return depth; } // levels of 4-wide nodes
+
+private:
+    // 128 bytes, two cache lines
+    struct Node {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        int32_t child[4];   // >= 0 inner node, < 0 leaf: ~child is the first entry in objects
+        uint32_t count[4];  // objects in the leaf (0 for inner/empty slots)
+    };
+
+    struct Range {
+        uint32_t first, count; // every object below a node is contiguous in objects
+    };
+
+    struct BuildNode;
+    struct Builder;
+    uint32_t collapse(const BuildNode* node, uint32_t parent, uint32_t level);
+    AABB nodeBounds(uint32_t node) const;
+    void refitNode(uint32_t node);
+
+    std::vector<Node> nodes;
+    std::vector<Range> ranges;              // per node, cold data for the "fully inside" shortcut
+    std::vector<uint32_t> parents;          // per node
+    std::vector<uint32_t> objects;          // object indices in leaf order
+    std::vector<AABB> boxes;                // their boxes, same order, so leaf tests read memory linearly
+    std::vector<uint32_t> objectSlot;       // per object: where it sits in objects/boxes
+    std::vector<uint32_t> objectLeaf;       // per object: the node holding its leaf
+    std::vector<uint8_t> dirty;
+    uint32_t depth = 0;                     // sizes the query stacks
+};
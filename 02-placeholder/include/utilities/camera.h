@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct Camera {
+    glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+    glm::vec3 target = glm::vec3(0.0f);
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    float fovY = glm::radians(60.0f);
+    float aspect = 800.0f / 600.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    glm::mat4 view() const;
+    glm::mat4 projection() const;
+    glm::mat4 viewProjection() const;
+};
+
+// Six planes (left, right, bottom, top, near, far) as (normal.xyz, d), normals pointing inside:
+// a point p is inside a plane when dot(normal, p) + d >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Works for any clip transform (projection * view, or projection * view * model for object space)
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+    bool containsSphere(const glm::vec3& center, float radius) const;
+    bool intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "jobs.h"
+
+// Bounding volumes in structure-of-arrays form: one array per component, so the SIMD kernels
+// load 4 (SSE) or 8 (AVX) objects with a single instruction per component.
+struct BoundingSpheres {
+    std::vector<float> x, y, z, radius;
+
+    void add(const glm::vec3& center, float r);
+    void clear();
+    size_t size() const { return x.size(); }
+};
+
+struct BoundingBoxes {
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    void add(const glm::vec3& boxMin, const glm::vec3& boxMax);
+    void clear();
+    size_t size() const { return minX.size(); }
+};
+
+enum class CullPath {
+    Auto,    // best the CPU supports
+    Scalar,
+    SSE,
+    AVX
+};
+
+// Writes the indices of the visible objects to visible (ascending order).
+// threads > 1 splits the list in contiguous ranges, each culled on its own thread.
+void cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible,
+                 unsigned int threads = 1, CullPath path = CullPath::Auto);
+void cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible,
+               unsigned int threads = 1, CullPath path = CullPath::Auto);
+// Same, the ranges run as jobs
+void cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible,
+                 JobSystem& jobs, CullPath path = CullPath::Auto);
+void cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible, JobSystem& jobs,
+               CullPath path = CullPath::Auto);
+
+// What Auto resolves to on this machine
+CullPath bestCullPath();
+const char* cullPathName(CullPath path);
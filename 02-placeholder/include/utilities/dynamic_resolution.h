@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <deque>
+#include <memory>
+
+class Shader;
+
+struct DynamicResolutionSettings {
+    double budgetMs = 14.0;  // GPU time the scene may take
+    float minScale = 0.5f;   // of the window's width and height
+    float maxScale = 1.0f;
+    float sharpness = 0.0f;  // upscale: 0 plain bilinear, ~0.5 sharpened
+    int window = 16;         // GPU times averaged per decision
+};
+
+struct DynamicResolutionStats {
+    float scale = 1.0f;
+    int sceneWidth = 0, sceneHeight = 0;
+    double gpuMs = 0.0;      // mean scene time of the current window, 0 until there is one
+    int changes = 0;         // resolution changes since the previous takeStats()
+};
+
+// Renders the scene into an offscreen target at a fraction of the window size and upscales it
+// into the output framebuffer. The target is allocated at full size once and the scene only
+// uses its lower left part, so changing the scale never reallocates anything.
+// The scale follows the scene's GPU time: a pair of timestamp queries per frame, read back a few
+// frames later without waiting. When the mean over a full window is over budget the scale drops
+// right away, aiming a bit under the budget (time ~ pixels ~ scale squared). It only grows again
+// once the mean is below 75% of the budget, and by at most 10% at a time. Between the two it
+// stays. Every change starts a new window, so each decision is based on frames drawn at the
+// current scale only. The band and the restart keep it from oscillating.
+class DynamicResolution {
+public:
+    DynamicResolution() = default;
+    ~DynamicResolution();
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // With the context current. False (after printing why) if the target can't be created.
+    bool init(const DynamicResolutionSettings& settings);
+    void destroy();
+
+    // Before the scene's first GL call: binds the target with the scaled viewport
+    void beginScene(int windowWidth, int windowHeight);
+    // After the scene: upscales it into output (0 or the display's offscreen framebuffer)
+    void endScene(GLuint output);
+
+    float scale() const { return currentScale; }
+    DynamicResolutionStats takeStats();
+
+private:
+    static const int kQueries = 4; // frames a timing may take to come back
+
+    bool resize(int width, int height);
+    void collect(int slot);
+    void adjust();
+
+    DynamicResolutionSettings settings;
+    std::unique_ptr<Shader> upscale;
+    GLuint fbo = 0, color = 0, depth = 0, emptyVAO = 0;
+    int targetWidth = 0, targetHeight = 0;
+    int windowWidth = 0, windowHeight = 0, sceneWidth = 0, sceneHeight = 0;
+    float currentScale = 1.0f;
+
+    GLuint queries[kQueries][2] = {};  // begin/end timestamps
+    bool pending[kQueries] = {};
+    int queryGeneration[kQueries] = {}; // scale changes before the query, stale timings are dropped
+    int generation = 0;
+    int frame = 0;
+    std::deque<double> gpuMs;
+    int changes = 0;
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Entity-component system with archetype storage.
+// Entities with the same set of components share an archetype, whose data lives in 16 KB
+// chunks: inside a chunk every component has its own array (SoA), so a system walking one or
+// two components reads contiguous memory and never touches the rest.
+// Components are plain data (trivially copyable): they're moved around with memcpy.
+
+struct Entity {
+    uint32_t index = 0xFFFFFFFFu;
+    uint32_t generation = 0;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// Up to 64 component types, a set of them is a bit mask
+typedef uint64_t ComponentMask;
+const int kMaxComponents = 64;
+
+int registerComponent(size_t size, size_t align);
+
+template <typename T>
+int componentId() {
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+    static const int id = registerComponent(sizeof(T), alignof(T));
+    return id;
+}
+
+inline ComponentMask componentMask() { return 0; }
+template <typename T, typename... Rest>
+ComponentMask componentMask(const T*, const Rest*... rest) {
+    return (ComponentMask(1) << componentId<T>()) | componentMask(rest...);
+}
+template <typename... Ts>
+ComponentMask maskOf() {
+    return componentMask((const Ts*)nullptr...);
+}
+
+const size_t kChunkSize = 16 * 1024;
+
+struct Chunk {
+    unsigned char data[kChunkSize];
+    uint32_t count = 0;
+};
+
+class Archetype {
+public:
+    explicit Archetype(ComponentMask mask);
+
+    ComponentMask mask() const { return componentBits; }
+    uint32_t capacity() const { return chunkCapacity; }
+    size_t chunkCount() const { return chunks.size(); }
+    Chunk& chunk(size_t i) { return *chunks[i]; }
+    size_t size() const;
+
+    Entity* entities(Chunk& c) { return (Entity*)c.data; }
+    template <typename T>
+    T* column(Chunk& c) {
+        return (T*)(c.data + offsets[componentId<T>()]);
+    }
+    void* column(Chunk& c, int component) { return c.data + offsets[component]; }
+    bool has(int component) const { return (componentBits >> component) & 1; }
+
+private:
+    friend class World;
+
+    // Appends an uninitialized row, returns its chunk and row
+    void allocate(uint32_t& chunkIndex, uint32_t& row);
+    // Moves the last row into (chunkIndex, row) and drops the last row.
+    // Returns the entity that got moved (index 0xFFFFFFFF if the removed row was the last one).
+    Entity removeSwap(uint32_t chunkIndex, uint32_t row);
+
+    ComponentMask componentBits;
+    uint32_t chunkCapacity = 0;
+    uint32_t offsets[kMaxComponents];
+    uint32_t sizes[kMaxComponents];
+    std::vector<std::unique_ptr<Chunk> > chunks;
+    // Cached structural change edges: archetype with one component added/removed
+    Archetype* addEdge[kMaxComponents];
+    Archetype* removeEdge[kMaxComponents];
+};
+
+class World {
+public:
+    World();
+
+    Entity create();
+    template <typename... Ts>
+    Entity create(const Ts&... components);
+    void destroy(Entity e);
+    bool alive(Entity e) const;
+    size_t size() const { return living; }
+
+    template <typename T>
+    void add(Entity e, const T& component);
+    template <typename T>
+    void remove(Entity e);
+    template <typename T>
+    T* get(Entity e);
+
+    // Archetypes that have all the components in mask. Cached per mask: later calls only check
+    // the archetypes created since the previous one. Safe to call from several systems at once,
+    // as long as nobody makes structural changes meanwhile.
+    const std::vector<Archetype*>& query(ComponentMask mask);
+
+    // fn(count, Entity*, Ts*...) once per chunk, arrays in chunk order
+    template <typename... Ts, typename Fn>
+    void eachChunk(Fn fn);
+    // fn(Ts&...) once per entity
+    template <typename... Ts, typename Fn>
+    void each(Fn fn);
+    // Same as eachChunk, chunks shared out between threads
+    template <typename... Ts, typename Fn>
+    void eachChunkParallel(unsigned int threads, Fn fn);
+
+    size_t archetypeCount() const { return archetypes.size(); }
+
+private:
+    struct Record {
+        Archetype* archetype = nullptr;
+        uint32_t chunk = 0, row = 0;
+        uint32_t generation = 0;
+    };
+
+    Archetype* archetypeFor(ComponentMask mask);
+    Archetype* withComponent(Archetype* from, int component, bool add);
+    // Moves e's row to another archetype, copying the components both have. Returns where
+    // component goes in the new row (nullptr for component < 0).
+    void* move(Entity e, Archetype* to, int component);
+    Entity place(Archetype* archetype);
+    void runParallel(unsigned int threads, size_t items, const std::function<void(size_t)>& fn);
+
+    std::vector<Record> records;
+    std::vector<uint32_t> freeList;
+    size_t living = 0;
+
+    std::unordered_map<ComponentMask, std::unique_ptr<Archetype> > byMask;
+    std::vector<Archetype*> archetypes;  // creation order
+    Archetype* empty;
+
+    struct CachedQuery {
+        std::vector<Archetype*> matches;
+        size_t checked = 0;  // archetypes[0, checked) have been looked at
+    };
+    std::unordered_map<ComponentMask, CachedQuery> queries;
+    std::mutex queryMutex;
+};
+
+// Systems declare what they read and write; run() executes them in order, but consecutive
+// systems that don't conflict (nobody writes what another one reads or writes) run together on
+// their own threads.
+class Schedule {
+public:
+    void add(const char* name, ComponentMask reads, ComponentMask writes, std::function<void(World&)> fn);
+    void run(World& world);
+
+    // Groups of systems that ran together in the last run(), by name
+    const std::vector<std::vector<const char*> >& stages() const { return lastStages; }
+
+private:
+    struct System {
+        const char* name;
+        ComponentMask reads, writes;
+        std::function<void(World&)> fn;
+    };
+    std::vector<System> systems;
+    std::vector<std::vector<const char*> > lastStages;
+};
+
+// ---------------------------------------------------------------------------------------------
+
+namespace ecs_detail {
+
+inline void copyComponents(Archetype&, Chunk&, uint32_t) {}
+template <typename T, typename... Rest>
+void copyComponents(Archetype& a, Chunk& c, uint32_t row, const T& first, const Rest&... rest) {
+    a.column<T>(c)[row] = first;
+    copyComponents(a, c, row, rest...);
+}
+
+template <typename Fn, typename... Ts>
+void eachRow(Fn& fn, uint32_t count, Ts*... columns) {
+    for (uint32_t i = 0; i < count; ++i) fn(columns[i]...);
+}
+
+} // namespace ecs_detail
+
+template <typename... Ts>
+Entity World::create(const Ts&... components) {
+    Archetype* archetype = archetypeFor(maskOf<Ts...>());
+    Entity e = place(archetype);
+    const Record& r = records[e.index];
+    ecs_detail::copyComponents(*archetype, archetype->chunk(r.chunk), r.row, components...);
+    return e;
+}
+
+template <typename T>
+void World::add(Entity e, const T& component) {
+    if (!alive(e)) return;
+    int id = componentId<T>();
+    Record& r = records[e.index];
+    if (r.archetype->has(id)) {
+        r.archetype->column<T>(r.archetype->chunk(r.chunk))[r.row] = component;
+        return;
+    }
+    *(T*)move(e, withComponent(r.archetype, id, true), id) = component;
+}
+
+template <typename T>
+void World::remove(Entity e) {
+    if (!alive(e)) return;
+    int id = componentId<T>();
+    Record& r = records[e.index];
+    if (!r.archetype->has(id)) return;
+    move(e, withComponent(r.archetype, id, false), -1);
+}
+
+template <typename T>
+T* World::get(Entity e) {
+    if (!alive(e)) return nullptr;
+    const Record& r = records[e.index];
+    if (!r.archetype->has(componentId<T>())) return nullptr;
+    return r.archetype->column<T>(r.archetype->chunk(r.chunk)) + r.row;
+}
+
+template <typename... Ts, typename Fn>
+void World::eachChunk(Fn fn) {
+    const std::vector<Archetype*>& matches = query(maskOf<Ts...>());
+    for (Archetype* a : matches) {
+        for (size_t c = 0; c < a->chunkCount(); ++c) {
+            Chunk& chunk = a->chunk(c);
+            fn(chunk.count, a->entities(chunk), a->template column<Ts>(chunk)...);
+        }
+    }
+}
+
+template <typename... Ts, typename Fn>
+void World::each(Fn fn) {
+    eachChunk<Ts...>([&](uint32_t count, Entity*, Ts*... columns) { ecs_detail::eachRow(fn, count, columns...); });
+}
+
+template <typename... Ts, typename Fn>
+void World::eachChunkParallel(unsigned int threads, Fn fn) {
+    std::vector<std::pair<Archetype*, Chunk*> > work;
+    for (Archetype* a : query(maskOf<Ts...>())) {
+        for (size_t c = 0; c < a->chunkCount(); ++c) work.push_back(std::make_pair(a, &a->chunk(c)));
+    }
+    runParallel(threads, work.size(), [&](size_t i) {
+        Archetype* a = work[i].first;
+        Chunk& chunk = *work[i].second;
+        fn(chunk.count, a->entities(chunk), a->template column<Ts>(chunk)...);
+    });
+}
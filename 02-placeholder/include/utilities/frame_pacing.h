@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <deque>
+
+class Display;
+
+const int kDriverSwapInterval = -2;
+
+struct PacingSettings {
+    int swapInterval = kDriverSwapInterval; // glfwSwapInterval: 0 off, 1 vsync, -1 adaptive (where supported)
+    double targetFps = 0.0;    // > 0: CPU frame limiter to this rate
+    int maxFramesInFlight = 0; // > 0: wait on fences so the GPU is at most this many frames behind
+    bool lowLatency = false;   // do the limiter's waiting before input is read instead of after the swap
+};
+
+struct PacingStats {
+    int frames = 0;
+    double meanFrameTime = 0.0;   // seconds between endFrame() calls
+    double frameTimeStdDev = 0.0;
+    double minFrameTime = 0.0, maxFrameTime = 0.0;
+    int latencySamples = 0;
+    double meanLatency = 0.0;     // input read -> GPU done with the frame, seconds
+    double maxLatency = 0.0;
+    double limiterTime = 0.0;     // seconds spent sleeping/spinning in the limiter
+    double fenceWaitTime = 0.0;   // seconds blocked on frames in flight
+};
+
+// Frame pacing around the render loop:
+//   beginFrame()   before reading input (low-latency mode waits here)
+//   beforeRender() before the first GL call of the frame (frames-in-flight limit)
+//   endFrame()     right after the swap (fence, limiter)
+// The limiter sleeps until about a millisecond before the deadline and spins the rest, since
+// sleeps overshoot. In low-latency mode the wait moves in front of the input read and is
+// shortened by the predicted CPU time of a frame, so input is sampled as late as possible and
+// the frame still finishes on time.
+// Latency is an estimate: from the input read to the moment its fence is seen signaled, which
+// is when the GPU finished the frame. The display shows it up to a refresh later.
+class FramePacer {
+public:
+    FramePacer() = default;
+    ~FramePacer();
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // Needs the display's context current (sets the swap interval)
+    void init(const PacingSettings& settings, Display& display);
+    void destroy();
+
+    void beginFrame();
+    void beforeRender();
+    void endFrame();
+
+    bool lowLatency() const { return settings.lowLatency; }
+
+    // Stats since the previous call
+    PacingStats takeStats();
+
+private:
+    struct InFlight {
+        GLsync fence;
+        double inputTime;
+    };
+
+    void waitUntil(double deadline);
+    void collectSignaled();
+
+    PacingSettings settings;
+    Display* display = nullptr;
+    double period = 0.0;
+    double deadline = -1.0;
+    double inputTime = 0.0;
+    double predictedWork = 0.0;  // moving average of beginFrame() -> endFrame(), low-latency mode
+    double lastEnd = -1.0;
+    std::deque<InFlight> inFlight;
+
+    // Accumulated since takeStats()
+    int frames = 0;
+    double sum = 0.0, sumSquares = 0.0, minTime = 0.0, maxTime = 0.0;
+    int latencySamples = 0;
+    double latencySum = 0.0, latencyMax = 0.0;
+    double limiterTime = 0.0, fenceWaitTime = 0.0;
+};
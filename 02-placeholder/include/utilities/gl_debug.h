@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// KHR_debug isn't in the 3.3 glad header: object identifiers for GLDebugLog::label()
+#ifndef GL_BUFFER
+#define GL_BUFFER 0x82E0
+#endif
+#ifndef GL_SHADER
+#define GL_SHADER 0x82E1
+#endif
+#ifndef GL_PROGRAM
+#define GL_PROGRAM 0x82E2
+#endif
+#ifndef GL_QUERY
+#define GL_QUERY 0x82E3
+#endif
+
+// One driver message after classification
+struct GLDebugMessage {
+    int frame = 0;
+    double time = 0.0;          // seconds since init()
+    GLenum source = 0, type = 0, severity = 0;
+    GLuint id = 0;
+    const char* kind = "";      // finer than the type for performance warnings: "shader recompile", "stall", ...
+    std::string text;
+    size_t count = 1;           // in the summary: how often it came
+    int lastFrame = 0;
+};
+
+// GL debug output (KHR_debug, or GL 4.3) routed into a JSON lines log. init() loads the entry points
+// by name, since glad here is plain 3.3, and installs glDebugMessageCallback with every message
+// enabled. Output stays asynchronous, so the driver may call back from its own threads: the
+// callback only classifies the message, drops repeats and queues it, and a writer thread does the
+// file I/O. A repeat is the same source, type, id and text; repeats are only counted, and destroy()
+// ends the log with one summary line per distinct message. Errors and high severity messages are
+// printed as well.
+class GLDebugLog {
+public:
+    GLDebugLog() = default;
+    ~GLDebugLog();
+    GLDebugLog(const GLDebugLog&) = delete;
+    GLDebugLog& operator=(const GLDebugLog&) = delete;
+
+    // With the context current. False (after printing why) without debug output or the file.
+    // Messages come without a debug context too, but drivers tend to hold back the expensive checks.
+    bool init(GLADloadproc load, const char* path);
+    // With the context current: stops the callback, flushes the log and writes the summary
+    void destroy();
+    bool enabled() const { return writer.joinable(); }
+
+    // Once per frame, from any thread; the frame number goes into every message after it
+    void endFrame() { frame.fetch_add(1, std::memory_order_relaxed); }
+
+    size_t messageCount() const;
+    size_t distinctCount() const;
+    size_t performanceWarnings() const;
+
+    // Names an object in debug messages and tools (RenderDoc, apitrace). Does nothing without debug output.
+    static void label(GLenum identifier, GLuint name, const char* label);
+
+private:
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar* message, const void* userParam);
+    void receive(GLenum source, GLenum type, GLuint id, GLenum severity, const GLchar* text, GLsizei length);
+    void writeLoop();
+
+    std::ofstream out;
+    std::thread writer;
+    std::atomic<int> frame{0};
+    std::chrono::steady_clock::time_point epoch;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<GLDebugMessage> queue;
+    std::unordered_map<std::string, GLDebugMessage> seen; // by source/type/id/text
+    size_t received = 0, performance = 0;
+    bool stopping = false;
+};
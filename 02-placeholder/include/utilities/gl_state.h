@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+struct GLStateStats {
+    size_t programBinds = 0;
+    size_t textureBinds = 0;
+    size_t vertexArrayBinds = 0;
+    size_t blendChanges = 0;
+    size_t skipped = 0;  // calls that asked for what was already bound
+
+    size_t changes() const { return programBinds + textureBinds + vertexArrayBinds + blendChanges; }
+};
+
+// Remembers the bound program, 2D textures, VAO and blending, and only calls GL when something
+// actually changes. Anything that binds behind its back must be followed by invalidate().
+class GLStateCache {
+public:
+    static const unsigned int kTextureUnits = 8;
+
+    GLStateCache() { invalidate(); }
+
+    // Forget everything: the next call of each kind goes to GL
+    void invalidate();
+
+    void useProgram(unsigned int program);
+    void bindTexture(unsigned int unit, unsigned int texture);  // GL_TEXTURE_2D
+    void bindVertexArray(unsigned int vao);
+    void setBlend(bool enabled);  // GL_BLEND with SRC_ALPHA / ONE_MINUS_SRC_ALPHA
+
+    const GLStateStats& stats() const { return current; }
+    void resetStats() { current = GLStateStats(); }
+
+private:
+    static const unsigned int kUnknown = 0xFFFFFFFFu;
+
+    unsigned int program;
+    unsigned int textures[kTextureUnits];
+    unsigned int activeUnit;
+    unsigned int vertexArray;
+    unsigned int blend;  // 0/1, kUnknown
+    GLStateStats current;
+};
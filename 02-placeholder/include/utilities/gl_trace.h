@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+
+// GL work of one frame, as seen by the trace layer
+struct GLTraceFrame {
+    size_t calls = 0;
+    size_t draws = 0;           // glDraw*, glMultiDraw*
+    size_t binds = 0;           // glBind*, glUseProgram
+    size_t redundantBinds = 0;  // binds of what was bound already
+    size_t uniformUploads = 0;  // glUniform*
+    size_t bytesUploaded = 0;   // buffer/texture data handed to GL, plus buffer ranges mapped for writing
+    double driverMs = 0.0;      // time spent inside GL calls
+};
+
+// GL call tracing on top of glad. install() swaps glad's function pointers for wrappers that
+// count and time every call per entry point, look for redundant binds and upload sizes, and can
+// log each call with its arguments. Until install() nothing is hooked at all.
+// Only compiled with GL_TRACE (debug builds, or -DGL_TRACE=ON); without it these are empty inline
+// functions and glad's pointers are never touched, so release builds pay nothing.
+// The wrappers run on whichever thread has the context; call the rest from that thread too.
+class GLTrace {
+public:
+    static bool available();
+    // After gladLoadGL. With a recordPath every call of the first recordFrames frames (and the
+    // setup before them) is written there.
+    static void install(const char* recordPath = nullptr, int recordFrames = 0);
+    static bool installed();
+    // After the frame's last GL call
+    static void endFrame();
+    static const GLTraceFrame& lastFrame();
+    // The top entry points by time in the driver since install()
+    static void printSummary(std::ostream& out, int top);
+};
+
+#ifndef GL_TRACE
+inline bool GLTrace::available() { return false; }
+inline void GLTrace::install(const char*, int) {}
+inline bool GLTrace::installed() { return false; }
+inline void GLTrace::endFrame() {}
+inline const GLTraceFrame& GLTrace::lastFrame() {
+    static const GLTraceFrame none;
+    return none;
+}
+inline void GLTrace::printSummary(std::ostream&, int) {}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Layout fixed by the GL spec (GL_DRAW_INDIRECT_BUFFER)
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// All meshes share one VBO/EBO/VAO, so every object is just a command record. The commands are
+// built on the CPU each frame and go out with one glMultiDrawElementsIndirect when the driver
+// has GL 4.3 (or ARB_multi_draw_indirect plus ARB_base_instance); on plain 3.3 the same records
+// are replayed with a glDrawElementsInstancedBaseVertex loop.
+// Per-draw data (transform + tint) lives in a texture buffer indexed by a draw id, which comes
+// from an instanced attribute + baseInstance (MDI) or a constant attribute value (fallback).
+class IndirectRenderer {
+public:
+    IndirectRenderer() = default;
+    ~IndirectRenderer();
+    IndirectRenderer(const IndirectRenderer&) = delete;
+    IndirectRenderer& operator=(const IndirectRenderer&) = delete;
+
+    // Returns the mesh index to use with add(). All meshes must be added before init().
+    unsigned int addMesh(const MeshData& mesh);
+    // load is used to fetch the GL 4.3 entry point that glad (3.3) doesn't know about
+    void init(GLADloadproc load, bool allowMultiDraw = true);
+    void destroy();
+
+    void begin();
+    void add(unsigned int mesh, const glm::mat4& transform, const glm::vec4& tint);
+    // The caller binds the shader: it must read its per-draw data from the samplerBuffer on drawDataUnit
+    void submit(int drawDataUnit = 2);
+
+    bool usesMultiDraw() const { return multiDraw != nullptr; }
+    size_t drawCount() const { return commands.size(); }
+
+private:
+    typedef void (APIENTRYP MultiDrawElementsIndirectFn)(GLenum mode, GLenum type, const void* indirect,
+                                                         GLsizei drawcount, GLsizei stride);
+    struct MeshRange {
+        GLuint firstIndex, indexCount;
+        GLint baseVertex;
+    };
+
+    void growDrawIds(size_t count);
+
+    MeshData geometry;                 // everything added so far, freed after init()
+    std::vector<MeshRange> meshes;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<glm::vec4> drawData;   // 5 texels per draw: 4 matrix columns + tint
+
+    MultiDrawElementsIndirectFn multiDraw = nullptr;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int drawIdVBO = 0, indirectBuffer = 0;
+    unsigned int drawDataBuffer = 0, drawDataTexture = 0;
+    size_t drawIdCapacity = 0;
+};
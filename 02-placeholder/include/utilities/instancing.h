@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+
+// Everything that changes per quad. Goes into a per-instance vertex buffer, so one
+// glDrawElementsInstanced draws all of them instead of one glDrawElements + uniforms each.
+struct InstanceData {
+    glm::mat4 transform;   // locations 3..6 (a mat4 attribute takes 4 slots)
+    glm::vec4 uvRect;      // location 7: offset.xy, size.zw inside the texture
+    glm::vec4 tint;        // location 8
+};
+
+class InstancedRenderer {
+public:
+    unsigned int VAO = 0, quadVBO = 0, EBO = 0, instanceVBO = 0;
+
+    InstancedRenderer() = default;
+    ~InstancedRenderer();
+    InstancedRenderer(const InstancedRenderer&) = delete;
+    InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+    void init();
+    // Streams the instances into the instance buffer and issues a single instanced draw.
+    // The caller binds the shader and textures.
+    void draw(const std::vector<InstanceData>& instances);
+    void destroy();
+
+private:
+    size_t capacity = 0; // instances the buffer can hold right now
+};
+
+// Stress scene: count quads on a grid filling the screen, each spinning on its own, with
+// different uv rects and tints. Same content for the instanced and the one-draw-per-quad path.
+void buildStressScene(std::vector<InstanceData>& out, int count, float time);
+// Same, in batches on the job system
+void buildStressScene(std::vector<InstanceData>& out, int count, float time, JobSystem& jobs);
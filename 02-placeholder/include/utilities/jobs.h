@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// Counts unfinished jobs. Jobs started with run(..., counter) add one and drop it when they
+// finish, so a counter at zero means "all of them are done". Other jobs can wait for it to
+// reach zero before they start (the after argument of run()).
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{0};
+    std::mutex mutex;              // guards waiting
+    std::vector<Job*> waiting;     // jobs that start once pending hits zero
+};
+
+// Chase-Lev work-stealing deque of jobs, fixed size. The owning thread pushes and pops at the
+// bottom (LIFO, the data it just touched is still in cache), other threads steal from the top.
+class WorkDeque {
+public:
+    static const int64_t kCapacity = 4096;
+
+    WorkDeque();
+    bool push(Job* job);  // owner only, false when full
+    Job* pop();           // owner only
+    Job* steal();         // any thread
+
+private:
+    std::atomic<int64_t> top{0};
+    char pad[64];
+    std::atomic<int64_t> bottom{0};
+    std::unique_ptr<std::atomic<Job*>[]> slots;
+};
+
+struct JobStats {
+    size_t executed = 0;
+    size_t stolen = 0;
+};
+
+// Worker threads, one deque each, stealing from each other when they run dry.
+// Jobs may be started from the thread that created the system (it has a deque of its own and
+// works too while it waits) or from inside other jobs; not from unrelated threads.
+class JobSystem {
+public:
+    // threads counts the calling thread, 0 -> one per hardware thread
+    explicit JobSystem(unsigned int threads = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned int threadCount() const { return (unsigned int)deques.size(); }
+
+    // name only shows up in the trace, it must outlive the system (a literal)
+    void run(const char* name, std::function<void()> fn, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+    // Runs queued jobs until counter reaches zero. A counter must not go away before this returned.
+    void wait(JobCounter& counter);
+
+    // fn(begin, end) over [0, count), split in batches of at least minBatch items. Every batch
+    // spans a whole number of 64-byte lines worth of items (itemBytes each, 0 -> no rounding), so
+    // if the array starts on a line, threads writing neighbouring batches never share one.
+    // Returns when every batch is done.
+    void parallelFor(const char* name, size_t count, size_t itemBytes, const std::function<void(size_t, size_t)>& fn,
+                     size_t minBatch = 64);
+
+    // Records every job run from now on (thread, start, end, name)
+    void startTrace();
+    // Chrome trace JSON (chrome://tracing, ui.perfetto.dev), call while no jobs are running.
+    // Returns false if the file can't be written.
+    bool writeTrace(const char* path);
+
+    JobStats stats() const;
+    void resetStats();
+
+private:
+    struct TraceEvent {
+        const char* name;
+        double start, end; // microseconds since the system started
+    };
+    struct PerThread {
+        std::atomic<size_t> executed{0}, stolen{0};
+        std::vector<TraceEvent> trace;
+        uint32_t rng = 0;
+        char pad[64];  // counters of different threads on different lines
+    };
+
+    void schedule(Job* job);
+    Job* find(unsigned int self);
+    void execute(Job* job, int self);
+    void finish(JobCounter* counter);
+    void workerLoop(unsigned int index);
+    int currentIndex() const;
+    double now() const;
+
+    std::vector<std::unique_ptr<WorkDeque> > deques;  // [0] belongs to the creating thread
+    std::vector<std::unique_ptr<PerThread> > perThread;
+    std::vector<std::thread> workers;
+    std::thread::id owner;
+
+    std::atomic<int> queued{0};   // jobs sitting in deques, for the sleep decision
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> quit{false};
+    std::atomic<bool> tracing{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::chrono::steady_clock::time_point epoch;
+};
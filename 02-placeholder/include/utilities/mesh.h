@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Same 8 floats per vertex as the hard-coded quad: position, normal (goes where the color was), uv
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+struct MeshLoadStats {
+    double readMs = 0.0;
+    double parseMs = 0.0;
+    double weldMs = 0.0;
+    size_t corners = 0;      // vertices before welding (one per face corner)
+    size_t vertices = 0;     // vertices after welding
+    size_t triangles = 0;
+    bool fromCache = false;
+};
+
+// Regular polygon in the xy plane (radius 0.5), triangle fan from the center. Handy test geometry.
+MeshData makePolygonMesh(int sides);
+
+// Read-only view of a whole file. On POSIX it's a mmap, so the kernel pages it in on demand
+// and we never copy the bytes into our own buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+    void close();
+
+    const char* data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    const char* ptr = nullptr;
+    size_t length = 0;
+    std::vector<char> fallback; // used where mmap isn't available
+};
+
+class MeshLoader {
+public:
+    // threads == 0 -> one per hardware thread
+    explicit MeshLoader(unsigned int threads = 0);
+
+    // Picks the parser by extension (.obj, .gltf, .glb). If a valid "<path>.meshcache" exists
+    // it's used instead, otherwise the cache is written after parsing.
+    bool load(const char* path, MeshData& out);
+
+    bool loadOBJ(const char* path, MeshData& out);
+    bool loadGLTF(const char* path, MeshData& out);
+
+    // Binary cache: header + vertices + indices, laid out exactly as the GPU buffers want them
+    static std::string cachePath(const char* sourcePath);
+    static bool writeCache(const char* cachePath, const char* sourcePath, const MeshData& mesh);
+    static bool isCacheValid(const char* cachePath, const char* sourcePath);
+    static bool readCache(const char* cachePath, MeshData& out);
+
+    unsigned int threadCount() const { return threads; }
+    const MeshLoadStats& lastStats() const { return stats; }
+
+private:
+    unsigned int threads;
+    MeshLoadStats stats;
+};
+
+// GPU side of a mesh: one VAO with the Vertex layout above and an EBO
+class Mesh {
+public:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    GLsizei indexCount = 0;
+
+    Mesh() = default;
+    ~Mesh();
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    void upload(const MeshData& mesh);
+    // Maps the cache file and hands the mapped pages straight to glBufferData, no parsing, no copy
+    bool uploadFromCache(const char* cachePath);
+    void draw() const;
+    // Frees the GL objects, call it while the context is still alive
+    void destroy();
+
+private:
+    void setup(const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+// Command line switches for openGL_project, e.g.
+//   ./openGL_project --mesh ../assets/model.obj
+struct Options {
+    std::string meshPath; // draw this OBJ/glTF instead of the hard-coded quad
+    int stressCount = 0;  // > 0: draw this many textured quads per frame and report CPU time
+    bool naive = false;   // stress scene with one glDrawElements + uniform per quad instead of instancing
+    int spriteCount = 0;  // > 0: draw this many cat/nyan sprites through the SpriteBatch
+    int indirectCount = 0; // > 0: draw this many objects through the IndirectRenderer
+    bool noMultiDraw = false; // force the GL 3.3 draw loop even if glMultiDrawElementsIndirect exists
+    bool cull = false;        // with --indirect: perspective camera + frustum culling before submission
+    double tickRate = 60.0;   // simulation ticks per second
+    int maxTicks = 5;         // most ticks run in one frame before the backlog is dropped
+    bool tickStats = false;   // print tick/frame timing every couple of seconds
+    int materialCount = 0;    // > 0: draw this many quads with different materials through the RenderQueue
+    bool noSort = false;      // with --materials, submit in scene order instead of sorting by key
+    int swapInterval = -2;    // glfwSwapInterval value, -2 leaves the driver default
+    double targetFps = 0.0;   // > 0: frame limiter
+    int framesInFlight = 0;   // > 0: fence-limited frames queued on the GPU
+    bool lowLatency = false;  // limiter waits before input instead of after the swap
+    bool pacingStats = false; // print frame time variance and latency every couple of seconds
+    std::string jobTracePath;  // write a Chrome trace of the jobs run here on exit
+    bool renderThread = false; // GL on its own thread, the main thread only polls input and simulates
+    std::string profilePath;   // enables the CPU/GPU profiler, P (and exit) writes its Chrome trace here
+    bool headless = false;     // EGL context rendering into an FBO, no window (and no GLFW)
+    int width = 800, height = 600; // window / offscreen framebuffer size
+    int frames = 0;            // > 0: quit after this many frames
+    std::string screenshotPath; // write the last frame here (PPM) on exit
+    int benchFrames = 0;       // > 0: render this many frames on a fixed simulated clock and report percentiles
+    std::string benchOutPath;  // with --bench, write the JSON here instead of stdout
+    bool glStats = false;      // GL call counters in the report, top entry points on exit (GL_TRACE builds)
+    std::string glRecordPath;  // log every GL call with its arguments here (GL_TRACE builds)
+    int glRecordFrames = 2;    // frames --gl-record covers, after the setup calls
+    std::string glDebugPath;   // debug context, KHR_debug messages go to this JSON lines log
+    double dynamicResBudget = 0.0; // > 0: scale the scene's resolution to keep its GPU time under this many ms
+    float minScale = 0.5f;     // with --dynamic-res, the lowest scale of the window size
+    float sharpen = 0.0f;      // with --dynamic-res, sharpening of the upscale
+    bool renderGraph = false;  // the frame as render graph passes: scene into a target, bloom, composite
+    float bloom = 0.5f;        // with --render-graph, bloom strength; 0 leaves the bloom passes to be culled
+    std::string postEffects;   // "tonemap,grade,vignette,sharpen": post-processing after the scene (render graph)
+    bool postUnfused = false;  // one pass per post effect instead of fused shaders
+    bool capture = false;      // read every frame back (asynchronously) and hash it on a worker
+    bool syncReadback = false; // readback with a blocking glReadPixels instead of pack buffers
+    int readbackSlots = 3;     // pack buffers in the readback ring
+    std::string recordPath;    // write every frame here: .y4m is YUV 4:2:0, anything else raw RGBA
+    int recordFps = 60;        // frame rate of the recording, which also drives the simulation clock
+};
+
+// Returns false (after printing the usage) on an unknown or incomplete switch
+bool parseOptions(int argc, char** argv, Options& options);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "render_graph.h"
+
+#include <glad/glad.h>
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Shader;
+
+enum class PostEffect {
+    Tonemap,  // exposure + ACES fit, HDR to [0, 1]
+    Grade,    // contrast, saturation, tint
+    Vignette,
+    Sharpen,  // unsharp mask, needs the neighbouring pixels
+};
+
+struct PostSettings {
+    float exposure = 1.2f;
+    float contrast = 1.1f;
+    float saturation = 1.15f;
+    float tint[3] = {1.0f, 0.97f, 0.92f};
+    float vignette = 0.45f; // darkening in the corners
+    float sharpen = 0.5f;
+};
+
+// Estimated memory traffic of one frame of the chain, every pixel read and written once
+struct PostTraffic {
+    int passes = 0;
+    size_t bytesRead = 0, bytesWritten = 0;
+    size_t bytes() const { return bytesRead + bytesWritten; }
+};
+
+// Post-processing after the scene, as render graph passes. Consecutive effects that only look at
+// their own pixel are fused into one generated fragment shader: one pass, no target in between.
+// An effect that samples its neighbours (sharpen) has to read a finished image, so it starts a new
+// pass; the per-pixel effects after it still go into that pass. Unfused, every effect is a pass of
+// its own with a target per step, for comparison.
+class PostChain {
+public:
+    PostChain() = default;
+    ~PostChain();
+    PostChain(const PostChain&) = delete;
+    PostChain& operator=(const PostChain&) = delete;
+
+    // With the context current: generates and compiles a program per pass
+    bool init(const std::vector<PostEffect>& effects, const PostSettings& settings, bool fuse);
+    void destroy();
+
+    // input (HDR, from the scene) -> passes -> output. Intermediate targets are transient.
+    void addPasses(RenderGraph& graph, RGTexture input, RGTexture output, int width, int height);
+
+    PostTraffic traffic(int width, int height) const;
+    // The passes and their effects, and the traffic compared to the other way (fused or not)
+    void printPlan(std::ostream& out, int width, int height) const;
+
+private:
+    struct Stage {
+        std::vector<PostEffect> effects;
+        std::string name;  // "post: tonemap + grade", the graph keeps the pointer
+        std::unique_ptr<Shader> program;
+    };
+
+    static std::vector<Stage> group(const std::vector<PostEffect>& effects, bool fuse);
+    static PostTraffic traffic(const std::vector<Stage>& stages, int width, int height);
+    void setUniforms(Stage& stage);
+
+    std::vector<PostEffect> effects;
+    std::vector<Stage> stages;
+    PostSettings settings;
+    bool fused = true;
+    GLuint emptyVAO = 0;
+};
+
+// "tonemap,grade,vignette,sharpen" -> effects, false on an unknown or repeated name
+bool parsePostEffects(const std::string& list, std::vector<PostEffect>& effects);
+const char* postEffectName(PostEffect effect);
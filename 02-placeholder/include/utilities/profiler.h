@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+// Times the rest of the enclosing block on the calling thread. name must be a literal.
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+// Same for the GL commands issued in the block, measured on the GPU (context thread only)
+#define GPU_PROFILE_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+
+struct GpuTiming {
+    const char* name;
+    int depth;      // nesting level, 0 for the outermost scope
+    double ms;
+};
+
+// Frame profiler, off until setEnabled(true).
+// CPU: every thread records its scopes into a ring of its own (the oldest events get overwritten),
+// so recording takes no locks. While disabled a scope is one relaxed load and a branch.
+// GPU: timestamp queries around gpuBegin/gpuEnd. A frame's queries are read back three frames
+// later, when the GPU is done with them, so reading never stalls; frames the GPU is further
+// behind on than that are dropped. GPU times are shifted onto the CPU clock for the trace.
+// writeTrace() dumps everything as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+class Profiler {
+public:
+    static bool enabled() { return on.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // Microseconds on the profiler's clock
+    static double now();
+    // Shows up in the trace instead of "thread n"
+    static void setThreadName(const std::string& name);
+    static void recordCpu(const char* name, double start, double end);
+
+    // With the context current. gpuBegin/gpuEnd nest; endFrame() once per frame after the
+    // frame's last GPU scope, on the thread that issues the GL commands.
+    static void initGpu();
+    static void destroyGpu();
+    static void gpuBegin(const char* name);
+    static void gpuEnd();
+    static void endFrame();
+    // Scopes of the newest frame read back, and how many frames were dropped so far
+    static const std::vector<GpuTiming>& lastGpuFrame();
+    static int droppedGpuFrames();
+
+    // Call between frames: a thread recording at the same time may tear its oldest events.
+    // Returns false if the file can't be written.
+    static bool writeTrace(const char* path);
+
+private:
+    static std::atomic<bool> on;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : name(Profiler::enabled() ? name : nullptr), start(this->name ? Profiler::now() : 0.0) {}
+    ~ProfileScope() {
+        if (name) Profiler::recordCpu(name, start, Profiler::now());
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    double start;
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name) : active(Profiler::enabled()) {
+        if (active) Profiler::gpuBegin(name);
+    }
+    ~GpuProfileScope() {
+        if (active) Profiler::gpuEnd();
+    }
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    bool active;
+};
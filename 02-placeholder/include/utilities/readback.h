@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One frame read back, RGBA8 with the rows bottom-up like GL has them
+struct ReadbackFrame {
+    int frame = 0;
+    int width = 0, height = 0;
+    const unsigned char* pixels = nullptr; // only valid during the handler
+};
+
+// Runs on the readback worker (or the render thread with synchronous readback), never calls GL
+typedef std::function<void(const ReadbackFrame&)> ReadbackHandler;
+
+struct ReadbackStats {
+    int requested = 0, handled = 0;
+    int dropped = 0;            // every slot was busy
+    int waited = 0;             // every slot was busy and request() waited for one
+    double latencyFrames = 0.0; // mean frames from request() to the pixels being mapped
+    double requestMs = 0.0;     // render thread time in request() + update(), per request
+    double handlerMs = 0.0;     // worker time in the handlers, per frame
+};
+
+// Framebuffer readback without stalling the render loop. request() only queues a glReadPixels
+// into a pixel pack buffer and a fence behind it; the copy runs on the GPU while the next frames
+// are drawn. update() checks the fences without waiting, maps the finished buffers and hands the
+// mapped pointer to a worker thread, which runs the request's handler straight on the mapping (no
+// extra copy). The buffer is unmapped on a later update(), once the worker is done with it.
+// Handlers run one at a time and in request order, even when a later copy finishes first.
+// With a ring of slots requests can be several frames deep; when all of them are busy a request
+// is dropped rather than waited for, unless the caller asks to wait (recording, where every frame
+// counts).
+// Synchronous mode does the same with a plain glReadPixels and the handler called in place, for
+// comparison: that waits for the GPU to finish the frame.
+class AsyncReadback {
+public:
+    AsyncReadback() = default;
+    ~AsyncReadback();
+    AsyncReadback(const AsyncReadback&) = delete;
+    AsyncReadback& operator=(const AsyncReadback&) = delete;
+
+    // With the context current
+    void init(int slots = 3, bool synchronous = false);
+    // Waits for everything requested so far, then frees the buffers
+    void destroy();
+    bool synchronous() const { return sync; }
+
+    // After the frame is drawn into framebuffer (0: the window's back buffer), before the swap.
+    // False if it had to be dropped; with wait it blocks for a free slot instead.
+    bool request(GLuint framebuffer, int width, int height, int frame, ReadbackHandler handler, bool wait = false);
+    // Once per frame on the render thread
+    void update();
+    // Blocks until every request so far went through its handler
+    void flush();
+    bool idle() const;
+
+    ReadbackStats takeStats();
+
+private:
+    enum class State { Free, Reading, Mapped, Handled };
+    struct Slot {
+        GLuint buffer = 0;
+        size_t bytes = 0;
+        GLsync fence = nullptr;
+        ReadbackFrame frame;
+        ReadbackHandler handler;
+        int requestUpdate = 0;
+        std::atomic<State> state{State::Free};
+    };
+
+    Slot* freeSlot();
+    // update() without counting a frame
+    void poll();
+    void workerLoop();
+
+    bool sync = false;
+    std::vector<std::unique_ptr<Slot> > slots;
+    std::vector<unsigned char> syncPixels;
+    std::deque<Slot*> reading;       // in request order, for the render thread only
+    int updates = 0; // update() calls, i.e. frames
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Slot*> queue;
+    bool stopping = false;
+
+    ReadbackStats stats;
+    double latencySum = 0.0;
+    int latencyCount = 0;
+    double handlerSeconds = 0.0; // worker side, under mutex
+    int handlerCount = 0;
+};
+
+// PPM out of a read back frame (for handlers), false if the file can't be written
+bool writePPM(const char* path, const ReadbackFrame& frame);
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+// Handles into one RenderGraph, valid until its next clear()
+struct RGTexture {
+    int index = -1;
+    bool valid() const { return index >= 0; }
+};
+struct RGBuffer {
+    int index = -1;
+    bool valid() const { return index >= 0; }
+};
+
+struct RGTextureDesc {
+    int width = 0, height = 0;
+    GLenum format = GL_RGBA8; // sized internal format: RGBA8, RGBA16F, R11F_G11F_B10F, DEPTH24_STENCIL8, ...
+};
+
+class RenderGraph;
+
+// What a pass's execute function gets: the GL objects behind the handles it declared
+class RenderGraphContext {
+public:
+    GLuint texture(RGTexture handle) const;
+    GLuint buffer(RGBuffer handle) const;
+    // Size of the pass's render target (its viewport), 0 without one
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+
+private:
+    friend class RenderGraph;
+    const RenderGraph* graph = nullptr;
+    int targetWidth = 0, targetHeight = 0;
+};
+
+// Declares a pass's inputs and outputs, returned by RenderGraph::addPass():
+//   graph.addPass("blur", fn).read(bloom).write(blurred);
+// Written textures are the pass's render targets (color attachments in order, or the depth
+// attachment); read ones are sampled. Buffers are only tracked, the pass binds them itself.
+class RenderPassBuilder {
+public:
+    RenderPassBuilder& read(RGTexture texture);
+    RenderPassBuilder& write(RGTexture texture);
+    RenderPassBuilder& read(RGBuffer buffer);
+    RenderPassBuilder& write(RGBuffer buffer);
+    // Never culled, e.g. a pass that only reads something back to the CPU
+    RenderPassBuilder& keep();
+
+private:
+    friend class RenderGraph;
+    RenderPassBuilder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+    RenderGraph& graph;
+    int pass;
+};
+
+struct RenderGraphStats {
+    int passes = 0, culled = 0;
+    int transientTextures = 0, physicalTextures = 0;
+    int transientBuffers = 0, physicalBuffers = 0;
+    size_t bytesWithoutAliasing = 0; // every transient resource in its own object
+    size_t bytesAliased = 0;         // what compile() actually allocated
+    size_t peakLiveBytes = 0;        // the most bytes in use at once, the lower bound for any aliasing
+};
+
+// A frame described as passes and the resources they read and write, rather than as a fixed
+// sequence of GL calls. compile() works out what actually has to run:
+// - Culling: a pass runs only if it writes an imported resource (the framebuffer, a texture that
+//   outlives the frame), is kept, or writes something a running pass reads.
+// - Ordering: every pass writing a resource runs before every pass reading it, otherwise the
+//   declaration order is kept. Passes can be declared in any order as long as there's no cycle.
+// - Aliasing: transient resources only live from the first to the last pass using them. Once one
+//   is dead its GL object goes to the next one that starts later with the same size and format
+//   (buffers: any size, the object grows to the largest). GL has no way to place two textures in
+//   the same memory, so sharing the objects is as close as it gets; it also means no
+//   reallocation between frames, the objects stay until the next compile needs other ones.
+// The graph is meant to be built once and compiled again only when something changes (e.g. the
+// framebuffer size). Call execute() every frame.
+class RenderGraph {
+public:
+    RenderGraph() = default;
+    ~RenderGraph();
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Transient: allocated (or aliased) by compile(), contents undefined until a pass writes them
+    RGTexture createTexture(const char* name, const RGTextureDesc& desc);
+    RGBuffer createBuffer(const char* name, size_t bytes);
+    // Imported: owned by the caller and never aliased, passes writing them are never culled
+    RGTexture importTexture(const char* name, GLuint texture, const RGTextureDesc& desc);
+    RGTexture importFramebuffer(const char* name, GLuint framebuffer, int width, int height);
+    RGBuffer importBuffer(const char* name, GLuint buffer, size_t bytes);
+
+    // Without an execute function the pass is drawn by the caller, see execute()
+    RenderPassBuilder addPass(const char* name, std::function<void(RenderGraphContext&)> execute = nullptr);
+
+    // With the context current: culls, orders, aliases and creates the GL objects.
+    // False (after printing why) on a cycle or an incomplete render target.
+    bool compile();
+    // Runs the compiled passes in order, each with its render target bound and the viewport set.
+    // Stops at a pass without an execute function: its target is bound, returns true and the
+    // caller draws it, then calls execute() again to go on. False once the last pass ran.
+    bool execute();
+
+    // Forgets passes and resources; the GL objects stay for the next compile() to reuse
+    void clear();
+    void destroy();
+
+    const RenderGraphStats& stats() const { return graphStats; }
+    // Execution order, culled passes, lifetimes and which object each transient went to
+    void printSummary(std::ostream& out) const;
+
+private:
+    friend class RenderPassBuilder;
+    friend class RenderGraphContext;
+
+    struct Resource {
+        const char* name;
+        bool isBuffer = false, imported = false;
+        RGTextureDesc desc;
+        size_t bytes = 0;
+        GLuint object = 0;       // imported: the caller's; transient: set by compile()
+        GLuint framebuffer = 0;  // imported framebuffers, object is 0
+        std::vector<int> readers, writers;
+        int first = -1, last = -1; // lifetime, in execution order
+        int physical = -1;
+    };
+    struct Pass {
+        const char* name;
+        std::function<void(RenderGraphContext&)> execute;
+        std::vector<int> reads, writes; // resources
+        bool kept = false, culled = false;
+        GLuint framebuffer = 0;         // made by compile() from the written textures
+        bool ownsFramebuffer = false;
+        int width = 0, height = 0;
+    };
+    // One GL object that transient resources are assigned to
+    struct Physical {
+        bool isBuffer = false;
+        RGTextureDesc desc;
+        size_t bytes = 0;
+        GLuint object = 0;
+        int freeAfter = -1; // last pass of the latest resource on it
+        bool used = false;
+    };
+
+    int addResource(const Resource& resource);
+    bool cullAndOrder();
+    void assignPhysical();
+    bool createObjects();
+    void bindTarget(Pass& pass);
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<int> order; // compiled passes
+    std::vector<Physical> physical;
+    size_t next = 0;        // the pass execute() runs next
+    bool compiled = false;
+    RenderGraphStats graphStats;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+
+// One draw: what to bind and the per-draw "transform" uniform
+struct DrawCommand {
+    unsigned int program = 0;
+    unsigned int material = 0;       // small id, textures[] are what it binds
+    unsigned int textures[2] = {0, 0}; // units 0 and 1
+    unsigned int vao = 0;
+    int indexCount = 0;              // GL_TRIANGLES, GL_UNSIGNED_INT from offset 0
+    bool translucent = false;
+    glm::mat4 transform = glm::mat4(1.0f);
+};
+
+struct SortEntry {
+    uint64_t key;
+    uint32_t index;
+};
+
+// Stable LSD radix sort by key, 8 bits per pass. Bytes that are the same in every key are
+// skipped. With threads > 1 each pass counts and scatters contiguous slices in parallel.
+void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch, unsigned int threads = 1);
+
+// Draws collected during a frame, each with a 64-bit sort key, sorted and then submitted
+// through a GLStateCache. Key layout, most significant first:
+//   layer (4) | translucent (1) | program (10) | material (16) | depth (24, front to back) | 0 (9)
+// Translucent draws need painter's order instead, so for them depth moves up front:
+//   layer (4) | 1 | depth (24, back to front) | program (10) | material (16) | 0 (9)
+// So a layer draws its opaque objects grouped by program then material, then its translucent
+// ones far to near. Equal keys keep the order they were added in.
+class RenderQueue {
+public:
+    // depth in [0, 1], 0 is nearest. program/material are truncated to their field widths,
+    // which can only cost some grouping, never correctness.
+    static uint64_t makeKey(unsigned int layer, bool translucent, unsigned int program, unsigned int material, float depth);
+
+    void clear();
+    void add(const DrawCommand& draw, unsigned int layer = 0, float depth = 0.0f);
+    // threads == 0 -> one per hardware thread (small queues stay on one)
+    void sort(unsigned int threads = 0);
+    // Issues the draws in the current order (add order if sort() wasn't called)
+    void submit(GLStateCache& state);
+
+    // Program/texture/blend switches submit() would make in the current order, without any GL
+    size_t countStateChanges() const;
+    size_t size() const { return commands.size(); }
+
+private:
+    std::vector<DrawCommand> commands;
+    std::vector<SortEntry> order, scratch;
+};
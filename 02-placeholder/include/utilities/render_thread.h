@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "instancing.h"
+
+class Display;
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// Each side only stores its own index and keeps a cached copy of the other one, so most
+// pushes/pops don't touch the other thread's cache line at all.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // Producer only. False if the ring is full.
+    bool push(const T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - cachedTail == Capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h - cachedTail == Capacity) return false;
+        }
+        items[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. False if the ring is empty.
+    bool pop(T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead) return false;
+        }
+        item = items[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Producer side
+    std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    char pad0[64];
+    // Consumer side
+    std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+    char pad1[64];
+    T items[Capacity];
+};
+
+// Everything the render thread needs to draw one frame, filled in by the main thread
+struct FramePacket {
+    int framebufferWidth = 0, framebufferHeight = 0;
+    glm::mat4 quadTransform = glm::mat4(1.0f);
+    std::vector<InstanceData> instances; // stress scene, empty otherwise
+};
+
+struct RenderCommand {
+    enum Type : uint32_t { DrawFrame, Quit };
+    Type type;
+    uint32_t packet; // DrawFrame: which of the two packets to draw
+};
+
+struct RenderThreadStats {
+    int frames = 0;           // frames the render thread drew
+    double submitTime = 0.0;  // render thread, seconds in the render callback
+    double swapTime = 0.0;    // render thread, seconds swapping buffers
+    double waitTime = 0.0;    // main thread, seconds blocked in beginFrame()
+};
+
+// A thread that owns the GL context and draws frame packets.
+// There are two packets: while the render thread submits frame N from one, the main thread
+// polls input and simulates frame N+1 into the other. Commands go main -> render through one
+// SPSC ring, packets the render thread is done with come back through another, so the two
+// threads never take a lock. The main thread runs at most one frame ahead.
+class RenderThread {
+public:
+    RenderThread() = default;
+    ~RenderThread();
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // The calling thread must have released the context (display.makeCurrent(false)).
+    // render(packet) issues the GL calls for a frame, the thread swaps buffers after it.
+    void start(Display& display, std::function<void(const FramePacket&)> render);
+    // Drains the queued frames, joins the thread and makes the context current on the caller again
+    void stop();
+    bool running() const { return worker.joinable(); }
+
+    // Main thread: the packet to fill next, waits while the render thread still reads it
+    FramePacket& beginFrame();
+    // Main thread: queues the packet from beginFrame() for drawing
+    void submitFrame();
+
+    // Stats since the previous call
+    RenderThreadStats takeStats();
+
+private:
+    void loop();
+
+    Display* display = nullptr;
+    std::function<void(const FramePacket&)> render;
+    std::thread worker;
+
+    SpscRing<RenderCommand, 8> commands; // main -> render
+    SpscRing<uint32_t, 4> released;      // render -> main: packets that can be written again
+    FramePacket packets[2];
+
+    // Main thread only
+    bool packetBusy[2] = {false, false};
+    uint32_t current = 0;
+    double waitTime = 0.0;
+
+    // Written by the render thread, read by takeStats()
+    std::atomic<int> framesDrawn{0};
+    std::atomic<int64_t> submitMicros{0}, swapMicros{0};
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+
+// Transform hierarchy stored as flat arrays (parent, local, world, flags), one entry per node,
+// kept in depth-first order: a parent always comes before its children and every subtree is a
+// contiguous range. update() is then one linear pass, a node is recomputed only when its own
+// local matrix or one of its ancestors changed, and disjoint subtrees can go to different threads.
+//
+// Nodes are referred to by the handle add() returns; handles stay valid when the arrays get
+// reordered after the hierarchy changes.
+class SceneGraph {
+public:
+    static const uint32_t kNoParent = 0xFFFFFFFFu;
+
+    uint32_t add(uint32_t parent = kNoParent, const glm::mat4& local = glm::mat4(1.0f));
+    void setLocal(uint32_t node, const glm::mat4& local);
+    const glm::mat4& local(uint32_t node) const { return localMatrix[slotOf[node]]; }
+    // As of the last update()
+    const glm::mat4& world(uint32_t node) const { return worldMatrix[slotOf[node]]; }
+    // Whether the last update() recomputed this node
+    bool changed(uint32_t node) const { return changedFlag[slotOf[node]] != 0; }
+
+    // threads > 1 splits the pass by subtree
+    void update(unsigned int threads = 1);
+    // Same, the subtrees run as jobs
+    void update(JobSystem& jobs);
+
+    size_t size() const { return parent.size(); }
+    // Nodes recomputed by the last update()
+    size_t lastUpdated() const { return updated; }
+
+private:
+    // Clears the changed flags when nothing is dirty (returns false), sorts if needed
+    bool beginUpdate();
+    void sortDepthFirst();
+    void planTasks(unsigned int threads);
+    size_t updateRange(size_t begin, size_t end);
+
+    // Per slot, in depth-first order
+    std::vector<uint32_t> parent;      // slot of the parent, kNoParent for roots
+    std::vector<uint32_t> subtreeEnd;  // one past the last slot of the subtree
+    std::vector<glm::mat4> localMatrix, worldMatrix;
+    std::vector<uint8_t> dirtyFlag;    // local set since the last update
+    std::vector<uint8_t> changedFlag;  // recomputed in the last update
+    std::vector<uint32_t> handleOf;
+
+    std::vector<uint32_t> slotOf;      // per handle
+
+    bool unsorted = false;
+    bool anyDirty = false;
+    size_t updated = 0;
+
+    // Subtree split for threaded updates, rebuilt when the hierarchy or thread count changes
+    std::vector<uint32_t> topNodes;    // slots above the split, updated first on the calling thread
+    std::vector<uint32_t> tasks;       // root slots of the subtrees handed to the workers
+    unsigned int plannedThreads = 0;
+};
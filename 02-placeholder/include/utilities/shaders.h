@@ -14,11 +14,15 @@ class Shader {
 public:
     unsigned int id;
     Shader(const char* vertexPath, const char* fragmentPath);
+    // Generated fragment code (label names it in errors and debug tools), the vertex shader from a file
+    Shader(const char* vertexPath, const std::string& fragmentSource, const std::string& label);
     void activate();
 
     //utility functions
     std::string loadShaderSource(const char* path);
     GLuint compileShader(const char* path, GLenum type);
+    GLuint compileSource(const std::string& source, GLenum type);
+    void link(GLuint vertex, GLuint fragment, const std::string& label);
 
     //uniform functions
     void setMat4(const std::string& name, glm::mat4 val);
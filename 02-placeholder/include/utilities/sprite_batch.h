@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct SpriteVertex {
+    float position[2];
+    uint32_t color;    // RGBA8, normalized by the attribute pointer
+    float texCoord[2];
+};
+
+struct SpriteBatchStats {
+    size_t sprites = 0;
+    size_t flushes = 0;       // buffer uploads
+    size_t draws = 0;         // glDrawElementsBaseVertex calls
+    size_t vertices = 0;
+    size_t stateChanges = 0;  // program + texture binds
+};
+
+// Collects textured quads between begin() and end(), then sorts them by shader/texture,
+// transforms the corners (SSE) into one CPU vertex array and pushes it through a streaming VBO,
+// so N sprites cost a couple of draws instead of N.
+class SpriteBatch {
+public:
+    enum SortMode {
+        SortByState,   // group by program then texture, fewest draws
+        KeepOrder      // submission order (painter's order for overlapping translucent sprites)
+    };
+
+    SpriteBatch() = default;
+    ~SpriteBatch();
+    SpriteBatch(const SpriteBatch&) = delete;
+    SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+    // maxSprites per flush, bigger frames are split in several flushes
+    void init(size_t maxSprites = 16384);
+    void destroy();
+
+    void begin(SortMode mode = SortByState);
+    // position is the sprite center, rotation in radians, uvRect = offset.xy, size.zw
+    void draw(unsigned int program, unsigned int texture, glm::vec2 position, glm::vec2 size, float rotation,
+              glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), glm::vec4 color = glm::vec4(1.0f));
+    // The programs must have a "projection" mat4 uniform; it's set on every program bind
+    void end(const glm::mat4& projection);
+
+    const SpriteBatchStats& stats() const { return lastStats; }
+
+private:
+    struct Sprite {
+        float x, y, halfW, halfH, cosR, sinR;
+        float u, v, du, dv;
+        uint32_t color;
+        unsigned int program, texture;
+    };
+
+    void flush(const uint64_t* keys, size_t count, const glm::mat4& projection);
+    void transform(const Sprite& sprite, SpriteVertex* out) const;
+
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    size_t maxSprites = 0;
+    size_t ringVertices = 0;  // VBO size in vertices
+    size_t ringOffset = 0;    // next free vertex in the VBO
+    SortMode mode = SortByState;
+
+    std::vector<Sprite> sprites;
+    std::vector<uint64_t> keys;
+    std::vector<SpriteVertex> vertices;
+    unsigned int boundProgram = 0, boundTexture = 0;
+    SpriteBatchStats currentStats, lastStats;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <functional>
+
+struct TimestepStats {
+    int frames = 0;
+    int ticks = 0;
+    int maxTicksInFrame = 0;
+    int cappedFrames = 0;      // frames that hit maxTicksPerFrame and dropped time
+    double droppedTime = 0.0;  // seconds of simulation thrown away by the cap
+    double tickCpuTime = 0.0;  // seconds spent inside the tick callback
+    double maxFrameTime = 0.0; // longest gap between two frames, seconds
+    double elapsed = 0.0;      // wall time covered by these stats, seconds
+};
+
+// Fixed timestep: the simulation always advances in ticks of exactly 1/tickRate seconds,
+// however fast or slow frames come. Each frame runs as many ticks as the elapsed time pays for
+// (possibly none) and the renderer blends the last two simulated states with alpha().
+// After a long stall (breakpoint, window drag) at most maxTicksPerFrame ticks are run and the
+// rest of the backlog is dropped, so a slow simulation can't keep falling further behind.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double tickRate = 60.0, int maxTicksPerFrame = 5);
+
+    // Call once per frame with the current time; runs tick(dt) zero or more times
+    void update(double now, const std::function<void(double)>& tick);
+
+    double tickLength() const { return dt; }
+    // How far the current frame is between the previous tick and the last one, in [0, 1)
+    float alpha() const { return (float)(accumulator / dt); }
+    // Simulation time of the last tick, and the time the interpolated state corresponds to
+    double simulationTime() const { return ticks * dt; }
+    double renderTime() const { return (ticks - 1) * dt + accumulator; }
+
+    const TimestepStats& stats() const { return current; }
+    void resetStats() { current = TimestepStats(); }
+
+private:
+    double dt;
+    int maxTicks;
+    double accumulator = 0.0;
+    double lastTime = -1.0;
+    long long ticks = 0;
+    TimestepStats current;
+};
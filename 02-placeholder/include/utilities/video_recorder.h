@@ -0,0 +1,93 @@
+#pragma once
+
+#include "batch_math.h"
+#include "readback.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// RGBA8 (rows bottom-up, as read back from GL) to planar YUV 4:2:0, BT.601 limited range, top-down.
+// Chroma is the average of each 2x2 block; odd sizes repeat the last row/column. y is width x height,
+// u and v are (width + 1) / 2 x (height + 1) / 2. SSE2 does 16 pixels of two rows at a time.
+void convertToYUV420(const uint8_t* rgba, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v,
+                     MathPath path = MathPath::Auto);
+// What convertToYUV420 runs for Auto (and AVX2): SSE on x86, else Scalar
+MathPath yuvConvertPath();
+
+struct VideoRecorderStats {
+    int frames = 0;
+    size_t bytes = 0;
+    double convertMs = 0.0;   // per frame, on the readback worker
+    double writeMs = 0.0;     // per frame, on the writer thread
+    int stalls = 0;           // frames that had to wait for a free buffer (the disk is behind)
+    int outOfOrder = 0;       // frames not newer than the last one written, skipped
+    int wrongSize = 0;        // frames of another size than the recording, skipped
+};
+
+// Writes rendered frames to a .y4m (YUV 4:2:0) or, for any other extension, raw RGBA top-down
+// (ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r fps -i file). addFrame() is meant to be a readback
+// handler: it converts straight out of the mapped pack buffer on the readback worker, into one of
+// a few frame buffers, and a writer thread appends those to the file. Writes go out in 8 MB
+// blocks from a page aligned buffer with stdio's own buffering off, so the file sees few large
+// aligned writes. When every frame buffer is waiting for the disk, addFrame() blocks, which
+// backs up the readback ring and in turn the render loop: nothing is dropped.
+class VideoRecorder {
+public:
+    VideoRecorder() = default;
+    ~VideoRecorder();
+    VideoRecorder(const VideoRecorder&) = delete;
+    VideoRecorder& operator=(const VideoRecorder&) = delete;
+
+    // False (after printing why) if the file can't be created or the buffers allocated
+    bool open(const char* path, int width, int height, int fps);
+    // Writes what's queued and closes the file
+    void close();
+    bool isOpen() const { return file != nullptr; }
+    bool y4m() const { return yuv; }
+
+    // From any one thread at a time, in frame order: a frame whose number isn't above the last
+    // one's is skipped and counted, and so is a frame of another size. Gaps are fine.
+    void addFrame(const ReadbackFrame& frame);
+
+    VideoRecorderStats stats() const;
+
+private:
+    static const size_t kBlockSize = 8 << 20;
+    static const int kFrameBuffers = 3;
+
+    struct Buffer {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    void releaseBuffers();
+    void writerLoop();
+    void append(const uint8_t* data, size_t size);
+    void writeBlock(size_t size);
+
+    FILE* file = nullptr;
+    bool yuv = true;
+    int width = 0, height = 0;
+    size_t frameBytes = 0;
+
+    std::vector<Buffer> buffers;     // kFrameBuffers encoded frames
+    std::vector<Buffer*> freeBuffers;
+    std::deque<Buffer*> queue;       // waiting for the writer
+    uint8_t* block = nullptr;        // kBlockSize, page aligned
+    size_t blockUsed = 0;
+
+    std::thread writer;
+    mutable std::mutex mutex;
+    std::condition_variable wake, bufferFree;
+    bool stopping = false;
+    VideoRecorderStats totals;       // convertMs/writeMs summed until stats()
+    int lastFrame = -1;
+    bool writeFailed = false;
+};
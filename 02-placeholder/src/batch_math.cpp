@@ -0,0 +1,343 @@
+#include "../include/utilities/batch_math.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Same split as the culling kernels: SSE2 is baseline on x86-64, the AVX2 + FMA kernels are
+// compiled for those on their own and only called after checking the CPU at runtime.
+#define MATH_X86 1
+#define MATH_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#elif defined(_M_X64)
+#define MATH_X86 1
+#include <immintrin.h>
+#endif
+
+void TransformArrays::add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    px.push_back(position.x);
+    py.push_back(position.y);
+    pz.push_back(position.z);
+    qx.push_back(rotation.x);
+    qy.push_back(rotation.y);
+    qz.push_back(rotation.z);
+    qw.push_back(rotation.w);
+    sx.push_back(scale.x);
+    sy.push_back(scale.y);
+    sz.push_back(scale.z);
+}
+
+void TransformArrays::resize(size_t count) {
+    std::vector<float>* arrays[] = {&px, &py, &pz, &qx, &qy, &qz, &qw, &sx, &sy, &sz};
+    for (std::vector<float>* a : arrays) a->resize(count);
+}
+
+void TransformArrays::clear() {
+    resize(0);
+}
+
+namespace {
+
+inline const float* at(const void* base, size_t i, size_t stride) {
+    return (const float*)((const char*)base + i * stride);
+}
+inline float* at(void* base, size_t i, size_t stride) {
+    return (float*)((char*)base + i * stride);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Scalar, also used for the leftovers of the SIMD loops
+
+void multiplyScalar(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t begin, size_t end,
+                    size_t inStride, size_t outStride) {
+    for (size_t i = begin; i < end; ++i) {
+        *(glm::mat4*)at(out, i, outStride) = left * *(const glm::mat4*)at(in, i, inStride);
+    }
+}
+
+void transformScalar(const glm::mat4& m, const glm::vec3* in, glm::vec4* out, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) out[i] = m * glm::vec4(in[i], 1.0f);
+}
+
+void composeScalar(const TransformArrays& t, glm::mat4* out, size_t begin, size_t end, size_t outStride) {
+    for (size_t i = begin; i < end; ++i) {
+        float x = t.qx[i], y = t.qy[i], z = t.qz[i], w = t.qw[i];
+        float* m = at(out, i, outStride);
+        m[0] = (1.0f - 2.0f * (y * y + z * z)) * t.sx[i];
+        m[1] = 2.0f * (x * y + w * z) * t.sx[i];
+        m[2] = 2.0f * (x * z - w * y) * t.sx[i];
+        m[3] = 0.0f;
+        m[4] = 2.0f * (x * y - w * z) * t.sy[i];
+        m[5] = (1.0f - 2.0f * (x * x + z * z)) * t.sy[i];
+        m[6] = 2.0f * (y * z + w * x) * t.sy[i];
+        m[7] = 0.0f;
+        m[8] = 2.0f * (x * z + w * y) * t.sz[i];
+        m[9] = 2.0f * (y * z - w * x) * t.sz[i];
+        m[10] = (1.0f - 2.0f * (x * x + y * y)) * t.sz[i];
+        m[11] = 0.0f;
+        m[12] = t.px[i];
+        m[13] = t.py[i];
+        m[14] = t.pz[i];
+        m[15] = 1.0f;
+    }
+}
+
+#ifdef MATH_X86
+
+// ---------------------------------------------------------------------------------------------
+// SSE: one matrix (or point) per iteration for the products, 4 transforms at a time for TRS.
+// Nothing here needs more than SSE2 (SSE4.1's dot product instruction is slower than the
+// broadcast + multiply-add form for column-major matrices).
+
+void multiplySSE(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count, size_t inStride,
+                 size_t outStride) {
+    const float* l = &left[0][0];
+    __m128 l0 = _mm_loadu_ps(l), l1 = _mm_loadu_ps(l + 4), l2 = _mm_loadu_ps(l + 8), l3 = _mm_loadu_ps(l + 12);
+    for (size_t i = 0; i < count; ++i) {
+        const float* m = at(in, i, inStride);
+        float* o = at(out, i, outStride);
+        for (int c = 0; c < 4; ++c) {
+            __m128 col = _mm_loadu_ps(m + 4 * c);
+            __m128 r = _mm_mul_ps(l0, _mm_shuffle_ps(col, col, 0x00));
+            r = _mm_add_ps(r, _mm_mul_ps(l1, _mm_shuffle_ps(col, col, 0x55)));
+            r = _mm_add_ps(r, _mm_mul_ps(l2, _mm_shuffle_ps(col, col, 0xAA)));
+            r = _mm_add_ps(r, _mm_mul_ps(l3, _mm_shuffle_ps(col, col, 0xFF)));
+            _mm_storeu_ps(o + 4 * c, r);
+        }
+    }
+}
+
+void transformSSE(const glm::mat4& m, const glm::vec3* in, glm::vec4* out, size_t count) {
+    const float* l = &m[0][0];
+    __m128 c0 = _mm_loadu_ps(l), c1 = _mm_loadu_ps(l + 4), c2 = _mm_loadu_ps(l + 8), c3 = _mm_loadu_ps(l + 12);
+    for (size_t i = 0; i < count; ++i) {
+        __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in[i].x)), c3);
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[i].y)));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[i].z)));
+        _mm_storeu_ps(&out[i].x, r);
+    }
+}
+
+void composeSSE(const TransformArrays& t, glm::mat4* out, size_t count, size_t outStride) {
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(&t.qx[i]), y = _mm_loadu_ps(&t.qy[i]), z = _mm_loadu_ps(&t.qz[i]),
+               w = _mm_loadu_ps(&t.qw[i]);
+        __m128 sx = _mm_loadu_ps(&t.sx[i]), sy = _mm_loadu_ps(&t.sy[i]), sz = _mm_loadu_ps(&t.sz[i]);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        // cols[c][r]: element r of column c, for the 4 transforms
+        __m128 cols[4][4];
+        cols[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        cols[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        cols[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        cols[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        cols[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        cols[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        cols[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        cols[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        cols[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+        cols[0][3] = cols[1][3] = cols[2][3] = zero;
+        cols[3][0] = _mm_loadu_ps(&t.px[i]);
+        cols[3][1] = _mm_loadu_ps(&t.py[i]);
+        cols[3][2] = _mm_loadu_ps(&t.pz[i]);
+        cols[3][3] = one;
+
+        // Transposing each column turns "row r of 4 transforms" into "column of transform k"
+        for (int c = 0; c < 4; ++c) {
+            _MM_TRANSPOSE4_PS(cols[c][0], cols[c][1], cols[c][2], cols[c][3]);
+            for (int k = 0; k < 4; ++k) _mm_storeu_ps(at(out, i + k, outStride) + 4 * c, cols[c][k]);
+        }
+    }
+    composeScalar(t, out, i, count, outStride);
+}
+
+#endif // MATH_X86
+
+#ifdef MATH_AVX2
+
+// ---------------------------------------------------------------------------------------------
+// AVX2 + FMA: two columns per register for the products, 8 points / transforms at a time
+
+AVX2_TARGET void multiplyAVX2(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count,
+                              size_t inStride, size_t outStride) {
+    // Each column of left twice, one copy per 128-bit lane
+    const __m128* l = (const __m128*)&left[0][0];
+    __m256 l0 = _mm256_broadcast_ps(l), l1 = _mm256_broadcast_ps(l + 1), l2 = _mm256_broadcast_ps(l + 2),
+           l3 = _mm256_broadcast_ps(l + 3);
+    for (size_t i = 0; i < count; ++i) {
+        const float* m = at(in, i, inStride);
+        float* o = at(out, i, outStride);
+        for (int half = 0; half < 2; ++half) {
+            __m256 cols = _mm256_loadu_ps(m + 8 * half);
+            __m256 r = _mm256_mul_ps(l0, _mm256_permute_ps(cols, 0x00));
+            r = _mm256_fmadd_ps(l1, _mm256_permute_ps(cols, 0x55), r);
+            r = _mm256_fmadd_ps(l2, _mm256_permute_ps(cols, 0xAA), r);
+            r = _mm256_fmadd_ps(l3, _mm256_permute_ps(cols, 0xFF), r);
+            _mm256_storeu_ps(o + 8 * half, r);
+        }
+    }
+}
+
+// 4 registers holding element 0..3 of 8 things -> e[k] holds thing k in its low lane and
+// thing k + 4 in its high lane
+AVX2_TARGET inline void transpose8x4(__m256 a, __m256 b, __m256 c, __m256 d, __m256 e[4]) {
+    __m256 t0 = _mm256_unpacklo_ps(a, b), t1 = _mm256_unpackhi_ps(a, b);
+    __m256 t2 = _mm256_unpacklo_ps(c, d), t3 = _mm256_unpackhi_ps(c, d);
+    e[0] = _mm256_shuffle_ps(t0, t2, 0x44);
+    e[1] = _mm256_shuffle_ps(t0, t2, 0xEE);
+    e[2] = _mm256_shuffle_ps(t1, t3, 0x44);
+    e[3] = _mm256_shuffle_ps(t1, t3, 0xEE);
+}
+
+AVX2_TARGET void transformAVX2(const glm::mat4& m, const glm::vec3* in, glm::vec4* out, size_t count) {
+    __m256 e[4][4];
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) e[c][r] = _mm256_set1_ps(m[c][r]);
+    }
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Deinterleave 8 xyz triples into x, y and z registers
+        const float* p = &in[i].x;
+        __m256 m03 = _mm256_castps128_ps256(_mm_loadu_ps(p));
+        __m256 m14 = _mm256_castps128_ps256(_mm_loadu_ps(p + 4));
+        __m256 m25 = _mm256_castps128_ps256(_mm_loadu_ps(p + 8));
+        m03 = _mm256_insertf128_ps(m03, _mm_loadu_ps(p + 12), 1);
+        m14 = _mm256_insertf128_ps(m14, _mm_loadu_ps(p + 16), 1);
+        m25 = _mm256_insertf128_ps(m25, _mm_loadu_ps(p + 20), 1);
+        __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        __m256 x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+        __m256 y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256 z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+
+        __m256 r[4];
+        for (int k = 0; k < 4; ++k) {
+            r[k] = _mm256_fmadd_ps(e[0][k], x, _mm256_fmadd_ps(e[1][k], y, _mm256_fmadd_ps(e[2][k], z, e[3][k])));
+        }
+        __m256 v[4];
+        transpose8x4(r[0], r[1], r[2], r[3], v);
+        float* o = &out[i].x;
+        _mm256_storeu_ps(o, _mm256_permute2f128_ps(v[0], v[1], 0x20));
+        _mm256_storeu_ps(o + 8, _mm256_permute2f128_ps(v[2], v[3], 0x20));
+        _mm256_storeu_ps(o + 16, _mm256_permute2f128_ps(v[0], v[1], 0x31));
+        _mm256_storeu_ps(o + 24, _mm256_permute2f128_ps(v[2], v[3], 0x31));
+    }
+    transformScalar(m, in, out, i, count);
+}
+
+AVX2_TARGET void composeAVX2(const TransformArrays& t, glm::mat4* out, size_t count, size_t outStride) {
+    const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(&t.qx[i]), y = _mm256_loadu_ps(&t.qy[i]), z = _mm256_loadu_ps(&t.qz[i]),
+               w = _mm256_loadu_ps(&t.qw[i]);
+        __m256 sx = _mm256_loadu_ps(&t.sx[i]), sy = _mm256_loadu_ps(&t.sy[i]), sz = _mm256_loadu_ps(&t.sz[i]);
+        __m256 x2 = _mm256_mul_ps(two, x), y2 = _mm256_mul_ps(two, y), z2 = _mm256_mul_ps(two, z);
+        __m256 xx = _mm256_mul_ps(x2, x), yy = _mm256_mul_ps(y2, y), zz = _mm256_mul_ps(z2, z);
+        __m256 xy = _mm256_mul_ps(x2, y), xz = _mm256_mul_ps(x2, z), yz = _mm256_mul_ps(y2, z);
+        __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+        __m256 cols[4][4];
+        cols[0][0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+        cols[0][1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+        cols[0][2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+        cols[1][0] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+        cols[1][1] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+        cols[1][2] = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+        cols[2][0] = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+        cols[2][1] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+        cols[2][2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+        cols[0][3] = cols[1][3] = cols[2][3] = zero;
+        cols[3][0] = _mm256_loadu_ps(&t.px[i]);
+        cols[3][1] = _mm256_loadu_ps(&t.py[i]);
+        cols[3][2] = _mm256_loadu_ps(&t.pz[i]);
+        cols[3][3] = one;
+
+        for (int c = 0; c < 4; ++c) {
+            __m256 v[4];
+            transpose8x4(cols[c][0], cols[c][1], cols[c][2], cols[c][3], v);
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_ps(at(out, i + k, outStride) + 4 * c, _mm256_castps256_ps128(v[k]));
+                _mm_storeu_ps(at(out, i + k + 4, outStride) + 4 * c, _mm256_extractf128_ps(v[k], 1));
+            }
+        }
+    }
+    composeScalar(t, out, i, count, outStride);
+}
+
+#endif // MATH_AVX2
+
+MathPath resolve(MathPath path) {
+    if (path == MathPath::Auto) return bestMathPath();
+    // Asking for a path doesn't make the CPU support it: never go past what it has
+    if (path > bestMathPath()) path = bestMathPath();
+#ifndef MATH_AVX2
+    if (path == MathPath::AVX2) path = MathPath::SSE;
+#endif
+#ifndef MATH_X86
+    if (path == MathPath::SSE) path = MathPath::Scalar;
+#endif
+    return path;
+}
+
+} // namespace
+
+MathPath bestMathPath() {
+#ifdef MATH_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (avx2) return MathPath::AVX2;
+#endif
+#ifdef MATH_X86
+    return MathPath::SSE;
+#else
+    return MathPath::Scalar;
+#endif
+}
+
+const char* mathPathName(MathPath path) {
+    switch (resolve(path)) {
+        case MathPath::AVX2: return "avx2";
+        case MathPath::SSE: return "sse";
+        default: return "scalar";
+    }
+}
+
+void multiplyMatrices(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count, MathPath path,
+                      size_t inStride, size_t outStride) {
+    switch (resolve(path)) {
+#ifdef MATH_AVX2
+        case MathPath::AVX2: multiplyAVX2(left, in, out, count, inStride, outStride); return;
+#endif
+#ifdef MATH_X86
+        case MathPath::SSE: multiplySSE(left, in, out, count, inStride, outStride); return;
+#endif
+        default: multiplyScalar(left, in, out, 0, count, inStride, outStride); return;
+    }
+}
+
+void transformPoints(const glm::mat4& m, const glm::vec3* in, glm::vec4* out, size_t count, MathPath path) {
+    switch (resolve(path)) {
+#ifdef MATH_AVX2
+        case MathPath::AVX2: transformAVX2(m, in, out, count); return;
+#endif
+#ifdef MATH_X86
+        case MathPath::SSE: transformSSE(m, in, out, count); return;
+#endif
+        default: transformScalar(m, in, out, 0, count); return;
+    }
+}
+
+void composeTRS(const TransformArrays& transforms, glm::mat4* out, MathPath path, size_t outStride) {
+    size_t count = transforms.size();
+    switch (resolve(path)) {
+#ifdef MATH_AVX2
+        case MathPath::AVX2: composeAVX2(transforms, out, count, outStride); return;
+#endif
+#ifdef MATH_X86
+        case MathPath::SSE: composeSSE(transforms, out, count, outStride); return;
+#endif
+        default: composeScalar(transforms, out, 0, count, outStride); return;
+    }
+}
@@ -0,0 +1,119 @@
+#include "../include/utilities/bench_recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace {
+
+void writeString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char)c < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+void writePercentiles(std::ostream& out, const char* name, const std::vector<double>& samples) {
+    Percentiles p = percentiles(samples);
+    out << "  \"" << name << "\": {\"samples\": " << samples.size() << ", \"mean\": " << p.mean << ", \"p50\": "
+        << p.p50 << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << "},\n";
+}
+
+} // namespace
+
+Percentiles percentiles(std::vector<double> samples) {
+    Percentiles p;
+    if (samples.empty()) return p;
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double q) { return samples[std::max<size_t>(1, (size_t)std::ceil(q * samples.size())) - 1]; };
+    double sum = 0.0;
+    for (double s : samples) sum += s;
+    p.mean = sum / samples.size();
+    p.p50 = rank(0.50);
+    p.p95 = rank(0.95);
+    p.p99 = rank(0.99);
+    p.max = samples.back();
+    return p;
+}
+
+uint64_t hashBytes(const std::vector<unsigned char>& bytes) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char b : bytes) {
+        h ^= b;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+BenchRecorder::~BenchRecorder() {
+    destroy();
+}
+
+void BenchRecorder::init(int warmupFrames) {
+    warmup = warmupFrames;
+    glGenQueries(kQueries, queries);
+    std::fill(queryFrame, queryFrame + kQueries, -1);
+    frame = 0;
+    cpuMs.clear();
+    gpuMs.clear();
+}
+
+void BenchRecorder::destroy() {
+    if (queries[0]) glDeleteQueries(kQueries, queries);
+    std::fill(queries, queries + kQueries, 0u);
+}
+
+void BenchRecorder::collect(int slot) {
+    if (queryFrame[slot] < 0) return;
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &ns);
+    gpuMs[queryFrame[slot]] = ns * 1e-6;
+    queryFrame[slot] = -1;
+}
+
+void BenchRecorder::beginFrame() {
+    int slot = frame % kQueries;
+    collect(slot);
+    cpuMs.push_back(0.0);
+    gpuMs.push_back(0.0);
+    queryFrame[slot] = frame;
+    frameStart = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+}
+
+void BenchRecorder::endFrame() {
+    glEndQuery(GL_TIME_ELAPSED);
+    cpuMs[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    ++frame;
+}
+
+void BenchRecorder::finish() {
+    for (int slot = 0; slot < kQueries; ++slot) collect(slot);
+}
+
+std::vector<double> BenchRecorder::cpuTimes() const {
+    return std::vector<double>(cpuMs.begin() + std::min<size_t>(warmup, cpuMs.size()), cpuMs.end());
+}
+
+std::vector<double> BenchRecorder::gpuTimes() const {
+    return std::vector<double>(gpuMs.begin() + std::min<size_t>(warmup, gpuMs.size()), gpuMs.end());
+}
+
+void BenchRecorder::writeJson(std::ostream& out, const BenchResult& result) const {
+    out << std::fixed << std::setprecision(4) << "{\n  \"scene\": ";
+    writeString(out, result.scene);
+    out << ",\n  \"arguments\": ";
+    writeString(out, result.arguments);
+    out << ",\n  \"renderer\": ";
+    writeString(out, result.renderer);
+    out << ",\n  \"width\": " << result.width << ",\n  \"height\": " << result.height << ",\n  \"frames\": "
+        << cpuMs.size() << ",\n  \"warmup_frames\": " << std::min<size_t>(warmup, cpuMs.size())
+        << ",\n  \"simulated_frame_time\": " << result.simulatedFrameTime << ",\n";
+    writePercentiles(out, "cpu_ms", cpuTimes());
+    writePercentiles(out, "gpu_ms", gpuTimes());
+    out << "  \"framebuffer_hash\": \"" << std::hex << std::setw(16) << std::setfill('0') << result.framebufferHash
+        << std::dec << std::setfill(' ') << "\"\n}\n";
+}
@@ -0,0 +1,500 @@
+#include "../include/utilities/bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BVH_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int kBins = 16;
+const uint32_t kLeafSize = 4;
+const int32_t kEmptyChild = INT32_MIN;
+const uint32_t kNoParent = 0xFFFFFFFFu;
+
+} // namespace
+
+void AABB::grow(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+void AABB::grow(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+float AABB::surfaceArea() const {
+    glm::vec3 d = max - min;
+    if (d.x < 0.0f) return 0.0f;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Build: binary tree with binned SAH. Each node covers a contiguous range of refs, so the final
+// refs order is the leaf order.
+
+struct BVH::BuildNode {
+    AABB bounds;
+    std::unique_ptr<BuildNode> left, right;
+    uint32_t first = 0, count = 0;
+    bool leaf() const { return !left; }
+};
+
+// Objects are copied into refs together with their centers and reordered in place as the tree
+// is split, so every pass over a node's range reads memory linearly
+struct BVH::Builder {
+    struct Ref {
+        AABB box;
+        glm::vec3 center;
+        uint32_t index;
+    };
+    std::vector<Ref> refs;
+
+    explicit Builder(const std::vector<AABB>& boxes) : refs(boxes.size()) {
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            refs[i].box = boxes[i];
+            refs[i].center = boxes[i].center();
+            refs[i].index = (uint32_t)i;
+        }
+    }
+
+    void build(BuildNode* node, uint32_t first, uint32_t count, int spawnDepth) {
+        node->first = first;
+        node->count = count;
+        AABB centroidBounds;
+        for (uint32_t i = first; i < first + count; ++i) {
+            node->bounds.grow(refs[i].box);
+            centroidBounds.grow(refs[i].center);
+        }
+        if (count <= kLeafSize) return;
+
+        // Bin the centroids on all three axes in one pass over the objects, then sweep each axis
+        // for the cheapest split
+        glm::vec3 lo = centroidBounds.min, extent = centroidBounds.max - centroidBounds.min;
+        glm::vec3 scale(extent.x > 0.0f ? kBins / extent.x : 0.0f, extent.y > 0.0f ? kBins / extent.y : 0.0f,
+                        extent.z > 0.0f ? kBins / extent.z : 0.0f);
+        AABB binBounds[3][kBins];
+        uint32_t binCount[3][kBins] = {{0}};
+        for (uint32_t i = first; i < first + count; ++i) {
+            const glm::vec3& c = refs[i].center;
+            const AABB& box = refs[i].box;
+            for (int axis = 0; axis < 3; ++axis) {
+                int b = std::min(kBins - 1, (int)((c[axis] - lo[axis]) * scale[axis]));
+                binBounds[axis][b].grow(box);
+                ++binCount[axis][b];
+            }
+        }
+
+        int bestAxis = -1, bestSplit = 0;
+        float bestCost = node->bounds.surfaceArea() * count; // cost of not splitting
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 0.0f) continue;
+            float rightArea[kBins];
+            uint32_t rightCount[kBins];
+            AABB acc;
+            uint32_t n = 0;
+            for (int b = kBins - 1; b > 0; --b) {
+                acc.grow(binBounds[axis][b]);
+                n += binCount[axis][b];
+                rightArea[b] = acc.surfaceArea();
+                rightCount[b] = n;
+            }
+            acc = AABB();
+            n = 0;
+            for (int split = 1; split < kBins; ++split) {
+                acc.grow(binBounds[axis][split - 1]);
+                n += binCount[axis][split - 1];
+                if (n == 0 || rightCount[split] == 0) continue;
+                float cost = acc.surfaceArea() * n + rightArea[split] * rightCount[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        uint32_t middle;
+        if (bestAxis >= 0) {
+            Ref* begin = refs.data() + first;
+            int axis = bestAxis, split = bestSplit;
+            float axisLo = lo[axis], axisScale = scale[axis];
+            middle = (uint32_t)(std::partition(begin, begin + count, [&](const Ref& r) {
+                return std::min(kBins - 1, (int)((r.center[axis] - axisLo) * axisScale)) < split;
+            }) - refs.data());
+        }
+        else {
+            // Splitting doesn't pay off (or every centroid is the same point): just halve it
+            middle = first + count / 2;
+        }
+
+        node->left.reset(new BuildNode());
+        node->right.reset(new BuildNode());
+        if (spawnDepth > 0) {
+            BuildNode* left = node->left.get();
+            std::thread worker([=]() { build(left, first, middle - first, spawnDepth - 1); });
+            build(node->right.get(), middle, first + count - middle, spawnDepth - 1);
+            worker.join();
+        }
+        else {
+            build(node->left.get(), first, middle - first, 0);
+            build(node->right.get(), middle, first + count - middle, 0);
+        }
+    }
+};
+
+namespace {
+
+void setSlot(float* minX, float* minY, float* minZ, float* maxX, float* maxY, float* maxZ, int slot, const AABB& box) {
+    minX[slot] = box.min.x;
+    minY[slot] = box.min.y;
+    minZ[slot] = box.min.z;
+    maxX[slot] = box.max.x;
+    maxY[slot] = box.max.y;
+    maxZ[slot] = box.max.z;
+}
+
+} // namespace
+
+void BVH::build(const std::vector<AABB>& input, unsigned int threads) {
+    nodes.clear();
+    ranges.clear();
+    parents.clear();
+    objects.clear();
+    depth = 0;
+    if (input.empty()) return;
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    int spawnDepth = 0;
+    while ((1u << spawnDepth) < threads) ++spawnDepth;
+
+    BuildNode root;
+    Builder builder(input);
+    builder.build(&root, 0, (uint32_t)input.size(), spawnDepth);
+
+    objects.resize(input.size());
+    objectLeaf.resize(input.size());
+    objectSlot.resize(input.size());
+    boxes.resize(input.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        objects[i] = builder.refs[i].index;
+        objectSlot[objects[i]] = (uint32_t)i;
+        boxes[i] = builder.refs[i].box;
+    }
+    nodes.reserve(input.size() / 2 + 1);
+    collapse(&root, kNoParent, 1);
+    dirty.assign(nodes.size(), 0);
+}
+
+// Pulls grandchildren up until the node has 4 children (or only leaves left), picking the
+// biggest inner child to open each time
+uint32_t BVH::collapse(const BuildNode* node, uint32_t parent, uint32_t level) {
+    depth = std::max(depth, level);
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+    parents.push_back(parent);
+    Range range = {node->first, node->count};
+    ranges.push_back(range);
+
+    const BuildNode* kids[4];
+    int count = 0;
+    if (node->leaf()) {
+        kids[count++] = node;
+    }
+    else {
+        kids[count++] = node->left.get();
+        kids[count++] = node->right.get();
+        while (count < 4) {
+            int open = -1;
+            for (int i = 0; i < count; ++i) {
+                if (!kids[i]->leaf() && (open < 0 || kids[i]->bounds.surfaceArea() > kids[open]->bounds.surfaceArea())) {
+                    open = i;
+                }
+            }
+            if (open < 0) break;
+            const BuildNode* opened = kids[open];
+            kids[open] = opened->left.get();
+            kids[count++] = opened->right.get();
+        }
+    }
+
+    for (int slot = 0; slot < 4; ++slot) {
+        int32_t child = kEmptyChild;
+        uint32_t leafCount = 0;
+        AABB box; // empty slots keep an inverted box, nothing ever overlaps it
+        if (slot < count) {
+            box = kids[slot]->bounds;
+            if (kids[slot]->leaf()) {
+                child = ~(int32_t)kids[slot]->first;
+                leafCount = kids[slot]->count;
+                for (uint32_t i = 0; i < leafCount; ++i) objectLeaf[objects[kids[slot]->first + i]] = index;
+            }
+            else {
+                child = (int32_t)collapse(kids[slot], index, level + 1); // may reallocate nodes, so index again below
+            }
+        }
+        Node& n = nodes[index];
+        setSlot(n.minX, n.minY, n.minZ, n.maxX, n.maxY, n.maxZ, slot, box);
+        n.child[slot] = child;
+        n.count[slot] = leafCount;
+    }
+    return index;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Refit. Nodes are in depth-first pre-order, so children always come after their parent and
+// walking indices backwards updates every child before the nodes that read it.
+
+AABB BVH::nodeBounds(uint32_t node) const {
+    const Node& n = nodes[node];
+    AABB box;
+    for (int i = 0; i < 4; ++i) {
+        box.min = glm::min(box.min, glm::vec3(n.minX[i], n.minY[i], n.minZ[i]));
+        box.max = glm::max(box.max, glm::vec3(n.maxX[i], n.maxY[i], n.maxZ[i]));
+    }
+    return box;
+}
+
+void BVH::refitNode(uint32_t node) {
+    for (int slot = 0; slot < 4; ++slot) {
+        Node& n = nodes[node];
+        int32_t child = n.child[slot];
+        if (child == kEmptyChild) continue;
+        AABB box;
+        if (child >= 0) {
+            box = nodeBounds((uint32_t)child);
+        }
+        else {
+            uint32_t first = (uint32_t)~child;
+            for (uint32_t i = 0; i < n.count[slot]; ++i) box.grow(boxes[first + i]);
+        }
+        setSlot(n.minX, n.minY, n.minZ, n.maxX, n.maxY, n.maxZ, slot, box);
+    }
+}
+
+void BVH::refit(const std::vector<AABB>& input) {
+    for (size_t i = 0; i < objects.size(); ++i) boxes[i] = input[objects[i]];
+    for (size_t node = nodes.size(); node-- > 0;) refitNode((uint32_t)node);
+}
+
+void BVH::refit(const std::vector<AABB>& input, const std::vector<uint32_t>& moved) {
+    std::vector<uint32_t> touched;
+    for (size_t i = 0; i < moved.size(); ++i) {
+        uint32_t object = moved[i];
+        boxes[objectSlot[object]] = input[object];
+        for (uint32_t node = objectLeaf[object]; node != kNoParent && !dirty[node]; node = parents[node]) {
+            dirty[node] = 1;
+            touched.push_back(node);
+        }
+    }
+    std::sort(touched.begin(), touched.end());
+    for (size_t i = touched.size(); i-- > 0;) {
+        refitNode(touched[i]);
+        dirty[touched[i]] = 0;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Queries. Depth first with an explicit stack: every node visited pops one entry and pushes at
+// most 4, so the stack never holds more than 3 per level plus one. How deep the tree gets depends
+// on the input, so the stack is sized from the depth found at build time, and kept per thread so
+// queries don't allocate.
+
+namespace {
+
+template <typename T>
+T* traversalStack(uint32_t depth) {
+    static thread_local std::vector<T> stack;
+    if (stack.size() < 3 * (size_t)depth + 1) stack.resize(3 * (size_t)depth + 1);
+    return stack.data();
+}
+
+} // namespace
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (nodes.empty()) return;
+
+    uint32_t* stack = traversalStack<uint32_t>(depth);
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& n = nodes[stack[--top]];
+
+        // Per child: outside if the corner furthest along some plane normal is behind it,
+        // fully inside if even the nearest corner is in front of every plane
+        int outsideMask = 0, insideMask = 0xF;
+#ifdef BVH_SSE
+        __m128 outside = _mm_setzero_ps();
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        const __m128 zero = _mm_setzero_ps();
+        __m128 minX = _mm_loadu_ps(n.minX), minY = _mm_loadu_ps(n.minY), minZ = _mm_loadu_ps(n.minZ);
+        __m128 maxX = _mm_loadu_ps(n.maxX), maxY = _mm_loadu_ps(n.maxY), maxZ = _mm_loadu_ps(n.maxZ);
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& pl = frustum.planes[p];
+            __m128 nx = _mm_set1_ps(pl.x), ny = _mm_set1_ps(pl.y), nz = _mm_set1_ps(pl.z), w = _mm_set1_ps(pl.w);
+            __m128 far = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pl.x >= 0.0f ? maxX : minX, nx),
+                                               _mm_mul_ps(pl.y >= 0.0f ? maxY : minY, ny)),
+                                    _mm_add_ps(_mm_mul_ps(pl.z >= 0.0f ? maxZ : minZ, nz), w));
+            __m128 near = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pl.x >= 0.0f ? minX : maxX, nx),
+                                                _mm_mul_ps(pl.y >= 0.0f ? minY : maxY, ny)),
+                                     _mm_add_ps(_mm_mul_ps(pl.z >= 0.0f ? minZ : maxZ, nz), w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(far, zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(near, zero));
+        }
+        outsideMask = _mm_movemask_ps(outside);
+        insideMask = _mm_movemask_ps(inside);
+#else
+        for (int i = 0; i < 4; ++i) {
+            for (int p = 0; p < 6; ++p) {
+                const glm::vec4& pl = frustum.planes[p];
+                float far = pl.x * (pl.x >= 0.0f ? n.maxX[i] : n.minX[i]) + pl.y * (pl.y >= 0.0f ? n.maxY[i] : n.minY[i]) +
+                            pl.z * (pl.z >= 0.0f ? n.maxZ[i] : n.minZ[i]) + pl.w;
+                float near = pl.x * (pl.x >= 0.0f ? n.minX[i] : n.maxX[i]) + pl.y * (pl.y >= 0.0f ? n.minY[i] : n.maxY[i]) +
+                             pl.z * (pl.z >= 0.0f ? n.minZ[i] : n.maxZ[i]) + pl.w;
+                if (far < 0.0f) outsideMask |= 1 << i;
+                if (near < 0.0f) insideMask &= ~(1 << i);
+            }
+        }
+#endif
+        for (int i = 0; i < 4; ++i) {
+            int32_t child = n.child[i];
+            if (child == kEmptyChild || (outsideMask >> i) & 1) continue;
+            bool fullyInside = (insideMask >> i) & 1;
+            if (child >= 0) {
+                if (fullyInside) {
+                    // Whole subtree visible, no need to look at it
+                    const Range& r = ranges[child];
+                    out.insert(out.end(), objects.begin() + r.first, objects.begin() + r.first + r.count);
+                }
+                else {
+                    stack[top++] = (uint32_t)child;
+                }
+            }
+            else {
+                uint32_t first = (uint32_t)~child;
+                for (uint32_t k = 0; k < n.count[i]; ++k) {
+                    const AABB& box = boxes[first + k];
+                    if (fullyInside || frustum.intersectsBox(box.min, box.max)) out.push_back(objects[first + k]);
+                }
+            }
+        }
+    }
+}
+
+namespace {
+
+struct Entry {
+    uint32_t node;
+    float t;
+};
+
+// Slab test, returns the entry distance or a negative number on a miss
+inline float rayBox(const glm::vec3& origin, const glm::vec3& inverse, float maxDistance,
+                    float minX, float minY, float minZ, float maxX, float maxY, float maxZ) {
+    float t1 = (minX - origin.x) * inverse.x, t2 = (maxX - origin.x) * inverse.x;
+    float tNear = std::min(t1, t2), tFar = std::max(t1, t2);
+    t1 = (minY - origin.y) * inverse.y;
+    t2 = (maxY - origin.y) * inverse.y;
+    tNear = std::max(tNear, std::min(t1, t2));
+    tFar = std::min(tFar, std::max(t1, t2));
+    t1 = (minZ - origin.z) * inverse.z;
+    t2 = (maxZ - origin.z) * inverse.z;
+    tNear = std::max(tNear, std::min(t1, t2));
+    tFar = std::min(tFar, std::max(t1, t2));
+    tNear = std::max(tNear, 0.0f);
+    return (tNear <= tFar && tNear < maxDistance) ? tNear : -1.0f;
+}
+
+} // namespace
+
+bool BVH::raycast(const Ray& ray, uint32_t& object, float& distance) const {
+    if (nodes.empty()) return false;
+    glm::vec3 inverse(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    float best = 1e30f;
+    bool hit = false;
+
+    Entry* stack = traversalStack<Entry>(depth);
+    int top = 0;
+    stack[top++] = {0, 0.0f};
+    while (top > 0) {
+        Entry e = stack[--top];
+        if (e.t >= best) continue;
+        const Node& n = nodes[e.node];
+
+        Entry children[4];
+        int hits = 0;
+        for (int i = 0; i < 4; ++i) {
+            int32_t child = n.child[i];
+            if (child == kEmptyChild) continue;
+            float t = rayBox(ray.origin, inverse, best, n.minX[i], n.minY[i], n.minZ[i], n.maxX[i], n.maxY[i], n.maxZ[i]);
+            if (t < 0.0f) continue;
+            if (child >= 0) {
+                Entry c = {(uint32_t)child, t};
+                children[hits++] = c;
+            }
+            else {
+                uint32_t first = (uint32_t)~child;
+                for (uint32_t k = 0; k < n.count[i]; ++k) {
+                    const AABB& box = boxes[first + k];
+                    float tObject = rayBox(ray.origin, inverse, best, box.min.x, box.min.y, box.min.z,
+                                           box.max.x, box.max.y, box.max.z);
+                    if (tObject >= 0.0f) {
+                        best = tObject;
+                        object = objects[first + k];
+                        hit = true;
+                    }
+                }
+            }
+        }
+        // Farthest pushed first, so the nearest child is visited next and shrinks best early
+        for (int i = 1; i < hits; ++i) {
+            for (int j = i; j > 0 && children[j].t > children[j - 1].t; --j) std::swap(children[j], children[j - 1]);
+        }
+        for (int i = 0; i < hits; ++i) stack[top++] = children[i];
+    }
+    if (hit) distance = best;
+    return hit;
+}
+
+void BVH::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const {
+    out.clear();
+    if (nodes.empty()) return;
+    float radius2 = radius * radius;
+    // squared distance from the center to the box, 0 when inside
+    auto distance2 = [&](float minX, float minY, float minZ, float maxX, float maxY, float maxZ) {
+        float dx = std::max(std::max(minX - center.x, 0.0f), center.x - maxX);
+        float dy = std::max(std::max(minY - center.y, 0.0f), center.y - maxY);
+        float dz = std::max(std::max(minZ - center.z, 0.0f), center.z - maxZ);
+        return dx * dx + dy * dy + dz * dz;
+    };
+
+    uint32_t* stack = traversalStack<uint32_t>(depth);
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& n = nodes[stack[--top]];
+        for (int i = 0; i < 4; ++i) {
+            int32_t child = n.child[i];
+            if (child == kEmptyChild) continue;
+            if (distance2(n.minX[i], n.minY[i], n.minZ[i], n.maxX[i], n.maxY[i], n.maxZ[i]) > radius2) continue;
+            if (child >= 0) {
+                stack[top++] = (uint32_t)child;
+                continue;
+            }
+            uint32_t first = (uint32_t)~child;
+            for (uint32_t k = 0; k < n.count[i]; ++k) {
+                const AABB& box = boxes[first + k];
+                if (distance2(box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z) <= radius2) {
+                    out.push_back(objects[first + k]);
+                }
+            }
+        }
+    }
+}
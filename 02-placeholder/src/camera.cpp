@@ -0,0 +1,57 @@
+#include "../include/utilities/camera.h"
+
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+glm::mat4 Camera::view() const {
+    return glm::lookAt(position, target, up);
+}
+
+glm::mat4 Camera::projection() const {
+    return glm::perspective(fovY, aspect, nearPlane, farPlane);
+}
+
+glm::mat4 Camera::viewProjection() const {
+    return projection() * view();
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& m) {
+    // Gribb/Hartmann: the planes are sums/differences of the matrix rows (glm is column-major)
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i) row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum f;
+    f.planes[0] = row[3] + row[0]; // left
+    f.planes[1] = row[3] - row[0]; // right
+    f.planes[2] = row[3] + row[1]; // bottom
+    f.planes[3] = row[3] - row[1]; // top
+    f.planes[4] = row[3] + row[2]; // near
+    f.planes[5] = row[3] - row[2]; // far
+    for (int i = 0; i < 6; ++i) {
+        glm::vec4& p = f.planes[i];
+        float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = p * (1.0f / length);
+    }
+    return f;
+}
+
+bool Frustum::containsSphere(const glm::vec3& center, float radius) const {
+    for (int i = 0; i < 6; ++i) {
+        const glm::vec4& p = planes[i];
+        if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) return false;
+    }
+    return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for (int i = 0; i < 6; ++i) {
+        const glm::vec4& p = planes[i];
+        // Corner furthest along the normal, if even that one is outside the whole box is
+        float x = p.x >= 0.0f ? boxMax.x : boxMin.x;
+        float y = p.y >= 0.0f ? boxMax.y : boxMin.y;
+        float z = p.z >= 0.0f ? boxMax.z : boxMin.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f) return false;
+    }
+    return true;
+}
@@ -0,0 +1,367 @@
+#include "../include/utilities/culling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// SSE2 is baseline on x86-64; the AVX kernels are compiled for AVX on their own and only
+// called after checking the CPU at runtime, so the rest of the build stays generic.
+#define CULL_X86 1
+#define CULL_AVX 1
+#include <immintrin.h>
+#define AVX_TARGET __attribute__((target("avx")))
+#elif defined(_M_X64)
+#define CULL_X86 1
+#include <immintrin.h>
+#endif
+
+void BoundingSpheres::add(const glm::vec3& center, float r) {
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+}
+
+void BoundingSpheres::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void BoundingBoxes::add(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    minX.push_back(boxMin.x);
+    minY.push_back(boxMin.y);
+    minZ.push_back(boxMin.z);
+    maxX.push_back(boxMax.x);
+    maxY.push_back(boxMax.y);
+    maxZ.push_back(boxMax.z);
+}
+
+void BoundingBoxes::clear() {
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+namespace {
+
+// All kernels cull [begin, end) and write the visible indices to out (which has room for
+// end - begin entries), returning how many they wrote. Compaction is branchless: every lane
+// is written, the count only moves forward for the visible ones.
+
+size_t spheresScalar(const Frustum& f, const BoundingSpheres& s, size_t begin, size_t end, uint32_t* out) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& pl = f.planes[p];
+            inside &= pl.x * s.x[i] + pl.y * s.y[i] + pl.z * s.z[i] + pl.w >= -s.radius[i];
+        }
+        out[n] = (uint32_t)i;
+        n += inside;
+    }
+    return n;
+}
+
+// For boxes only the corner furthest along each plane normal matters. The plane is the same for
+// every object, so which array (min or max) holds that corner is decided once per plane.
+struct BoxPlane {
+    const float* x;
+    const float* y;
+    const float* z;
+    glm::vec4 plane;
+};
+
+void boxPlanes(const Frustum& f, const BoundingBoxes& b, BoxPlane* out) {
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& pl = f.planes[p];
+        out[p].x = pl.x >= 0.0f ? b.maxX.data() : b.minX.data();
+        out[p].y = pl.y >= 0.0f ? b.maxY.data() : b.minY.data();
+        out[p].z = pl.z >= 0.0f ? b.maxZ.data() : b.minZ.data();
+        out[p].plane = pl;
+    }
+}
+
+size_t boxesScalar(const Frustum& f, const BoundingBoxes& b, size_t begin, size_t end, uint32_t* out) {
+    BoxPlane planes[6];
+    boxPlanes(f, b, planes);
+    size_t n = 0;
+    for (size_t i = begin; i < end; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6; ++p) {
+            const BoxPlane& bp = planes[p];
+            inside &= bp.plane.x * bp.x[i] + bp.plane.y * bp.y[i] + bp.plane.z * bp.z[i] + bp.plane.w >= 0.0f;
+        }
+        out[n] = (uint32_t)i;
+        n += inside;
+    }
+    return n;
+}
+
+#ifdef CULL_X86
+
+inline size_t compact4(int mask, size_t index, uint32_t* out, size_t n) {
+    for (int k = 0; k < 4; ++k) {
+        out[n] = (uint32_t)(index + k);
+        n += (mask >> k) & 1;
+    }
+    return n;
+}
+
+size_t spheresSSE(const Frustum& f, const BoundingSpheres& s, size_t begin, size_t end, uint32_t* out) {
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm_set1_ps(f.planes[p].x);
+        py[p] = _mm_set1_ps(f.planes[p].y);
+        pz[p] = _mm_set1_ps(f.planes[p].z);
+        pw[p] = _mm_set1_ps(f.planes[p].w);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    size_t n = 0, i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(&s.x[i]);
+        __m128 y = _mm_loadu_ps(&s.y[i]);
+        __m128 z = _mm_loadu_ps(&s.z[i]);
+        __m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(&s.radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, px[p]), _mm_mul_ps(y, py[p])),
+                                  _mm_add_ps(_mm_mul_ps(z, pz[p]), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        n = compact4(_mm_movemask_ps(inside), i, out, n);
+    }
+    return n + spheresScalar(f, s, i, end, out + n);
+}
+
+size_t boxesSSE(const Frustum& f, const BoundingBoxes& b, size_t begin, size_t end, uint32_t* out) {
+    BoxPlane planes[6];
+    boxPlanes(f, b, planes);
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm_set1_ps(planes[p].plane.x);
+        py[p] = _mm_set1_ps(planes[p].plane.y);
+        pz[p] = _mm_set1_ps(planes[p].plane.z);
+        pw[p] = _mm_set1_ps(planes[p].plane.w);
+    }
+    const __m128 zero = _mm_setzero_ps();
+    size_t n = 0, i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planes[p].x + i), px[p]),
+                                             _mm_mul_ps(_mm_loadu_ps(planes[p].y + i), py[p])),
+                                  _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(planes[p].z + i), pz[p]), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+        }
+        n = compact4(_mm_movemask_ps(inside), i, out, n);
+    }
+    return n + boxesScalar(f, b, i, end, out + n);
+}
+
+#endif // CULL_X86
+
+#ifdef CULL_AVX
+
+AVX_TARGET size_t spheresAVX(const Frustum& f, const BoundingSpheres& s, size_t begin, size_t end, uint32_t* out) {
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(f.planes[p].x);
+        py[p] = _mm256_set1_ps(f.planes[p].y);
+        pz[p] = _mm256_set1_ps(f.planes[p].z);
+        pw[p] = _mm256_set1_ps(f.planes[p].w);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    size_t n = 0, i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&s.x[i]);
+        __m256 y = _mm256_loadu_ps(&s.y[i]);
+        __m256 z = _mm256_loadu_ps(&s.z[i]);
+        __m256 negR = _mm256_sub_ps(zero, _mm256_loadu_ps(&s.radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, px[p]), _mm256_mul_ps(y, py[p])),
+                                     _mm256_add_ps(_mm256_mul_ps(z, pz[p]), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        n = compact4(mask & 0xF, i, out, n);
+        n = compact4(mask >> 4, i + 4, out, n);
+    }
+    return n + spheresScalar(f, s, i, end, out + n);
+}
+
+AVX_TARGET size_t boxesAVX(const Frustum& f, const BoundingBoxes& b, size_t begin, size_t end, uint32_t* out) {
+    BoxPlane planes[6];
+    boxPlanes(f, b, planes);
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(planes[p].plane.x);
+        py[p] = _mm256_set1_ps(planes[p].plane.y);
+        pz[p] = _mm256_set1_ps(planes[p].plane.z);
+        pw[p] = _mm256_set1_ps(planes[p].plane.w);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    size_t n = 0, i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(planes[p].x + i), px[p]),
+                                                   _mm256_mul_ps(_mm256_loadu_ps(planes[p].y + i), py[p])),
+                                     _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(planes[p].z + i), pz[p]), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        n = compact4(mask & 0xF, i, out, n);
+        n = compact4(mask >> 4, i + 4, out, n);
+    }
+    return n + boxesScalar(f, b, i, end, out + n);
+}
+
+#endif // CULL_AVX
+
+CullPath resolve(CullPath path) {
+    if (path == CullPath::Auto) return bestCullPath();
+    // Asking for a path doesn't make the CPU support it: never go past what it has
+    if (path > bestCullPath()) path = bestCullPath();
+#ifndef CULL_AVX
+    if (path == CullPath::AVX) path = CullPath::SSE;
+#endif
+#ifndef CULL_X86
+    if (path == CullPath::SSE) path = CullPath::Scalar;
+#endif
+    return path;
+}
+
+template <typename Volumes>
+size_t runKernel(CullPath path, const Frustum& f, const Volumes& v, size_t begin, size_t end, uint32_t* out);
+
+template <>
+size_t runKernel(CullPath path, const Frustum& f, const BoundingSpheres& v, size_t begin, size_t end, uint32_t* out) {
+    switch (path) {
+#ifdef CULL_AVX
+        case CullPath::AVX: return spheresAVX(f, v, begin, end, out);
+#endif
+#ifdef CULL_X86
+        case CullPath::SSE: return spheresSSE(f, v, begin, end, out);
+#endif
+        default: return spheresScalar(f, v, begin, end, out);
+    }
+}
+
+template <>
+size_t runKernel(CullPath path, const Frustum& f, const BoundingBoxes& v, size_t begin, size_t end, uint32_t* out) {
+    switch (path) {
+#ifdef CULL_AVX
+        case CullPath::AVX: return boxesAVX(f, v, begin, end, out);
+#endif
+#ifdef CULL_X86
+        case CullPath::SSE: return boxesSSE(f, v, begin, end, out);
+#endif
+        default: return boxesScalar(f, v, begin, end, out);
+    }
+}
+
+// Runs fn(0) .. fn(tasks - 1), one thread each
+struct ThreadRunner {
+    template <typename Fn>
+    void operator()(unsigned int tasks, Fn fn) const {
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t + 1 < tasks; ++t) workers.push_back(std::thread(fn, t));
+        fn(tasks - 1);
+        for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    }
+};
+
+// Same, as jobs
+struct JobRunner {
+    JobSystem& jobs;
+    template <typename Fn>
+    void operator()(unsigned int tasks, Fn fn) const {
+        JobCounter counter;
+        for (unsigned int t = 0; t < tasks; ++t) jobs.run("cull", [fn, t]() { fn(t); }, &counter);
+        jobs.wait(counter);
+    }
+};
+
+template <typename Volumes, typename Runner>
+void cull(const Frustum& f, const Volumes& volumes, std::vector<uint32_t>& visible, unsigned int tasks, CullPath path,
+          const Runner& runner) {
+    path = resolve(path);
+    size_t count = volumes.size();
+    visible.resize(count);
+    if (count == 0) return;
+
+    tasks = std::max(1u, std::min<unsigned int>(tasks, (unsigned int)(count / 4096 + 1)));
+    if (tasks == 1) {
+        visible.resize(runKernel(path, f, volumes, 0, count, visible.data()));
+        return;
+    }
+
+    // Each task writes its survivors at the start of its own range, then the ranges are
+    // slid together. Ranges are multiples of 8 so the SIMD loops only hit the tail once.
+    size_t per = ((count + tasks - 1) / tasks + 7) & ~(size_t)7;
+    std::vector<size_t> found(tasks, 0);
+    runner(tasks, [&, per, count, path](unsigned int t) {
+        size_t begin = std::min(count, t * per), end = std::min(count, begin + per);
+        found[t] = runKernel(path, f, volumes, begin, end, visible.data() + begin);
+    });
+
+    size_t total = found[0];
+    for (unsigned int t = 1; t < tasks; ++t) {
+        size_t begin = std::min(count, t * per);
+        memmove(visible.data() + total, visible.data() + begin, found[t] * sizeof(uint32_t));
+        total += found[t];
+    }
+    visible.resize(total);
+}
+
+} // namespace
+
+CullPath bestCullPath() {
+#ifdef CULL_AVX
+    static const bool avx = __builtin_cpu_supports("avx");
+    if (avx) return CullPath::AVX;
+#endif
+#ifdef CULL_X86
+    return CullPath::SSE;
+#else
+    return CullPath::Scalar;
+#endif
+}
+
+const char* cullPathName(CullPath path) {
+    switch (resolve(path)) {
+        case CullPath::AVX: return "avx";
+        case CullPath::SSE: return "sse";
+        default: return "scalar";
+    }
+}
+
+void cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible,
+                 unsigned int threads, CullPath path) {
+    cull(frustum, spheres, visible, threads, path, ThreadRunner());
+}
+
+void cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible,
+                 JobSystem& jobs, CullPath path) {
+    // A few ranges per thread, stealing evens them out
+    JobRunner runner = {jobs};
+    cull(frustum, spheres, visible, jobs.threadCount() * 4, path, runner);
+}
+
+void cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible,
+               unsigned int threads, CullPath path) {
+    cull(frustum, boxes, visible, threads, path, ThreadRunner());
+}
+
+void cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible, JobSystem& jobs,
+               CullPath path) {
+    JobRunner runner = {jobs};
+    cull(frustum, boxes, visible, jobs.threadCount() * 4, path, runner);
+}
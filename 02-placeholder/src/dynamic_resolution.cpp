@@ -0,0 +1,170 @@
+#include "../include/utilities/dynamic_resolution.h"
+#include "../include/utilities/gl_debug.h"
+#include "../include/utilities/profiler.h"
+#include "../include/utilities/shaders.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Scales are multiples of this, so tiny corrections don't change the resolution every window
+const float kScaleStep = 0.025f;
+// Grow again only below this fraction of the budget, aim changes at the second one
+const double kGrowBelow = 0.75;
+const double kAimAt = 0.9;
+const float kMaxGrowth = 0.1f;
+
+} // namespace
+
+DynamicResolution::~DynamicResolution() {
+    destroy();
+}
+
+bool DynamicResolution::init(const DynamicResolutionSettings& s) {
+    settings = s;
+    settings.minScale = std::max(0.1f, std::min(settings.minScale, 1.0f));
+    settings.maxScale = std::max(settings.minScale, std::min(settings.maxScale, 1.0f));
+    settings.window = std::max(1, settings.window);
+    currentScale = settings.maxScale;
+
+    upscale.reset(new Shader("../assets/fullscreen_vertex.glsl", "../assets/upscale_fragment.glsl"));
+    upscale->activate();
+    upscale->setInt("scene", 0);
+    upscale->setFloat("sharpness", settings.sharpness);
+
+    glGenVertexArrays(1, &emptyVAO);
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &color);
+    glGenRenderbuffers(1, &depth);
+    for (int i = 0; i < kQueries; ++i) glGenQueries(2, queries[i]);
+    std::fill(pending, pending + kQueries, false);
+    gpuMs.clear();
+    frame = generation = changes = 0;
+    targetWidth = targetHeight = 0;
+    return resize(1, 1);
+}
+
+void DynamicResolution::destroy() {
+    if (!fbo) return;
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &color);
+    glDeleteRenderbuffers(1, &depth);
+    glDeleteVertexArrays(1, &emptyVAO);
+    for (int i = 0; i < kQueries; ++i) glDeleteQueries(2, queries[i]);
+    upscale.reset();
+    fbo = color = depth = emptyVAO = 0;
+}
+
+bool DynamicResolution::resize(int width, int height) {
+    targetWidth = width;
+    targetHeight = height;
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!complete) std::cout << "Failed to create the " << width << "x" << height << " dynamic resolution target" << std::endl;
+    GLDebugLog::label(GL_FRAMEBUFFER, fbo, "dynamic resolution target");
+    GLDebugLog::label(GL_TEXTURE, color, "dynamic resolution color");
+    return complete;
+}
+
+void DynamicResolution::collect(int slot) {
+    if (!pending[slot]) return;
+    pending[slot] = false;
+    // Still not done kQueries frames later: drop it rather than wait
+    GLint available = 0;
+    glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available || queryGeneration[slot] != generation) return;
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+    gpuMs.push_back((end - begin) * 1e-6);
+    adjust();
+}
+
+void DynamicResolution::adjust() {
+    if ((int)gpuMs.size() < settings.window) return;
+    double mean = 0.0;
+    for (double ms : gpuMs) mean += ms;
+    mean /= gpuMs.size();
+
+    // GPU time goes with the pixel count, the square of the scale
+    float ideal = currentScale * (float)std::sqrt(settings.budgetMs * kAimAt / std::max(mean, 1e-3));
+    float next = currentScale;
+    if (mean > settings.budgetMs) {
+        next = std::min(std::floor(ideal / kScaleStep) * kScaleStep, currentScale - kScaleStep);
+    }
+    else if (mean < settings.budgetMs * kGrowBelow) {
+        next = std::floor(std::min(ideal, currentScale + kMaxGrowth) / kScaleStep) * kScaleStep;
+    }
+    next = std::max(settings.minScale, std::min(next, settings.maxScale));
+    if (std::fabs(next - currentScale) < kScaleStep * 0.5f) {
+        gpuMs.pop_front(); // hold, keep sliding
+        return;
+    }
+    currentScale = next;
+    gpuMs.clear();
+    ++generation;
+    ++changes;
+}
+
+void DynamicResolution::beginScene(int width, int height) {
+    windowWidth = std::max(1, width);
+    windowHeight = std::max(1, height);
+    if (windowWidth > targetWidth || windowHeight > targetHeight) {
+        resize(std::max(windowWidth, targetWidth), std::max(windowHeight, targetHeight));
+    }
+    sceneWidth = std::max(1, (int)std::lround(windowWidth * currentScale));
+    sceneHeight = std::max(1, (int)std::lround(windowHeight * currentScale));
+
+    int slot = frame % kQueries;
+    collect(slot);
+    glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, sceneWidth, sceneHeight);
+}
+
+void DynamicResolution::endScene(GLuint output) {
+    int slot = frame % kQueries;
+    glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+    pending[slot] = true;
+    queryGeneration[slot] = generation;
+    ++frame;
+
+    GPU_PROFILE_SCOPE("upscale");
+    glBindFramebuffer(GL_FRAMEBUFFER, output);
+    glViewport(0, 0, windowWidth, windowHeight);
+    upscale->activate();
+    glUniform2f(glGetUniformLocation(upscale->id, "uvScale"), (float)sceneWidth / targetWidth,
+                (float)sceneHeight / targetHeight);
+    glUniform2f(glGetUniformLocation(upscale->id, "uvMax"), (sceneWidth - 0.5f) / targetWidth,
+                (sceneHeight - 0.5f) / targetHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+DynamicResolutionStats DynamicResolution::takeStats() {
+    DynamicResolutionStats stats;
+    stats.scale = currentScale;
+    stats.sceneWidth = sceneWidth;
+    stats.sceneHeight = sceneHeight;
+    if (!gpuMs.empty()) {
+        for (double ms : gpuMs) stats.gpuMs += ms;
+        stats.gpuMs /= gpuMs.size();
+    }
+    stats.changes = changes;
+    changes = 0;
+    return stats;
+}
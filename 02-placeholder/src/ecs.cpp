@@ -0,0 +1,257 @@
+#include "../include/utilities/ecs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct ComponentInfo {
+    size_t size, align;
+};
+
+std::mutex registryMutex;
+std::vector<ComponentInfo>& registry() {
+    static std::vector<ComponentInfo> infos;
+    return infos;
+}
+
+ComponentInfo info(int component) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return registry()[component];
+}
+
+inline int lowestBit(ComponentMask mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int bit = 0;
+    while (!((mask >> bit) & 1)) ++bit;
+    return bit;
+#endif
+}
+
+} // namespace
+
+int registerComponent(size_t size, size_t align) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (registry().size() >= (size_t)kMaxComponents) {
+        std::cout << "Too many component types (max " << kMaxComponents << ")" << std::endl;
+        std::abort();
+    }
+    ComponentInfo component = {size, align};
+    registry().push_back(component);
+    return (int)registry().size() - 1;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+Archetype::Archetype(ComponentMask mask) : componentBits(mask) {
+    std::fill(offsets, offsets + kMaxComponents, 0u);
+    std::fill(sizes, sizes + kMaxComponents, 0u);
+    std::fill(addEdge, addEdge + kMaxComponents, (Archetype*)nullptr);
+    std::fill(removeEdge, removeEdge + kMaxComponents, (Archetype*)nullptr);
+
+    std::vector<ComponentInfo> infos;
+    std::vector<int> ids;
+    for (ComponentMask m = mask; m; m &= m - 1) {
+        ids.push_back(lowestBit(m));
+        infos.push_back(info(ids.back()));
+        sizes[ids.back()] = (uint32_t)infos.back().size;
+    }
+
+    // Biggest capacity whose arrays (entities first, then one per component, each aligned)
+    // still fit in a chunk
+    size_t rowSize = sizeof(Entity);
+    for (const ComponentInfo& c : infos) rowSize += c.size;
+    uint32_t capacity = (uint32_t)(kChunkSize / rowSize);
+    for (;; --capacity) {
+        size_t offset = sizeof(Entity) * capacity;
+        for (size_t i = 0; i < infos.size(); ++i) {
+            offset = (offset + infos[i].align - 1) / infos[i].align * infos[i].align;
+            offsets[ids[i]] = (uint32_t)offset;
+            offset += infos[i].size * capacity;
+        }
+        if (offset <= kChunkSize) break;
+    }
+    chunkCapacity = capacity;
+}
+
+size_t Archetype::size() const {
+    return chunks.empty() ? 0 : (chunks.size() - 1) * chunkCapacity + chunks.back()->count;
+}
+
+void Archetype::allocate(uint32_t& chunkIndex, uint32_t& row) {
+    // Only the last chunk is ever partly full
+    if (chunks.empty() || chunks.back()->count == chunkCapacity) chunks.push_back(std::unique_ptr<Chunk>(new Chunk()));
+    chunkIndex = (uint32_t)chunks.size() - 1;
+    row = chunks.back()->count++;
+}
+
+Entity Archetype::removeSwap(uint32_t chunkIndex, uint32_t row) {
+    Chunk& last = *chunks.back();
+    uint32_t lastRow = last.count - 1;
+    Entity moved;
+    if (&last != chunks[chunkIndex].get() || lastRow != row) {
+        Chunk& hole = *chunks[chunkIndex];
+        moved = entities(last)[lastRow];
+        entities(hole)[row] = moved;
+        for (ComponentMask m = componentBits; m; m &= m - 1) {
+            int id = lowestBit(m);
+            size_t size = sizes[id];
+            memcpy((unsigned char*)column(hole, id) + size * row, (unsigned char*)column(last, id) + size * lastRow, size);
+        }
+    }
+    if (--last.count == 0) chunks.pop_back();
+    return moved;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+World::World() {
+    empty = archetypeFor(0);
+}
+
+Archetype* World::archetypeFor(ComponentMask mask) {
+    std::unique_ptr<Archetype>& slot = byMask[mask];
+    if (!slot) {
+        slot.reset(new Archetype(mask));
+        archetypes.push_back(slot.get());
+    }
+    return slot.get();
+}
+
+Archetype* World::withComponent(Archetype* from, int component, bool add) {
+    Archetype*& edge = add ? from->addEdge[component] : from->removeEdge[component];
+    if (!edge) {
+        ComponentMask bit = ComponentMask(1) << component;
+        edge = archetypeFor(add ? from->mask() | bit : from->mask() & ~bit);
+    }
+    return edge;
+}
+
+Entity World::place(Archetype* archetype) {
+    Entity e;
+    if (!freeList.empty()) {
+        e.index = freeList.back();
+        freeList.pop_back();
+    }
+    else {
+        e.index = (uint32_t)records.size();
+        records.push_back(Record());
+    }
+    Record& r = records[e.index];
+    e.generation = r.generation;
+    r.archetype = archetype;
+    archetype->allocate(r.chunk, r.row);
+    archetype->entities(archetype->chunk(r.chunk))[r.row] = e;
+    ++living;
+    return e;
+}
+
+Entity World::create() {
+    return place(empty);
+}
+
+bool World::alive(Entity e) const {
+    return e.index < records.size() && records[e.index].generation == e.generation && records[e.index].archetype;
+}
+
+void World::destroy(Entity e) {
+    if (!alive(e)) return;
+    Record& r = records[e.index];
+    Entity moved = r.archetype->removeSwap(r.chunk, r.row);
+    if (moved.index != 0xFFFFFFFFu) {
+        records[moved.index].chunk = r.chunk;
+        records[moved.index].row = r.row;
+    }
+    r.archetype = nullptr;
+    ++r.generation;
+    freeList.push_back(e.index);
+    --living;
+}
+
+void* World::move(Entity e, Archetype* to, int component) {
+    Record& r = records[e.index];
+    Archetype* from = r.archetype;
+    uint32_t chunkIndex, row;
+    to->allocate(chunkIndex, row);
+    Chunk& src = from->chunk(r.chunk);
+    Chunk& dst = to->chunk(chunkIndex);
+    to->entities(dst)[row] = e;
+    for (ComponentMask m = from->mask() & to->mask(); m; m &= m - 1) {
+        int id = lowestBit(m);
+        size_t size = from->sizes[id];
+        memcpy((unsigned char*)to->column(dst, id) + size * row, (unsigned char*)from->column(src, id) + size * r.row, size);
+    }
+
+    Entity moved = from->removeSwap(r.chunk, r.row);
+    if (moved.index != 0xFFFFFFFFu) {
+        records[moved.index].chunk = r.chunk;
+        records[moved.index].row = r.row;
+    }
+    r.archetype = to;
+    r.chunk = chunkIndex;
+    r.row = row;
+    return component >= 0 ? (unsigned char*)to->column(dst, component) + to->sizes[component] * row : nullptr;
+}
+
+const std::vector<Archetype*>& World::query(ComponentMask mask) {
+    // Systems running side by side query at the same time
+    std::lock_guard<std::mutex> lock(queryMutex);
+    CachedQuery& q = queries[mask];
+    for (; q.checked < archetypes.size(); ++q.checked) {
+        if ((archetypes[q.checked]->mask() & mask) == mask) q.matches.push_back(archetypes[q.checked]);
+    }
+    return q.matches;
+}
+
+void World::runParallel(unsigned int threads, size_t items, const std::function<void(size_t)>& fn) {
+    threads = std::max(1u, std::min<unsigned int>(threads, (unsigned int)items));
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < items;) fn(i);
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; ++t) workers.push_back(std::thread(work));
+    work();
+    for (std::thread& w : workers) w.join();
+}
+
+// ---------------------------------------------------------------------------------------------
+
+void Schedule::add(const char* name, ComponentMask reads, ComponentMask writes, std::function<void(World&)> fn) {
+    System system = {name, reads, writes, fn};
+    systems.push_back(system);
+}
+
+void Schedule::run(World& world) {
+    lastStages.clear();
+    size_t i = 0;
+    while (i < systems.size()) {
+        // Grow the stage while the next system doesn't conflict with any system already in it
+        size_t end = i + 1;
+        ComponentMask reads = systems[i].reads, writes = systems[i].writes;
+        for (; end < systems.size(); ++end) {
+            const System& s = systems[end];
+            if ((s.writes & (reads | writes)) || (s.reads & writes)) break;
+            reads |= s.reads;
+            writes |= s.writes;
+        }
+
+        std::vector<const char*> names;
+        std::vector<std::thread> workers;
+        for (size_t k = i; k < end; ++k) {
+            names.push_back(systems[k].name);
+            if (k + 1 < end) workers.push_back(std::thread(systems[k].fn, std::ref(world)));
+        }
+        systems[end - 1].fn(world);
+        for (std::thread& w : workers) w.join();
+        lastStages.push_back(names);
+        i = end;
+    }
+}
@@ -0,0 +1,149 @@
+#include "../include/utilities/frame_pacing.h"
+#include "../include/utilities/profiler.h"
+
+#include "../include/utilities/display.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+// Sleeps can overshoot by about this much, the rest of the wait is spun
+const double kSpinMargin = 0.0015;
+// Fences kept for latency stats when there's no frames-in-flight limit to wait on them
+const int kMaxUnwaitedFences = 8;
+
+} // namespace
+
+FramePacer::~FramePacer() {
+    destroy();
+}
+
+void FramePacer::init(const PacingSettings& s, Display& target) {
+    settings = s;
+    display = &target;
+    if (settings.swapInterval != kDriverSwapInterval) display->setSwapInterval(settings.swapInterval);
+    period = settings.targetFps > 0.0 ? 1.0 / settings.targetFps : 0.0;
+    deadline = -1.0;
+}
+
+void FramePacer::destroy() {
+    for (const InFlight& frame : inFlight) glDeleteSync(frame.fence);
+    inFlight.clear();
+}
+
+void FramePacer::waitUntil(double target) {
+    PROFILE_SCOPE("frame limiter");
+    double start = display->time();
+    double now = start;
+    if (target - now > kSpinMargin) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(target - now - kSpinMargin));
+        now = display->time();
+    }
+    while (now < target) {
+        std::this_thread::yield();
+        now = display->time();
+    }
+    limiterTime += now - start;
+}
+
+void FramePacer::beginFrame() {
+    if (period > 0.0 && settings.lowLatency && deadline >= 0.0) {
+        // Start the frame as late as the predicted work allows
+        waitUntil(deadline - predictedWork - kSpinMargin);
+    }
+    inputTime = display->time();
+}
+
+void FramePacer::beforeRender() {
+    if (settings.maxFramesInFlight <= 0) return;
+    collectSignaled();
+    if ((int)inFlight.size() < settings.maxFramesInFlight) return;
+
+    PROFILE_SCOPE("wait for frame in flight");
+    double start = display->time();
+    while ((int)inFlight.size() >= settings.maxFramesInFlight) {
+        // Wait for the oldest frame, flushing so the fence can actually get signaled
+        const InFlight& oldest = inFlight.front();
+        GLenum result = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000); // 100 ms
+        if (result == GL_WAIT_FAILED) break;
+        if (result == GL_TIMEOUT_EXPIRED) continue;
+        collectSignaled();
+    }
+    fenceWaitTime += display->time() - start;
+}
+
+void FramePacer::collectSignaled() {
+    double now = display->time();
+    while (!inFlight.empty()) {
+        GLenum result = glClientWaitSync(inFlight.front().fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+        double latency = now - inFlight.front().inputTime;
+        latencySum += latency;
+        latencyMax = std::max(latencyMax, latency);
+        ++latencySamples;
+        glDeleteSync(inFlight.front().fence);
+        inFlight.pop_front();
+    }
+}
+
+void FramePacer::endFrame() {
+    InFlight frame = {glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), inputTime};
+    inFlight.push_back(frame);
+    // Without a frames-in-flight limit nobody waits on them, don't let them pile up. With one,
+    // beforeRender() already keeps it at the limit: dropping a fence here would drop a frame
+    // the limit is supposed to wait for.
+    size_t keep = (size_t)std::max(kMaxUnwaitedFences, settings.maxFramesInFlight);
+    while (inFlight.size() > keep) {
+        glDeleteSync(inFlight.front().fence);
+        inFlight.pop_front();
+    }
+    collectSignaled();
+
+    double now = display->time();
+    if (settings.lowLatency) {
+        double work = now - inputTime;
+        predictedWork = predictedWork > 0.0 ? predictedWork * 0.9 + work * 0.1 : work;
+    }
+    if (period > 0.0) {
+        if (deadline < 0.0) deadline = now;
+        deadline += period;
+        // Fell more than a frame behind: start over instead of rushing to catch up
+        if (deadline < now) deadline = now;
+        if (!settings.lowLatency) waitUntil(deadline);
+        now = display->time();
+    }
+
+    if (lastEnd >= 0.0) {
+        double frameTime = now - lastEnd;
+        if (frames == 0) minTime = maxTime = frameTime;
+        minTime = std::min(minTime, frameTime);
+        maxTime = std::max(maxTime, frameTime);
+        sum += frameTime;
+        sumSquares += frameTime * frameTime;
+        ++frames;
+    }
+    lastEnd = now;
+}
+
+PacingStats FramePacer::takeStats() {
+    PacingStats stats;
+    stats.frames = frames;
+    if (frames > 0) {
+        stats.meanFrameTime = sum / frames;
+        stats.frameTimeStdDev = std::sqrt(std::max(0.0, sumSquares / frames - stats.meanFrameTime * stats.meanFrameTime));
+        stats.minFrameTime = minTime;
+        stats.maxFrameTime = maxTime;
+    }
+    stats.latencySamples = latencySamples;
+    if (latencySamples > 0) stats.meanLatency = latencySum / latencySamples;
+    stats.maxLatency = latencyMax;
+    stats.limiterTime = limiterTime;
+    stats.fenceWaitTime = fenceWaitTime;
+
+    frames = latencySamples = 0;
+    sum = sumSquares = minTime = maxTime = latencySum = latencyMax = limiterTime = fenceWaitTime = 0.0;
+    return stats;
+}
@@ -0,0 +1,267 @@
+#include "../include/utilities/gl_debug.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Not in the 3.3 glad header
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+#ifndef GL_CONTEXT_FLAG_DEBUG_BIT
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#endif
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+
+namespace {
+
+typedef void (APIENTRY *DebugProc)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                   const GLchar* message, const void* userParam);
+typedef void (APIENTRYP DebugMessageCallbackFn)(DebugProc callback, const void* userParam);
+typedef void (APIENTRYP DebugMessageControlFn)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                               const GLuint* ids, GLboolean enabled);
+typedef void (APIENTRYP ObjectLabelFn)(GLenum identifier, GLuint name, GLsizei length, const GLchar* label);
+
+DebugMessageCallbackFn debugMessageCallback = nullptr;
+ObjectLabelFn objectLabel = nullptr;
+
+const char* sourceName(GLenum source) {
+    switch (source) {
+    case GL_DEBUG_SOURCE_API: return "api";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION: return "application";
+    default: return "other";
+    }
+}
+
+const char* typeName(GLenum type) {
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR: return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+    case GL_DEBUG_TYPE_MARKER: return "marker";
+    case GL_DEBUG_TYPE_PUSH_GROUP: return "push group";
+    case GL_DEBUG_TYPE_POP_GROUP: return "pop group";
+    default: return "other";
+    }
+}
+
+const char* severityName(GLenum severity) {
+    switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH: return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+    case GL_DEBUG_SEVERITY_LOW: return "low";
+    default: return "notification";
+    }
+}
+
+bool contains(const std::string& lower, const char* word) {
+    return lower.find(word) != std::string::npos;
+}
+
+// Drivers put the interesting part of a performance warning in the text only, sort by keywords
+const char* classify(GLenum type, const std::string& text) {
+    if (type != GL_DEBUG_TYPE_PERFORMANCE) return typeName(type);
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (contains(lower, "recompil")) return "shader recompile";
+    if (contains(lower, "stall") || contains(lower, "wait") || contains(lower, "busy") || contains(lower, "sync"))
+        return "stall";
+    if (contains(lower, "fallback") || contains(lower, "software")) return "fallback";
+    if (contains(lower, "copy") || contains(lower, "blit") || contains(lower, "readpixels")) return "copy";
+    if (contains(lower, "memory") || contains(lower, "allocat")) return "memory";
+    return "performance";
+}
+
+void writeString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char)c < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+void writeMessage(std::ostream& out, const GLDebugMessage& m, bool summary) {
+    out << "{\"frame\": " << m.frame;
+    if (summary) out << ", \"last_frame\": " << m.lastFrame << ", \"count\": " << m.count;
+    else out << ", \"time\": " << m.time;
+    out << ", \"source\": \"" << sourceName(m.source) << "\", \"type\": \"" << typeName(m.type) << "\", \"kind\": \""
+        << m.kind << "\", \"severity\": \"" << severityName(m.severity) << "\", \"id\": " << m.id << ", \"message\": ";
+    writeString(out, m.text);
+    out << "}\n";
+}
+
+} // namespace
+
+GLDebugLog::~GLDebugLog() {
+    destroy();
+}
+
+bool GLDebugLog::init(GLADloadproc load, const char* path) {
+    GLint major = 0, minor = 0, flags = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    bool hasExtension = false;
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions && !hasExtension; ++i) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        hasExtension = name && strcmp(name, "GL_KHR_debug") == 0;
+    }
+    // Desktop KHR_debug uses the core names, without a suffix
+    DebugMessageControlFn debugMessageControl = nullptr;
+    if (major > 4 || (major == 4 && minor >= 3) || hasExtension) {
+        debugMessageCallback = (DebugMessageCallbackFn)load("glDebugMessageCallback");
+        debugMessageControl = (DebugMessageControlFn)load("glDebugMessageControl");
+        objectLabel = (ObjectLabelFn)load("glObjectLabel");
+    }
+    if (!debugMessageCallback || !debugMessageControl) {
+        std::cout << "Failed to enable GL debug output: neither GL 4.3 nor KHR_debug (GL " << major << "." << minor
+                  << ")" << std::endl;
+        debugMessageCallback = nullptr;
+        objectLabel = nullptr;
+        return false;
+    }
+    out.open(path);
+    if (!out) {
+        std::cout << "Failed to open the GL debug log " << path << std::endl;
+        debugMessageCallback = nullptr;
+        objectLabel = nullptr;
+        return false;
+    }
+    out.precision(4);
+    out.setf(std::ios::fixed);
+
+    epoch = std::chrono::steady_clock::now();
+    stopping = false;
+    writer = std::thread(&GLDebugLog::writeLoop, this);
+    // Low severity (where most performance warnings are) is off by default
+    debugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    debugMessageCallback(&GLDebugLog::callback, this);
+    glEnable(GL_DEBUG_OUTPUT);
+    std::cout << "GL debug output to " << path << ((flags & GL_CONTEXT_FLAG_DEBUG_BIT) ? " (debug context)" : " (not a debug context)")
+              << std::endl;
+    return true;
+}
+
+void GLDebugLog::destroy() {
+    if (!writer.joinable()) return;
+    glDisable(GL_DEBUG_OUTPUT);
+    debugMessageCallback(nullptr, nullptr);
+    debugMessageCallback = nullptr;
+    objectLabel = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    // Every distinct message once more, most frequent first
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<const GLDebugMessage*> summary;
+    for (const auto& entry : seen) summary.push_back(&entry.second);
+    std::sort(summary.begin(), summary.end(),
+              [](const GLDebugMessage* a, const GLDebugMessage* b) { return a->count > b->count; });
+    out << "{\"summary\": {\"messages\": " << received << ", \"distinct\": " << seen.size()
+        << ", \"performance\": " << performance << ", \"frames\": " << frame.load() << "}}\n";
+    for (const GLDebugMessage* m : summary) writeMessage(out, *m, true);
+    out.close();
+}
+
+size_t GLDebugLog::messageCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return received;
+}
+
+size_t GLDebugLog::distinctCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seen.size();
+}
+
+size_t GLDebugLog::performanceWarnings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return performance;
+}
+
+void GLDebugLog::label(GLenum identifier, GLuint name, const char* label) {
+    if (objectLabel && name) objectLabel(identifier, name, -1, label);
+}
+
+void APIENTRY GLDebugLog::callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                   const GLchar* message, const void* userParam) {
+    ((GLDebugLog*)userParam)->receive(source, type, id, severity, message, length);
+}
+
+void GLDebugLog::receive(GLenum source, GLenum type, GLuint id, GLenum severity, const GLchar* text, GLsizei length) {
+    GLDebugMessage m;
+    m.frame = m.lastFrame = frame.load(std::memory_order_relaxed);
+    m.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+    m.source = source;
+    m.type = type;
+    m.id = id;
+    m.severity = severity;
+    m.text = length >= 0 ? std::string(text, length) : std::string(text);
+    m.kind = classify(type, m.text);
+
+    std::string key = std::to_string(source) + ' ' + std::to_string(type) + ' ' + std::to_string(id) + ' ' + m.text;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++received;
+        if (type == GL_DEBUG_TYPE_PERFORMANCE) ++performance;
+        auto it = seen.find(key);
+        if (it != seen.end()) {
+            it->second.count++;
+            it->second.lastFrame = m.frame;
+            return;
+        }
+        seen.emplace(key, m);
+        queue.push_back(std::move(m));
+    }
+    wake.notify_one();
+}
+
+void GLDebugLog::writeLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        std::deque<GLDebugMessage> batch;
+        batch.swap(queue);
+        bool done = stopping;
+        lock.unlock();
+        for (const GLDebugMessage& m : batch) {
+            writeMessage(out, m, false);
+            if (m.type == GL_DEBUG_TYPE_ERROR || m.severity == GL_DEBUG_SEVERITY_HIGH) {
+                std::cout << "GL " << typeName(m.type) << " (frame " << m.frame << "): " << m.text << std::endl;
+            }
+        }
+        out.flush();
+        lock.lock();
+        if (done && queue.empty()) return;
+    }
+}
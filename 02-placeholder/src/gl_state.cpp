@@ -0,0 +1,60 @@
+#include "../include/utilities/gl_state.h"
+
+void GLStateCache::invalidate() {
+    program = kUnknown;
+    for (unsigned int i = 0; i < kTextureUnits; ++i) textures[i] = kUnknown;
+    activeUnit = kUnknown;
+    vertexArray = kUnknown;
+    blend = kUnknown;
+}
+
+void GLStateCache::useProgram(unsigned int id) {
+    if (program == id) {
+        ++current.skipped;
+        return;
+    }
+    glUseProgram(id);
+    program = id;
+    ++current.programBinds;
+}
+
+void GLStateCache::bindTexture(unsigned int unit, unsigned int texture) {
+    if (unit < kTextureUnits && textures[unit] == texture) {
+        ++current.skipped;
+        return;
+    }
+    // glActiveTexture is part of the bind, only worth calling when the unit differs
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (unit < kTextureUnits) textures[unit] = texture;
+    ++current.textureBinds;
+}
+
+void GLStateCache::bindVertexArray(unsigned int vao) {
+    if (vertexArray == vao) {
+        ++current.skipped;
+        return;
+    }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    ++current.vertexArrayBinds;
+}
+
+void GLStateCache::setBlend(bool enabled) {
+    if (blend == (unsigned int)enabled) {
+        ++current.skipped;
+        return;
+    }
+    if (enabled) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else {
+        glDisable(GL_BLEND);
+    }
+    blend = enabled;
+    ++current.blendChanges;
+}
@@ -0,0 +1,336 @@
+#include "../include/utilities/gl_trace.h"
+
+#ifdef GL_TRACE
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+enum FunctionId {
+#define GL_TRACE_FUNCTION(name) id_##name,
+#include "../include/utilities/gl_trace_functions.inc"
+#undef GL_TRACE_FUNCTION
+    kFunctionCount
+};
+
+const char* const kNames[] = {
+#define GL_TRACE_FUNCTION(name) #name,
+#include "../include/utilities/gl_trace_functions.inc"
+#undef GL_TRACE_FUNCTION
+};
+
+enum Kind { kOther, kDraw, kBind, kUniform };
+
+struct FunctionStats {
+    size_t calls = 0;
+    double ns = 0.0;
+};
+
+// Last known binding, per binding point. No entry means unknown (nothing bound through us yet, or
+// invalidated), so the next bind is never called redundant.
+struct Bindings {
+    std::map<GLenum, GLuint> buffers;                       // target
+    std::map<std::pair<GLenum, GLenum>, GLuint> textures;   // texture unit, target
+    std::map<GLenum, GLuint> framebuffers;                  // GL_DRAW/READ_FRAMEBUFFER
+    std::map<GLuint, GLuint> samplers;                      // unit
+    std::map<GLenum, GLuint> singles;                       // program, VAO, renderbuffer, keyed by the bind call
+    GLenum activeTexture = GL_TEXTURE0;
+
+    void clear() {
+        buffers.clear();
+        textures.clear();
+        framebuffers.clear();
+        samplers.clear();
+        singles.clear();
+    }
+};
+
+bool hooked = false;
+Kind kinds[kFunctionCount];
+FunctionStats totals[kFunctionCount];
+GLTraceFrame current, last;
+size_t frames = 0;
+Bindings bindings;
+
+std::ofstream recording;
+int recordFramesLeft = 0;
+
+template <typename K, typename V>
+void bind(std::map<K, V>& slots, const K& key, V value) {
+    auto it = slots.find(key);
+    if (it != slots.end() && it->second == value) ++current.redundantBinds;
+    else slots[key] = value;
+}
+
+size_t bytesPerPixel(GLenum format, GLenum type) {
+    switch (type) {
+    case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+        return 1;
+    case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV: case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_4_4_4_4_REV: case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+        return 2;
+    case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_10_10_10_2:
+    case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+        return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    }
+    size_t components = 4;
+    switch (format) {
+    case GL_RED: case GL_GREEN: case GL_BLUE: case GL_ALPHA: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT:
+    case GL_STENCIL_INDEX: case GL_LUMINANCE:
+        components = 1;
+        break;
+    case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL: case GL_LUMINANCE_ALPHA:
+        components = 2;
+        break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+        components = 3;
+        break;
+    }
+    size_t size = 1;
+    switch (type) {
+    case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT:
+        size = 2;
+        break;
+    case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT:
+        size = 4;
+        break;
+    }
+    return components * size;
+}
+
+void uploaded(const void* data, size_t bytes) {
+    if (data) current.bytesUploaded += bytes;
+}
+
+// What a call does to the counters beyond being a call. One overload per interesting entry point,
+// picked by tag; everything else ends up in the template and does nothing.
+template <int Id> struct Tag {};
+
+template <int Id, typename... Args>
+void inspect(Tag<Id>, Args...) {}
+
+void inspect(Tag<id_glActiveTexture>, GLenum texture) { bindings.activeTexture = texture; }
+void inspect(Tag<id_glBindBuffer>, GLenum target, GLuint buffer) { bind(bindings.buffers, target, buffer); }
+void inspect(Tag<id_glBindTexture>, GLenum target, GLuint texture) {
+    bind(bindings.textures, std::make_pair(bindings.activeTexture, target), texture);
+}
+void inspect(Tag<id_glBindSampler>, GLuint unit, GLuint sampler) { bind(bindings.samplers, unit, sampler); }
+void inspect(Tag<id_glUseProgram>, GLuint program) { bind(bindings.singles, (GLenum)id_glUseProgram, program); }
+void inspect(Tag<id_glBindRenderbuffer>, GLenum, GLuint renderbuffer) {
+    bind(bindings.singles, (GLenum)id_glBindRenderbuffer, renderbuffer);
+}
+void inspect(Tag<id_glBindVertexArray>, GLuint array) {
+    // The element buffer binding belongs to the VAO
+    auto it = bindings.singles.find((GLenum)id_glBindVertexArray);
+    if (it == bindings.singles.end() || it->second != array) bindings.buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    bind(bindings.singles, (GLenum)id_glBindVertexArray, array);
+}
+void inspect(Tag<id_glBindFramebuffer>, GLenum target, GLuint framebuffer) {
+    if (target != GL_FRAMEBUFFER) {
+        bind(bindings.framebuffers, target, framebuffer);
+        return;
+    }
+    // Binds both; redundant only if both were bound already
+    auto draw = bindings.framebuffers.find(GL_DRAW_FRAMEBUFFER);
+    auto read = bindings.framebuffers.find(GL_READ_FRAMEBUFFER);
+    if (draw != bindings.framebuffers.end() && draw->second == framebuffer && read != bindings.framebuffers.end() &&
+        read->second == framebuffer)
+        ++current.redundantBinds;
+    bindings.framebuffers[GL_DRAW_FRAMEBUFFER] = bindings.framebuffers[GL_READ_FRAMEBUFFER] = framebuffer;
+}
+// Names get reused after a delete, so forget everything rather than track which binding it was
+void inspect(Tag<id_glDeleteBuffers>, GLsizei, const GLuint*) { bindings.clear(); }
+void inspect(Tag<id_glDeleteTextures>, GLsizei, const GLuint*) { bindings.clear(); }
+void inspect(Tag<id_glDeleteVertexArrays>, GLsizei, const GLuint*) { bindings.clear(); }
+void inspect(Tag<id_glDeleteFramebuffers>, GLsizei, const GLuint*) { bindings.clear(); }
+void inspect(Tag<id_glDeleteRenderbuffers>, GLsizei, const GLuint*) { bindings.clear(); }
+void inspect(Tag<id_glDeleteSamplers>, GLsizei, const GLuint*) { bindings.clear(); }
+void inspect(Tag<id_glDeleteProgram>, GLuint) { bindings.clear(); }
+
+void inspect(Tag<id_glBufferData>, GLenum, GLsizeiptr size, const void* data, GLenum) { uploaded(data, size); }
+void inspect(Tag<id_glBufferSubData>, GLenum, GLintptr, GLsizeiptr size, const void* data) { uploaded(data, size); }
+void inspect(Tag<id_glMapBufferRange>, GLenum, GLintptr, GLsizeiptr length, GLbitfield access) {
+    if (access & GL_MAP_WRITE_BIT) current.bytesUploaded += length;
+}
+void inspect(Tag<id_glTexImage1D>, GLenum, GLint, GLint, GLsizei width, GLint, GLenum format, GLenum type,
+             const void* pixels) {
+    uploaded(pixels, width * bytesPerPixel(format, type));
+}
+void inspect(Tag<id_glTexImage2D>, GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format,
+             GLenum type, const void* pixels) {
+    uploaded(pixels, (size_t)width * height * bytesPerPixel(format, type));
+}
+void inspect(Tag<id_glTexImage3D>, GLenum, GLint, GLint, GLsizei width, GLsizei height, GLsizei depth, GLint,
+             GLenum format, GLenum type, const void* pixels) {
+    uploaded(pixels, (size_t)width * height * depth * bytesPerPixel(format, type));
+}
+void inspect(Tag<id_glTexSubImage1D>, GLenum, GLint, GLint, GLsizei width, GLenum format, GLenum type,
+             const void* pixels) {
+    uploaded(pixels, width * bytesPerPixel(format, type));
+}
+void inspect(Tag<id_glTexSubImage2D>, GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format,
+             GLenum type, const void* pixels) {
+    uploaded(pixels, (size_t)width * height * bytesPerPixel(format, type));
+}
+void inspect(Tag<id_glTexSubImage3D>, GLenum, GLint, GLint, GLint, GLint, GLsizei width, GLsizei height,
+             GLsizei depth, GLenum format, GLenum type, const void* pixels) {
+    uploaded(pixels, (size_t)width * height * depth * bytesPerPixel(format, type));
+}
+void inspect(Tag<id_glCompressedTexImage2D>, GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei imageSize,
+             const void* data) {
+    uploaded(data, imageSize);
+}
+void inspect(Tag<id_glCompressedTexSubImage2D>, GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum,
+             GLsizei imageSize, const void* data) {
+    uploaded(data, imageSize);
+}
+
+template <typename T>
+void printArg(T value) { recording << value; }
+void printArg(GLubyte value) { recording << (int)value; } // GLboolean too
+void printArg(GLbyte value) { recording << (int)value; }
+template <typename T>
+void printArg(T* pointer) {
+    if (pointer) recording << (const void*)pointer;
+    else recording << "null";
+}
+
+template <typename... Args>
+void record(int id, Args... args) {
+    recording << kNames[id] << '(';
+    int i = 0;
+    int expand[] = {0, (recording << (i++ ? ", " : ""), printArg(args), 0)...};
+    (void)expand;
+    recording << ")\n";
+}
+
+// Counts and times the call it lives in
+struct CallTimer {
+    int id;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    explicit CallTimer(int id) : id(id) {}
+    ~CallTimer() {
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        totals[id].calls++;
+        totals[id].ns += ns;
+        current.calls++;
+        current.driverMs += ns * 1e-6;
+        switch (kinds[id]) {
+        case kDraw: current.draws++; break;
+        case kBind: current.binds++; break;
+        case kUniform: current.uniformUploads++; break;
+        case kOther: break;
+        }
+    }
+};
+
+// The wrapper glad's pointer is swapped for. One instantiation per entry point; the signature is
+// deduced from glad's own pointer type, so nothing here has to be written out per function.
+template <int Id, typename R, typename... Args>
+struct Hook {
+    static R (APIENTRYP original)(Args...);
+
+    static R APIENTRY call(Args... args) {
+        inspect(Tag<Id>(), args...);
+        if (recordFramesLeft > 0) record(Id, args...);
+        CallTimer timer(Id);
+        return original(args...);
+    }
+};
+
+template <int Id, typename R, typename... Args>
+R (APIENTRYP Hook<Id, R, Args...>::original)(Args...) = nullptr;
+
+template <int Id, typename R, typename... Args>
+void hook(R (APIENTRYP& slot)(Args...)) {
+    if (!slot) return; // newer than the context, never loaded
+    Hook<Id, R, Args...>::original = slot;
+    slot = &Hook<Id, R, Args...>::call;
+}
+
+bool startsWith(const char* s, const char* prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+Kind kindOf(const char* name) {
+    if (startsWith(name, "glDraw") || startsWith(name, "glMultiDraw")) return kDraw;
+    if (startsWith(name, "glBind") || strcmp(name, "glUseProgram") == 0) return kBind;
+    if (startsWith(name, "glUniform") && !startsWith(name, "glUniformBlockBinding")) return kUniform;
+    return kOther;
+}
+
+} // namespace
+
+bool GLTrace::available() {
+    return true;
+}
+
+void GLTrace::install(const char* recordPath, int recordFrames) {
+    if (hooked) return;
+    for (int id = 0; id < kFunctionCount; ++id) kinds[id] = kindOf(kNames[id]);
+    if (recordPath && recordFrames > 0) {
+        recording.open(recordPath);
+        if (recording) {
+            recordFramesLeft = recordFrames;
+            recording << "// setup\n";
+        } else {
+            std::cout << "Failed to open the GL call log " << recordPath << std::endl;
+        }
+    }
+#define GL_TRACE_FUNCTION(name) hook<id_##name>(glad_##name);
+#include "../include/utilities/gl_trace_functions.inc"
+#undef GL_TRACE_FUNCTION
+    hooked = true;
+}
+
+bool GLTrace::installed() {
+    return hooked;
+}
+
+void GLTrace::endFrame() {
+    if (!hooked) return;
+    last = current;
+    current = GLTraceFrame();
+    ++frames;
+    if (recordFramesLeft > 0) {
+        if (--recordFramesLeft > 0) recording << "// frame " << frames << '\n';
+        else recording.close();
+    }
+}
+
+const GLTraceFrame& GLTrace::lastFrame() {
+    return last;
+}
+
+void GLTrace::printSummary(std::ostream& out, int top) {
+    if (!hooked) return;
+    std::vector<int> ids;
+    for (int id = 0; id < kFunctionCount; ++id)
+        if (totals[id].calls) ids.push_back(id);
+    std::sort(ids.begin(), ids.end(), [](int a, int b) { return totals[a].ns > totals[b].ns; });
+    double frameCount = std::max<size_t>(frames, 1);
+    out << "GL entry points by driver time over " << frames << " frames:\n" << std::fixed << std::setprecision(2);
+    for (int i = 0; i < (int)ids.size() && i < top; ++i) {
+        const FunctionStats& stats = totals[ids[i]];
+        out << "  " << std::left << std::setw(36) << kNames[ids[i]] << std::right << std::setw(10) << stats.calls
+            << " calls " << std::setw(10) << stats.ns * 1e-6 << " ms " << std::setw(9) << stats.calls / frameCount
+            << " calls/frame " << std::setw(8) << stats.ns * 1e-3 / stats.calls << " us/call\n";
+    }
+    out << std::defaultfloat;
+}
+
+#endif
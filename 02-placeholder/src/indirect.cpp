@@ -0,0 +1,166 @@
+#include "../include/utilities/indirect.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+#include "../include/utilities/gl_debug.h"
+
+// Not in the 3.3 glad header
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+IndirectRenderer::~IndirectRenderer() {
+    destroy();
+}
+
+unsigned int IndirectRenderer::addMesh(const MeshData& mesh) {
+    MeshRange range;
+    range.firstIndex = (GLuint)geometry.indices.size();
+    range.indexCount = (GLuint)mesh.indices.size();
+    range.baseVertex = (GLint)geometry.vertices.size();
+    geometry.vertices.insert(geometry.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    geometry.indices.insert(geometry.indices.end(), mesh.indices.begin(), mesh.indices.end());
+    meshes.push_back(range);
+    return (unsigned int)meshes.size() - 1;
+}
+
+void IndirectRenderer::init(GLADloadproc load, bool allowMultiDraw) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    // Below 4.3 MDI needs the extension, and the draw id needs baseInstance, which is only core
+    // from 4.2: without ARB_base_instance every command would read draw id 0
+    bool hasMultiDraw = false, hasBaseInstance = false;
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions; ++i) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (!name) continue;
+        if (strcmp(name, "GL_ARB_multi_draw_indirect") == 0) hasMultiDraw = true;
+        if (strcmp(name, "GL_ARB_base_instance") == 0) hasBaseInstance = true;
+    }
+    bool core43 = major > 4 || (major == 4 && minor >= 3);
+    bool baseInstance = hasBaseInstance || major > 4 || (major == 4 && minor >= 2);
+    if (allowMultiDraw && (core43 || (hasMultiDraw && baseInstance))) {
+        multiDraw = (MultiDrawElementsIndirectFn)load("glMultiDrawElementsIndirect");
+    }
+    std::cout << "Indirect renderer: " << (multiDraw ? "glMultiDrawElementsIndirect" : "glDrawElementsInstancedBaseVertex loop")
+              << " (GL " << major << "." << minor << ")" << std::endl;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &drawIdVBO);
+    glGenBuffers(1, &indirectBuffer);
+    glGenBuffers(1, &drawDataBuffer);
+    glGenTextures(1, &drawDataTexture);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, geometry.vertices.size() * sizeof(Vertex), geometry.vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, geometry.indices.size() * sizeof(unsigned int), geometry.indices.data(), GL_STATIC_DRAW);
+
+    // Draw id: with MDI it's an instanced attribute over 0, 1, 2... and each command's
+    // baseInstance picks its entry. The fallback leaves the array off and sets a constant per draw.
+    if (multiDraw) {
+        growDrawIds(1024);
+        glEnableVertexAttribArray(3);
+    }
+    glBindVertexArray(0);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+    GLDebugLog::label(GL_VERTEX_ARRAY, VAO, "indirect shapes");
+    GLDebugLog::label(GL_BUFFER, VBO, "indirect shape vertices");
+    GLDebugLog::label(GL_BUFFER, EBO, "indirect shape indices");
+    GLDebugLog::label(GL_BUFFER, drawDataBuffer, "indirect per-draw data");
+    GLDebugLog::label(GL_TEXTURE, drawDataTexture, "indirect per-draw data");
+
+    MeshData().vertices.swap(geometry.vertices);
+    MeshData().indices.swap(geometry.indices);
+}
+
+void IndirectRenderer::growDrawIds(size_t count) {
+    std::vector<GLuint> ids(count);
+    for (size_t i = 0; i < count; ++i) ids[i] = (GLuint)i;
+    glBindBuffer(GL_ARRAY_BUFFER, drawIdVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(3, 1);
+    drawIdCapacity = count;
+}
+
+void IndirectRenderer::destroy() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    unsigned int buffers[] = {VBO, EBO, drawIdVBO, indirectBuffer, drawDataBuffer};
+    for (unsigned int buffer : buffers) {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+    if (drawDataTexture) glDeleteTextures(1, &drawDataTexture);
+    VAO = VBO = EBO = drawIdVBO = indirectBuffer = drawDataBuffer = drawDataTexture = 0;
+    drawIdCapacity = 0;
+}
+
+void IndirectRenderer::begin() {
+    commands.clear();
+    drawData.clear();
+}
+
+void IndirectRenderer::add(unsigned int mesh, const glm::mat4& transform, const glm::vec4& tint) {
+    const MeshRange& range = meshes[mesh];
+    DrawElementsIndirectCommand command;
+    command.count = range.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = range.firstIndex;
+    command.baseVertex = range.baseVertex;
+    command.baseInstance = (GLuint)commands.size(); // = draw id
+    commands.push_back(command);
+
+    drawData.push_back(transform[0]);
+    drawData.push_back(transform[1]);
+    drawData.push_back(transform[2]);
+    drawData.push_back(transform[3]);
+    drawData.push_back(tint);
+}
+
+void IndirectRenderer::submit(int drawDataUnit) {
+    if (commands.empty()) return;
+
+    // Per-draw data, orphaned every frame like the other streaming buffers
+    glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, drawData.size() * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, drawData.size() * sizeof(glm::vec4), drawData.data());
+    glActiveTexture(GL_TEXTURE0 + drawDataUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+
+    glBindVertexArray(VAO);
+    if (multiDraw) {
+        if (commands.size() > drawIdCapacity) {
+            growDrawIds(commands.size() * 2);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        multiDraw(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commands.size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else {
+        for (size_t i = 0; i < commands.size(); ++i) {
+            const DrawElementsIndirectCommand& c = commands[i];
+            glVertexAttribI1ui(3, c.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, c.count, GL_UNSIGNED_INT,
+                                              (void*)(c.firstIndex * sizeof(unsigned int)), c.instanceCount, c.baseVertex);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#include "../include/utilities/instancing.h"
+
+#include <cmath>
+#include <cstddef>
+
+#include "../include/utilities/batch_math.h"
+#include "../include/utilities/gl_debug.h"
+
+InstancedRenderer::~InstancedRenderer() {
+    destroy();
+}
+
+void InstancedRenderer::init() {
+    // Unit quad, same attribute locations as the hard-coded one (0 position, 2 uv)
+    float quad[] = {
+        // Positions          // Texture Coords
+        -0.5f, -0.5f, 0.0f,   0.0f, 0.0f,
+        -0.5f,  0.5f, 0.0f,   0.0f, 1.0f,
+         0.5f, -0.5f, 0.0f,   1.0f, 0.0f,
+         0.5f,  0.5f, 0.0f,   1.0f, 1.0f,
+    };
+    unsigned int indices[] = {
+        0, 1, 2,
+        3, 1, 2,
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &instanceVBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    // Per-instance attributes: divisor 1 means "advance once per instance, not per vertex"
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int column = 0; column < 4; ++column) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, uvRect));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, tint));
+    glEnableVertexAttribArray(8);
+    glVertexAttribDivisor(8, 1);
+
+    glBindVertexArray(0);
+    GLDebugLog::label(GL_VERTEX_ARRAY, VAO, "instanced quads");
+    GLDebugLog::label(GL_BUFFER, quadVBO, "instanced quad vertices");
+    GLDebugLog::label(GL_BUFFER, EBO, "instanced quad indices");
+    GLDebugLog::label(GL_BUFFER, instanceVBO, "instance data (streamed)");
+}
+
+void InstancedRenderer::draw(const std::vector<InstanceData>& instances) {
+    if (instances.empty()) return;
+    size_t bytes = instances.size() * sizeof(InstanceData);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (instances.size() > capacity) {
+        capacity = instances.size() + instances.size() / 2;
+    }
+    // Orphan the old storage first: the driver hands us fresh memory instead of waiting
+    // for the GPU to finish reading last frame's instances
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances.data());
+
+    glBindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, (GLsizei)instances.size());
+}
+
+void InstancedRenderer::destroy() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (quadVBO) glDeleteBuffers(1, &quadVBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+    if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
+    VAO = quadVBO = EBO = instanceVBO = 0;
+    capacity = 0;
+}
+
+// Instances [begin, end) of a count quad stress scene, out already sized
+static void buildStressRange(std::vector<InstanceData>& out, int count, int begin, int end, float time) {
+    if (begin >= end) return;
+    int side = (int)std::ceil(std::sqrt((float)count));
+    float cell = 2.0f / side;
+    // translate * rotate(z) * scale, gathered as SoA and composed 4/8 at a time straight into the instances
+    TransformArrays transforms;
+    transforms.resize(end - begin);
+    for (int i = begin; i < end; ++i) {
+        int x = i % side, y = i / side, k = i - begin;
+        float halfAngle = 0.5f * (time + i * 0.1f);
+        transforms.px[k] = -1.0f + cell * (x + 0.5f);
+        transforms.py[k] = -1.0f + cell * (y + 0.5f);
+        transforms.pz[k] = 0.0f;
+        transforms.qx[k] = transforms.qy[k] = 0.0f;
+        transforms.qz[k] = std::sin(halfAngle);
+        transforms.qw[k] = std::cos(halfAngle);
+        transforms.sx[k] = transforms.sy[k] = transforms.sz[k] = cell * 0.8f;
+    }
+    composeTRS(transforms, &out[begin].transform, MathPath::Auto, sizeof(InstanceData));
+
+    for (int i = begin; i < end; ++i) {
+        InstanceData& instance = out[i];
+
+        // Every other quad only shows one quarter of the texture
+        if (i % 2) instance.uvRect = glm::vec4(0.5f * ((i / 2) % 2), 0.5f * ((i / 4) % 2), 0.5f, 0.5f);
+        else instance.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+        unsigned int h = (unsigned int)i * 2654435761u;
+        instance.tint = glm::vec4(0.5f + (h & 0xFF) / 510.0f, 0.5f + ((h >> 8) & 0xFF) / 510.0f,
+                                  0.5f + ((h >> 16) & 0xFF) / 510.0f, 1.0f);
+    }
+}
+
+void buildStressScene(std::vector<InstanceData>& out, int count, float time) {
+    out.resize(count);
+    buildStressRange(out, count, 0, count, time);
+}
+
+void buildStressScene(std::vector<InstanceData>& out, int count, float time, JobSystem& jobs) {
+    out.resize(count);
+    jobs.parallelFor("animate", count, sizeof(InstanceData), [&](size_t begin, size_t end) {
+        buildStressRange(out, count, (int)begin, (int)end, time);
+    }, 1024);
+}
@@ -0,0 +1,283 @@
+#include "../include/utilities/jobs.h"
+#include "../include/utilities/profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+struct Job {
+    const char* name;
+    std::function<void()> fn;
+    JobCounter* counter;
+};
+
+namespace {
+
+// Which system/deque the current thread works for
+thread_local const JobSystem* currentSystem = nullptr;
+thread_local int currentDeque = -1;
+
+const size_t kMaxTraceEvents = 200000; // per thread
+
+} // namespace
+
+WorkDeque::WorkDeque() : slots(new std::atomic<Job*>[kCapacity]) {}
+
+bool WorkDeque::push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= kCapacity) return false;
+    slots[b & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* WorkDeque::pop() {
+    // Claim the bottom slot first, then see whether a thief got there too
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = slots[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // The last job: whoever moves top first gets it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* WorkDeque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    Job* job = slots[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+    return job;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+JobSystem::JobSystem(unsigned int threads)
+    : owner(std::this_thread::get_id()), epoch(std::chrono::steady_clock::now()) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < threads; ++i) {
+        deques.push_back(std::unique_ptr<WorkDeque>(new WorkDeque()));
+        perThread.push_back(std::unique_ptr<PerThread>(new PerThread()));
+        perThread.back()->rng = 0x9E3779B9u * (i + 1);
+    }
+    for (unsigned int i = 1; i < threads; ++i) workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem() {
+    quit = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (std::thread& w : workers) w.join();
+    // Whatever nobody waited for
+    for (std::unique_ptr<WorkDeque>& d : deques) {
+        while (Job* job = d->pop()) delete job;
+    }
+}
+
+int JobSystem::currentIndex() const {
+    if (currentSystem == this) return currentDeque;
+    return std::this_thread::get_id() == owner ? 0 : -1;
+}
+
+double JobSystem::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void JobSystem::run(const char* name, std::function<void()> fn, JobCounter* counter, JobCounter* after) {
+    Job* job = new Job();
+    job->name = name;
+    job->fn = std::move(fn);
+    job->counter = counter;
+    if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+    if (after) {
+        std::lock_guard<std::mutex> lock(after->mutex);
+        if (after->pending.load(std::memory_order_acquire) > 0) {
+            // finish() schedules it when after reaches zero
+            after->waiting.push_back(job);
+            return;
+        }
+    }
+    schedule(job);
+}
+
+void JobSystem::schedule(Job* job) {
+    int self = currentIndex();
+    if (self < 0 || !deques[self]->push(job)) {
+        // No deque of our own, or it's full: just do it now
+        execute(job, self);
+        return;
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    if (sleepers.load(std::memory_order_acquire) > 0) wake.notify_one();
+}
+
+Job* JobSystem::find(unsigned int self) {
+    Job* job = deques[self]->pop();
+    if (!job && deques.size() > 1) {
+        // Steal, starting from a random victim so thieves don't all pile onto the same deque
+        PerThread& me = *perThread[self];
+        me.rng = me.rng * 1664525u + 1013904223u;
+        size_t count = deques.size();
+        size_t start = (me.rng >> 16) % count;
+        for (size_t k = 0; k < count && !job; ++k) {
+            size_t victim = (start + k) % count;
+            if (victim == (size_t)self) continue;
+            job = deques[victim]->steal();
+            if (job) me.stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (job) queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::execute(Job* job, int self) {
+    bool trace = self >= 0 && tracing.load(std::memory_order_relaxed);
+    double start = trace ? now() : 0.0;
+    {
+        PROFILE_SCOPE(job->name);
+        job->fn();
+    }
+    if (self >= 0) {
+        PerThread& me = *perThread[self];
+        me.executed.fetch_add(1, std::memory_order_relaxed);
+        if (trace && me.trace.size() < kMaxTraceEvents) {
+            TraceEvent event = {job->name, start, now()};
+            me.trace.push_back(event);
+        }
+    }
+    JobCounter* counter = job->counter;
+    delete job;
+    if (counter) finish(counter);
+}
+
+void JobSystem::finish(JobCounter* counter) {
+    // Under the counter's lock, so run(..., after) either sees it pending or finds its job scheduled,
+    // and wait() can't return (and the counter go away) while we still hold it
+    std::vector<Job*> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) ready.swap(counter->waiting);
+    }
+    for (Job* job : ready) schedule(job);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    int self = currentIndex();
+    while (!counter.done()) {
+        Job* job = self >= 0 ? find(self) : nullptr;
+        if (job) execute(job, self);
+        else std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> sync(counter.mutex);
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+    currentSystem = this;
+    currentDeque = (int)index;
+    Profiler::setThreadName("worker " + std::to_string(index));
+    int idle = 0;
+    while (!quit.load(std::memory_order_acquire)) {
+        Job* job = find(index);
+        if (job) {
+            execute(job, (int)index);
+            idle = 0;
+            continue;
+        }
+        // Spin a little (more work usually follows right away), then sleep until there is some
+        if (++idle < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        ++sleepers;
+        wake.wait_for(lock, std::chrono::milliseconds(1), [&]() { return quit.load() || queued.load() > 0; });
+        --sleepers;
+    }
+}
+
+void JobSystem::parallelFor(const char* name, size_t count, size_t itemBytes,
+                            const std::function<void(size_t, size_t)>& fn, size_t minBatch) {
+    if (count == 0) return;
+    PROFILE_SCOPE(name);
+    // A few batches per thread so stealing can even out uneven work
+    // Batches a multiple of lcm(itemBytes, 64) bytes, so every boundary falls on a line boundary:
+    // 64 / gcd(itemBytes, 64) items (12-byte items -> 16, 80-byte items -> 4)
+    size_t step = 1;
+    if (itemBytes > 0) {
+        size_t a = itemBytes, b = 64;
+        while (b) {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        step = 64 / a;
+    }
+    size_t batch = std::max(minBatch, (count + threadCount() * 4 - 1) / (threadCount() * 4));
+    batch = (batch + step - 1) / step * step;
+    if (batch >= count || threadCount() == 1) {
+        fn(0, count);
+        return;
+    }
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += batch) {
+        size_t end = std::min(count, begin + batch);
+        run(name, [&fn, begin, end]() { fn(begin, end); }, &counter);
+    }
+    wait(counter);
+}
+
+void JobSystem::startTrace() {
+    for (std::unique_ptr<PerThread>& t : perThread) t->trace.clear();
+    tracing = true;
+}
+
+bool JobSystem::writeTrace(const char* path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cout << "Failed to write the job trace " << path << std::endl;
+        return false;
+    }
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+    for (size_t t = 0; t < perThread.size(); ++t) {
+        out << (t ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+            << ",\"args\":{\"name\":\"" << (t ? "worker " : "main ") << t << "\"}}";
+        for (const TraceEvent& e : perThread[t]->trace) {
+            out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t << ",\"ts\":" << e.start
+                << ",\"dur\":" << e.end - e.start << "}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+JobStats JobSystem::stats() const {
+    JobStats total;
+    for (const std::unique_ptr<PerThread>& t : perThread) {
+        total.executed += t->executed.load(std::memory_order_relaxed);
+        total.stolen += t->stolen.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void JobSystem::resetStats() {
+    for (std::unique_ptr<PerThread>& t : perThread) {
+        t->executed = 0;
+        t->stolen = 0;
+    }
+}
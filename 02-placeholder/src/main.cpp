@@ -5,8 +5,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "utilities/utilities.hpp"
 
@@ -14,45 +20,110 @@
 #include <stb/stb_image.h>
 
 #include "utilities/shaders.h"
-
-
-
-int main(){
+#include "utilities/bench_recorder.h"
+#include "utilities/camera.h"
+#include "utilities/culling.h"
+#include "utilities/display.h"
+#include "utilities/dynamic_resolution.h"
+#include "utilities/frame_pacing.h"
+#include "utilities/gl_debug.h"
+#include "utilities/gl_trace.h"
+#include "utilities/indirect.h"
+#include "utilities/jobs.h"
+#include "utilities/instancing.h"
+#include "utilities/mesh.h"
+#include "utilities/options.h"
+#include "utilities/post_process.h"
+#include "utilities/profiler.h"
+#include "utilities/readback.h"
+#include "utilities/video_recorder.h"
+#include "utilities/render_graph.h"
+#include "utilities/render_queue.h"
+#include "utilities/render_thread.h"
+#include "utilities/scene_graph.h"
+#include "utilities/timestep.h"
+#include "utilities/sprite_batch.h"
+
+
+
+int main(int argc, char** argv){
+
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return -1;
+    }
+    Profiler::setEnabled(!options.profilePath.empty());
+    // Benchmark runs: a fixed number of frames, the simulation on a fixed clock so every run draws the same
+    // frames, no vsync unless asked for, and everything on this thread
+    const double kBenchFrameTime = 1.0 / 60.0;
+    bool bench = options.benchFrames > 0;
+    if (bench) {
+        options.frames = options.benchFrames;
+        if (options.swapInterval == kDriverSwapInterval) options.swapInterval = 0;
+        if (options.renderThread) std::cout << "--bench runs without the render thread, ignoring it" << std::endl;
+        options.renderThread = false;
+    }
+    Profiler::setThreadName("main");
 
     int success;
     char info[512];
 
-    glfwInit();
-    // OpenGL version 3.3
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    // If on macOS...
-# ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Hello World!", nullptr, nullptr);
-    if (window == nullptr) {
-        // If unable to create the window...
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // A window, or with --headless an offscreen framebuffer without any window system
+    Display display;
+    bool debugContext = !options.glDebugPath.empty();
+    bool created = options.headless ? display.createHeadless(options.width, options.height, debugContext)
+                                    : display.createWindow(options.width, options.height, "Hello World!", debugContext);
+    if (!created) {
         return -1;
     }
-    glfwMakeContextCurrent(window);
 
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+    if (!gladLoadGLLoader(display.loader())) {
         std::cout << "Failed to initialize GLAD" << std::endl;
-        glfwTerminate();
+        display.destroy();
         return -1;
     }
 
     // Where to locate the window? how big?
-    glViewport(0, 0, 800, 600);
+    glViewport(0, 0, options.width, options.height);
+    Profiler::initGpu();
+
+    // From here on every GL call through glad can be counted, timed and logged
+    if (options.glStats || !options.glRecordPath.empty()) {
+        if (GLTrace::available()) {
+            GLTrace::install(options.glRecordPath.empty() ? nullptr : options.glRecordPath.c_str(), options.glRecordFrames);
+        }
+        else {
+            std::cout << "Built without GL_TRACE, ignoring --gl-stats/--gl-record" << std::endl;
+        }
+    }
+
+    // Driver messages (errors, performance warnings) into a log, objects get names from here on
+    GLDebugLog debugLog;
+    if (debugContext && debugLog.init(display.loader(), options.glDebugPath.c_str())) {
+        GLDebugLog::label(GL_FRAMEBUFFER, display.framebuffer(), "offscreen target");
+    }
 
     // If I resize the window, add a callback
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    if (display.glfwWindow()) glfwSetFramebufferSizeCallback(display.glfwWindow(), framebuffer_size_callback);
+
+    // Worker threads for the per-frame work (culling, animation, transforms) and asset decoding
+    JobSystem jobs;
+    if (!options.jobTracePath.empty()) jobs.startTrace();
+
+    // Decode both images on the workers while this thread compiles shaders and fills buffers
+    struct DecodedImage {
+        unsigned char* data = nullptr;
+        int width = 0, height = 0, channels = 0;
+    };
+    DecodedImage images[2];
+    const char* imagePaths[2] = {"../assets/cat.jpeg", "../assets/nyan.PNG"};
+    JobCounter decoded;
+    stbi_set_flip_vertically_on_load(1);
+    for (int i = 0; i < 2; ++i) {
+        jobs.run("decode image", [&images, &imagePaths, i]() {
+            images[i].data = stbi_load(imagePaths[i], &images[i].width, &images[i].height, &images[i].channels, 0);
+        }, &decoded);
+    }
 
     Shader shader("../assets/vertex_core.glsl", "../assets/fragment_core.glsl");
 
@@ -92,11 +163,14 @@ int main(){
     //Set attribute pointer (texture)
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
+    GLDebugLog::label(GL_VERTEX_ARRAY, VAO, "quad");
+    GLDebugLog::label(GL_BUFFER, VBO, "quad vertices");
 
     // TEXTURES
     unsigned int texture1, texture2;
     glGenTextures(1, &texture1);
     glBindTexture(GL_TEXTURE_2D, texture1);
+    GLDebugLog::label(GL_TEXTURE, texture1, imagePaths[0]);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -105,11 +179,12 @@ int main(){
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // load image
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(1);
-    unsigned char* data = stbi_load("../assets/cat.jpeg", &width, &height, &nrChannels, 0);
+    jobs.wait(decoded);
+    int width = images[0].width, height = images[0].height, nrChannels = images[0].channels;
+    unsigned char* data = images[0].data;
 
     if (data) {
+        PROFILE_SCOPE("upload texture");
         int format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
@@ -122,13 +197,18 @@ int main(){
 
     glGenTextures(1, &texture2);
     glBindTexture(GL_TEXTURE_2D, texture2);
+    GLDebugLog::label(GL_TEXTURE, texture2, imagePaths[1]);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    data = stbi_load("../assets/nyan.PNG", &width, &height, &nrChannels, 0);
+    data = images[1].data;
+    width = images[1].width;
+    height = images[1].height;
+    nrChannels = images[1].channels;
     if (data) {
+        PROFILE_SCOPE("upload texture");
         int format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
@@ -150,44 +230,784 @@ int main(){
     // set up EBO
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    GLDebugLog::label(GL_BUFFER, EBO, "quad indices");
+
+    // The quad's transform: a fixed placement with the spinning part as its child
+    SceneGraph scene;
+    glm::mat4 placement = glm::mat4(1.0f);
+    placement = glm::rotate(placement, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    placement = glm::scale(placement, glm::vec3(0.5f));
+    uint32_t quadNode = scene.add(scene.add(SceneGraph::kNoParent, placement));
+    scene.update();
+
+
+    shader.setMat4("transform", scene.world(quadNode));
+
+    // Optional model from disk. The first run parses it (on all cores) and writes a binary cache
+    // next to it, later runs just mmap the cache straight into the VBO/EBO.
+    Mesh mesh;
+    bool drawMesh = false;
+    if (!options.meshPath.empty()) {
+        const char* path = options.meshPath.c_str();
+        std::string cache = MeshLoader::cachePath(path);
+        if (MeshLoader::isCacheValid(cache.c_str(), path) && mesh.uploadFromCache(cache.c_str())) {
+            drawMesh = true;
+        }
+        else {
+            MeshLoader loader;
+            MeshData data;
+            if (loader.load(path, data)) {
+                const MeshLoadStats& stats = loader.lastStats();
+                std::cout << "Loaded " << path << ": " << stats.triangles << " triangles, " << stats.vertices
+                          << " vertices (parse " << stats.parseMs << " ms, weld " << stats.weldMs << " ms)" << std::endl;
+                mesh.upload(data);
+                drawMesh = true;
+            }
+        }
+    }
 
-    glm::mat4 trans = glm::mat4(1.0f);
-    trans = glm::rotate(trans, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    trans = glm::scale(trans, glm::vec3(0.5f));
+    // Stress scene: lots of quads, either one instanced draw or one draw per quad
+    InstancedRenderer instanced;
+    std::unique_ptr<Shader> instancedShader;
+    std::vector<InstanceData> instances;
+    if (options.stressCount > 0 && !options.naive) {
+        instanced.init();
+        instancedShader.reset(new Shader("../assets/instanced_vertex.glsl", "../assets/instanced_fragment.glsl"));
+        instancedShader->activate();
+        instancedShader->setInt("texture1", 0);
+        instancedShader->setInt("texture2", 1);
+    }
+    // Sprite scene: the cat/nyan quad as thousands of 2D sprites, batched
+    SpriteBatch spriteBatch;
+    std::unique_ptr<Shader> spriteShader;
+    if (options.spriteCount > 0) {
+        spriteBatch.init();
+        spriteShader.reset(new Shader("../assets/sprite_vertex.glsl", "../assets/sprite_fragment.glsl"));
+    }
 
+    // Indirect scene: n objects out of a few shapes sharing one buffer, submitted as command records
+    IndirectRenderer indirect;
+    std::unique_ptr<Shader> indirectShader;
+    std::vector<unsigned int> shapes;
+    if (options.indirectCount > 0) {
+        for (int sides = 3; sides <= 8; ++sides) {
+            shapes.push_back(indirect.addMesh(makePolygonMesh(sides)));
+        }
+        indirect.init(display.loader(), !options.noMultiDraw);
+        indirectShader.reset(new Shader("../assets/indirect_vertex.glsl", "../assets/instanced_fragment.glsl"));
+        indirectShader->activate();
+        indirectShader->setInt("texture1", 0);
+        indirectShader->setInt("texture2", 1);
+        indirectShader->setInt("drawData", 2);
+    }
 
-    shader.setMat4("transform", trans);
+    // Material scene: quads spread over 64 materials (two programs, a color texture each, one in 8
+    // translucent), drawn through the render queue
+    RenderQueue renderQueue;
+    GLStateCache stateCache;
+    std::unique_ptr<Shader> materialShader;
+    std::vector<unsigned int> materialTextures;
+    double sortTime = 0.0;
+    if (options.materialCount > 0) {
+        materialShader.reset(new Shader("../assets/vertex_core.glsl", "../assets/material_fragment.glsl"));
+        materialShader->activate();
+        materialShader->setInt("texture1", 0);
+        materialShader->setInt("texture2", 1);
+        shader.activate();
+        materialTextures.resize(64);
+        glGenTextures((GLsizei)materialTextures.size(), materialTextures.data());
+        for (size_t m = 0; m < materialTextures.size(); ++m) {
+            unsigned int h = (unsigned int)m * 2654435761u;
+            unsigned char color[4] = {(unsigned char)(h >> 24), (unsigned char)(h >> 16), (unsigned char)(h >> 8),
+                                      (unsigned char)(m % 8 == 7 ? 128 : 255)};
+            glBindTexture(GL_TEXTURE_2D, materialTextures[m]);
+            GLDebugLog::label(GL_TEXTURE, materialTextures[m], ("material " + std::to_string(m)).c_str());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        }
+    }
 
-    while (!glfwWindowShouldClose(window)) {
-        // Process inputs
-        processInput(window);
+    // Frustum culling for the indirect scene
+    BoundingSpheres bounds;
+    std::vector<uint32_t> visible;
+    double cullTime = 0.0;
+
+    // The quad spins at a fixed rate in simulation time; frames blend the last two ticks
+    FixedTimestep timestep(options.tickRate, options.maxTicks);
+    const float spinSpeed = glm::radians(45.0f);
+    float previousAngle = 0.0f, angle = 0.0f;
+
+    // Swap interval, frame limiter and frames in flight. Paces the single-threaded loop only.
+    FramePacer pacer;
+    PacingSettings pacing;
+    pacing.swapInterval = options.swapInterval;
+    pacing.targetFps = options.targetFps;
+    pacing.maxFramesInFlight = options.framesInFlight;
+    pacing.lowLatency = options.lowLatency;
+    pacer.init(pacing, display);
+    double lastPacingReport = display.time();
+
+    // Render thread: from here on it owns the context, the main thread keeps the window events
+    RenderThread renderThread;
+    if (options.renderThread) {
+        if (options.naive || options.spriteCount > 0 || options.indirectCount > 0 || options.materialCount > 0 || drawMesh) {
+            std::cout << "--render-thread only draws the quad and the instanced --stress scene, ignoring it" << std::endl;
+        }
+        else {
+            // The resize callback would call glViewport without a context, the packet carries the size instead
+            if (display.glfwWindow()) glfwSetFramebufferSizeCallback(display.glfwWindow(), nullptr);
+            display.makeCurrent(false);
+            int viewportWidth = 0, viewportHeight = 0;
+            renderThread.start(display, [&, viewportWidth, viewportHeight](const FramePacket& packet) mutable {
+                // Once per frame on this thread, the previous frame's scopes are all closed by now
+                Profiler::endFrame();
+                GLTrace::endFrame();
+                debugLog.endFrame();
+                GPU_PROFILE_SCOPE("frame");
+                if (packet.framebufferWidth != viewportWidth || packet.framebufferHeight != viewportHeight) {
+                    viewportWidth = packet.framebufferWidth;
+                    viewportHeight = packet.framebufferHeight;
+                    glViewport(0, 0, viewportWidth, viewportHeight);
+                }
+                glClearColor(0.2f, 0.3f, 0.5f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+
+                shader.activate();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, texture1);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, texture2);
+                if (!packet.instances.empty()) {
+                    instancedShader->activate();
+                    instanced.draw(packet.instances);
+                }
+                else {
+                    shader.setMat4("transform", packet.quadTransform);
+                    glBindVertexArray(VAO);
+                    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                }
+            });
+        }
+    }
 
-        // render some colors
-        glClearColor(0.2f, 0.3f, 0.5f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+    // Scene at a lower resolution when it goes over its GPU budget, upscaled into the framebuffer
+    DynamicResolution dynamicRes;
+    bool scaling = false;
+    if (options.dynamicResBudget > 0.0) {
+        if (renderThread.running()) {
+            std::cout << "--dynamic-res runs without the render thread, ignoring it" << std::endl;
+        }
+        else if (options.renderGraph) {
+            std::cout << "--render-graph has its own scene target, ignoring --dynamic-res" << std::endl;
+        }
+        else {
+            DynamicResolutionSettings settings;
+            settings.budgetMs = options.dynamicResBudget;
+            settings.minScale = options.minScale;
+            settings.sharpness = options.sharpen;
+            scaling = dynamicRes.init(settings);
+        }
+    }
 
-        shader.activate();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
+    // Render graph: the scene into a transient target, a bloom on it at half size, composited into the
+    // framebuffer (or through the post chain). Rebuilt when the framebuffer size changes.
+    RenderGraph graph;
+    PostChain postChain;
+    bool post = false;
+    bool useGraph = false;
+    int graphWidth = 0, graphHeight = 0;
+    std::unique_ptr<Shader> bloomExtractShader, blurShader, compositeShader;
+    GLuint postVAO = 0;
+    if (options.renderGraph) {
+        if (renderThread.running()) {
+            std::cout << "--render-graph runs without the render thread, ignoring it" << std::endl;
+        }
+        else {
+            bloomExtractShader.reset(new Shader("../assets/fullscreen_vertex.glsl", "../assets/bloom_extract_fragment.glsl"));
+            bloomExtractShader->activate();
+            bloomExtractShader->setInt("scene", 0);
+            bloomExtractShader->setFloat("threshold", 0.5f);
+            blurShader.reset(new Shader("../assets/fullscreen_vertex.glsl", "../assets/blur_fragment.glsl"));
+            blurShader->activate();
+            blurShader->setInt("image", 0);
+            compositeShader.reset(new Shader("../assets/fullscreen_vertex.glsl", "../assets/composite_fragment.glsl"));
+            compositeShader->activate();
+            compositeShader->setInt("scene", 0);
+            compositeShader->setInt("bloom", 1);
+            compositeShader->setFloat("strength", options.bloom);
+            glGenVertexArrays(1, &postVAO);
+            useGraph = true;
+
+            std::vector<PostEffect> effects;
+            if (!options.postEffects.empty() && !parsePostEffects(options.postEffects, effects)) {
+                std::cout << "Failed to read --post " << options.postEffects
+                          << ": tonemap, grade, vignette or sharpen, each once, comma separated" << std::endl;
+            }
+            else if (!effects.empty()) {
+                post = postChain.init(effects, PostSettings(), !options.postUnfused);
+            }
+        }
+    }
+    auto drawFullscreen = [&](Shader& program, GLuint texture0, GLuint texture1) {
+        program.activate();
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+        glBindTexture(GL_TEXTURE_2D, texture1);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture0);
+        glBindVertexArray(postVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    };
+    auto buildGraph = [&](int width, int height) {
+        graph.clear();
+        RGTextureDesc full;
+        full.width = width;
+        full.height = height;
+        // The post chain's tone mapper takes HDR
+        if (post) full.format = GL_RGBA16F;
+        RGTextureDesc half;
+        half.width = std::max(1, width / 2);
+        half.height = std::max(1, height / 2);
+        RGTexture sceneColor = graph.createTexture("scene color", full);
+        RGTexture bright = graph.createTexture("bloom bright", half);
+        RGTexture blurredX = graph.createTexture("bloom blur x", half);
+        RGTexture bloom = graph.createTexture("bloom", half);
+        RGTexture framebuffer = graph.importFramebuffer("framebuffer", display.framebuffer(), width, height);
+        RGTexture output = post ? graph.createTexture("composited", full) : framebuffer;
+
+        // Drawn by the loop below, between the two execute() calls
+        graph.addPass("scene").write(sceneColor);
+        graph.addPass("bloom extract", [&, sceneColor](RenderGraphContext& context) {
+            drawFullscreen(*bloomExtractShader, context.texture(sceneColor), 0);
+        }).read(sceneColor).write(bright);
+        graph.addPass("bloom blur x", [&, bright](RenderGraphContext& context) {
+            blurShader->activate();
+            glUniform2f(glGetUniformLocation(blurShader->id, "direction"), 1.0f / context.width(), 0.0f);
+            drawFullscreen(*blurShader, context.texture(bright), 0);
+        }).read(bright).write(blurredX);
+        graph.addPass("bloom blur y", [&, blurredX](RenderGraphContext& context) {
+            blurShader->activate();
+            glUniform2f(glGetUniformLocation(blurShader->id, "direction"), 0.0f, 1.0f / context.height());
+            drawFullscreen(*blurShader, context.texture(blurredX), 0);
+        }).read(blurredX).write(bloom);
+        // Without bloom nothing reads it and the three passes above are culled
+        graph.addPass("composite", [&, sceneColor, bloom](RenderGraphContext& context) {
+            drawFullscreen(*compositeShader, context.texture(sceneColor), context.texture(bloom));
+        }).read(sceneColor).read(options.bloom > 0.0f ? bloom : RGTexture()).write(output);
+        if (post) postChain.addPasses(graph, output, framebuffer, width, height);
+
+        if (graph.compile()) graph.printSummary(std::cout);
+        if (post) postChain.printPlan(std::cout, width, height);
+        graphWidth = width;
+        graphHeight = height;
+    };
 
-        trans = glm::rotate(trans, glm::radians((float)glfwGetTime() / 20.0f), glm::vec3(0.3f, 0.7f, 1.0f));
-        shader.setMat4("transform", trans);
+    // Framebuffer readback for F12 screenshots, --capture and --record, frames later on a worker unless --sync-readback
+    AsyncReadback readback;
+    bool readbackReady = false;
+    uint64_t captureHash = 14695981039346656037ull;
+    int capturedFrames = 0;
+    bool screenshotKeyDown = false;
+    bool recording = !options.recordPath.empty();
+    if (options.capture || recording || display.glfwWindow()) {
+        if (renderThread.running()) {
+            if (options.capture) std::cout << "--capture runs without the render thread, ignoring it" << std::endl;
+            if (recording) std::cout << "--record runs without the render thread, ignoring it" << std::endl;
+            recording = false;
+        }
+        else {
+            readback.init(options.readbackSlots, options.syncReadback);
+            readbackReady = true;
+        }
+    }
+    // The readback worker converts each frame for the recording, a writer thread behind it writes them
+    VideoRecorder video;
+    double recordStart = 0.0;
+    if (recording) {
+        int fbWidth, fbHeight;
+        display.framebufferSize(fbWidth, fbHeight);
+        recording = video.open(options.recordPath.c_str(), fbWidth, fbHeight, options.recordFps);
+        recordStart = display.time();
+    }
 
+    BenchRecorder recorder;
+    BenchResult benchResult;
+    if (bench) recorder.init(std::min(10, options.benchFrames / 10));
+
+    double updateTime = 0.0, submitTime = 0.0;
+    int cpuFrames = 0;
+    double lastReport = display.time();
+    bool profileKeyDown = false;
+
+    int frame = 0;
+    while (!display.shouldClose()) {
+        PROFILE_SCOPE("frame");
+        bool paced = !renderThread.running();
+        if (paced) {
+            pacer.beginFrame();
+            // Low latency: events are read right after the wait rather than after the last swap
+            if (pacer.lowLatency()) display.pollEvents();
+        }
+        if (bench) recorder.beginFrame();
+        // What the simulation and animations run on. Recordings step it by their frame rate, so a
+        // headless run renders the video as fast as it can regardless of real time.
+        double simTime = bench ? frame * kBenchFrameTime : display.time();
+        if (recording && !bench) simTime = (double)frame / options.recordFps;
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        // Process inputs
+        if (display.glfwWindow()) processInput(display.glfwWindow());
+        bool report = cpuFrames > 0 && display.time() - lastReport > 2.0;
+        // P writes the profile so far
+        bool profileKey = display.keyDown(GLFW_KEY_P);
+        if (profileKey && !profileKeyDown && Profiler::enabled() && Profiler::writeTrace(options.profilePath.c_str())) {
+            std::cout << "Wrote the profile to " << options.profilePath << std::endl;
+        }
+        profileKeyDown = profileKey;
+
+        {
+            PROFILE_SCOPE("simulate");
+            timestep.update(simTime, [&](double dt) {
+                previousAngle = angle;
+                angle += spinSpeed * (float)dt;
+            });
+            float renderAngle = previousAngle + (angle - previousAngle) * timestep.alpha();
+            scene.setLocal(quadNode, glm::rotate(glm::mat4(1.0f), renderAngle, glm::vec3(0.3f, 0.7f, 1.0f)));
+            scene.update(jobs);
+        }
+
+        if (paced) {
+            pacer.beforeRender();
+            Profiler::gpuBegin("frame");
+            if (scaling) {
+                int fbWidth, fbHeight;
+                display.framebufferSize(fbWidth, fbHeight);
+                dynamicRes.beginScene(fbWidth, fbHeight);
+            }
+            if (useGraph) {
+                int fbWidth, fbHeight;
+                display.framebufferSize(fbWidth, fbHeight);
+                if (fbWidth != graphWidth || fbHeight != graphHeight) buildGraph(fbWidth, fbHeight);
+                // Runs up to the scene pass and binds its target
+                graph.execute();
+            }
+
+            // render some colors
+            glClearColor(0.2f, 0.3f, 0.5f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            shader.activate();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture1);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, texture2);
+            shader.setMat4("transform", scene.world(quadNode));
+        }
+
+
+        if (renderThread.running()) {
+            // Only simulation here: the render thread is drawing the previous packet meanwhile
+            FramePacket& packet = renderThread.beginFrame();
+            double start = display.time();
+            display.framebufferSize(packet.framebufferWidth, packet.framebufferHeight);
+            packet.quadTransform = scene.world(quadNode);
+            if (options.stressCount > 0) {
+                buildStressScene(packet.instances, options.stressCount, (float)simTime, jobs);
+            }
+            renderThread.submitFrame();
+            updateTime += display.time() - start;
+            ++cpuFrames;
+            if (report) {
+                RenderThreadStats stats = renderThread.takeStats();
+                int drawn = std::max(1, stats.frames);
+                if (options.stressCount > 0) std::cout << "instanced: " << options.stressCount << " quads, ";
+                std::cout << "render thread: submit " << stats.submitTime * 1000.0 / drawn << " ms, swap "
+                          << stats.swapTime * 1000.0 / drawn << " ms per frame, main waited "
+                          << stats.waitTime * 1000.0 / cpuFrames << " ms per frame, ";
+            }
+        }
+        else if (options.stressCount > 0) {
+            double start = display.time();
+            buildStressScene(instances, options.stressCount, (float)simTime, jobs);
+            double submitStart = display.time();
+            {
+                PROFILE_SCOPE("submit");
+                GPU_PROFILE_SCOPE("stress quads");
+                if (options.naive) {
+                    glBindVertexArray(VAO);
+                    for (size_t i = 0; i < instances.size(); ++i) {
+                        shader.setMat4("transform", instances[i].transform);
+                        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                    }
+                }
+                else {
+                    instancedShader->activate();
+                    instanced.draw(instances);
+                }
+            }
+            updateTime += submitStart - start;
+            submitTime += display.time() - submitStart;
+            ++cpuFrames;
+            if (report) {
+                std::cout << (options.naive ? "naive" : "instanced") << ": " << options.stressCount << " quads, ";
+            }
+        }
+        else if (options.spriteCount > 0) {
+            int fbWidth, fbHeight;
+            display.framebufferSize(fbWidth, fbHeight);
+            glm::mat4 projection = glm::ortho(0.0f, (float)fbWidth, 0.0f, (float)fbHeight, -1.0f, 1.0f);
+            float time = (float)simTime;
+
+            double start = display.time();
+            // Full batches get flushed while sprites are added, so this covers the whole loop
+            GPU_PROFILE_SCOPE("sprites");
+            spriteBatch.begin();
+            for (int i = 0; i < options.spriteCount; ++i) {
+                // Every sprite wanders around its own lissajous path
+                float phase = i * 0.618f;
+                glm::vec2 position(fbWidth * (0.5f + 0.45f * std::sin(time * 0.3f + phase * 1.3f)),
+                                   fbHeight * (0.5f + 0.45f * std::cos(time * 0.4f + phase * 0.7f)));
+                spriteBatch.draw(spriteShader->id, (i % 2) ? texture2 : texture1, position, glm::vec2(24.0f),
+                                 time + phase);
+            }
+            double submitStart = display.time();
+            spriteBatch.end(projection);
+            updateTime += submitStart - start;
+            submitTime += display.time() - submitStart;
+            ++cpuFrames;
+            if (report) {
+                const SpriteBatchStats& stats = spriteBatch.stats();
+                std::cout << "sprites: " << stats.sprites << ", " << stats.flushes << " flushes, "
+                          << (double)stats.draws / stats.flushes << " draws and " << stats.vertices / stats.flushes
+                          << " vertices per flush, " << stats.stateChanges << " state changes, ";
+            }
+        }
+        else if (options.indirectCount > 0) {
+            double start = display.time();
+            buildStressScene(instances, options.indirectCount, (float)simTime, jobs);
+            indirect.begin();
+            if (options.cull) {
+                // Perspective camera flying low over the grid, so most objects are off screen
+                float time = (float)simTime;
+                int fbWidth, fbHeight;
+                display.framebufferSize(fbWidth, fbHeight);
+                Camera camera;
+                camera.position = glm::vec3(0.6f * std::sin(time * 0.2f), 0.6f * std::cos(time * 0.3f), 0.35f);
+                camera.target = camera.position - glm::vec3(0.0f, 0.0f, 1.0f);
+                camera.aspect = (float)fbWidth / fbHeight;
+                glm::mat4 viewProjection = camera.viewProjection();
+
+                bounds.clear();
+                for (size_t i = 0; i < instances.size(); ++i) {
+                    const glm::mat4& t = instances[i].transform;
+                    // shapes have radius 0.5, the scale sits in the matrix columns
+                    bounds.add(glm::vec3(t[3].x, t[3].y, t[3].z), 0.5f * glm::length(glm::vec3(t[0].x, t[0].y, t[0].z)));
+                }
+                double cullStart = display.time();
+                cullSpheres(Frustum::fromMatrix(viewProjection), bounds, visible, jobs);
+                cullTime += display.time() - cullStart;
+
+                for (size_t v = 0; v < visible.size(); ++v) {
+                    uint32_t i = visible[v];
+                    indirect.add(shapes[i % shapes.size()], viewProjection * instances[i].transform, instances[i].tint);
+                }
+            }
+            else {
+                for (size_t i = 0; i < instances.size(); ++i) {
+                    indirect.add(shapes[i % shapes.size()], instances[i].transform, instances[i].tint);
+                }
+            }
+            double submitStart = display.time();
+            {
+                PROFILE_SCOPE("submit");
+                GPU_PROFILE_SCOPE("indirect");
+                indirectShader->activate();
+                indirect.submit();
+            }
+            updateTime += submitStart - start;
+            submitTime += display.time() - submitStart;
+            ++cpuFrames;
+            if (report) {
+                std::cout << (indirect.usesMultiDraw() ? "multi-draw indirect" : "draw loop") << ": "
+                          << indirect.drawCount() << " draws, ";
+                if (options.cull) {
+                    std::cout << visible.size() << "/" << instances.size() << " visible, culling ("
+                              << cullPathName(CullPath::Auto) << ", " << jobs.threadCount() << " threads) "
+                              << cullTime * 1000.0 / cpuFrames << " ms, ";
+                    cullTime = 0.0;
+                }
+            }
+        }
+        else if (options.materialCount > 0) {
+            double start = display.time();
+            buildStressScene(instances, options.materialCount, (float)simTime, jobs);
+            renderQueue.clear();
+            for (size_t i = 0; i < instances.size(); ++i) {
+                // Scene order hops between materials all the time, like objects placed by hand
+                DrawCommand draw;
+                draw.material = (unsigned int)((i * 2654435761u) >> 8) % materialTextures.size();
+                draw.program = draw.material % 2 ? materialShader->id : shader.id;
+                draw.textures[0] = draw.material % 3 ? texture1 : texture2;
+                draw.textures[1] = materialTextures[draw.material];
+                draw.vao = VAO;
+                draw.indexCount = 6;
+                draw.translucent = draw.material % 8 == 7;
+                draw.transform = instances[i].transform;
+                renderQueue.add(draw, 0, (float)i / instances.size());
+            }
+            // The spinning quad goes on top in its own layer
+            DrawCommand quad;
+            quad.program = shader.id;
+            quad.textures[0] = texture1;
+            quad.textures[1] = texture2;
+            quad.vao = VAO;
+            quad.indexCount = 6;
+            quad.transform = scene.world(quadNode);
+            renderQueue.add(quad, 1);
+
+            size_t sceneOrderChanges = renderQueue.countStateChanges();
+            double sortStart = display.time();
+            if (!options.noSort) {
+                PROFILE_SCOPE("sort");
+                renderQueue.sort();
+            }
+            sortTime += display.time() - sortStart;
+
+            double submitStart = display.time();
+            {
+                PROFILE_SCOPE("submit");
+                GPU_PROFILE_SCOPE("materials");
+                // Everything above bound things behind the cache's back
+                stateCache.invalidate();
+                stateCache.resetStats();
+                renderQueue.submit(stateCache);
+                stateCache.setBlend(false);
+            }
+            updateTime += submitStart - start;
+            submitTime += display.time() - submitStart;
+            ++cpuFrames;
+            if (report) {
+                const GLStateStats& stats = stateCache.stats();
+                std::cout << "render queue: " << renderQueue.size() << " draws, " << sceneOrderChanges
+                          << " state changes in scene order, " << stats.changes() << " submitted "
+                          << (options.noSort ? "unsorted" : "sorted") << " (" << stats.programBinds << " program, "
+                          << stats.textureBinds << " texture, " << stats.blendChanges << " blend, "
+                          << stats.vertexArrayBinds << " VAO, " << stats.skipped << " redundant skipped), sort "
+                          << sortTime * 1000.0 / cpuFrames << " ms, ";
+                sortTime = 0.0;
+            }
+        }
+        else if (drawMesh) {
+            GPU_PROFILE_SCOPE("mesh");
+            mesh.draw();
+        }
+        else {
+            GPU_PROFILE_SCOPE("quad");
+            glBindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        }
+
+        const TimestepStats& ticks = timestep.stats();
+        if (options.tickStats && ticks.elapsed > 2.0) {
+            std::cout << "timestep: " << ticks.ticks / ticks.elapsed << " ticks/s, " << ticks.frames / ticks.elapsed
+                      << " frames/s, " << (double)ticks.ticks / ticks.frames << " ticks per frame (max "
+                      << ticks.maxTicksInFrame << "), " << ticks.tickCpuTime * 1000.0 / std::max(1, ticks.ticks)
+                      << " ms per tick, longest frame " << ticks.maxFrameTime * 1000.0 << " ms, "
+                      << ticks.droppedTime * 1000.0 << " ms dropped in " << ticks.cappedFrames << " frames" << std::endl;
+            timestep.resetStats();
+        }
+
+        if (report) {
+            // GPU times of the newest frame read back, with --profile (the render thread keeps its own)
+            const std::vector<GpuTiming>& gpu = Profiler::lastGpuFrame();
+            for (size_t i = 0; paced && i < gpu.size(); ++i) {
+                std::cout << (i ? ", " : "GPU ") << gpu[i].name << " " << gpu[i].ms << " ms" << (i + 1 == gpu.size() ? ", " : "");
+            }
+            if (paced && options.capture && readbackReady) {
+                ReadbackStats rb = readback.takeStats();
+                std::cout << "capture " << (readback.synchronous() ? "(sync) " : "") << rb.handled << "/" << rb.requested
+                          << " frames (" << rb.dropped << " dropped), " << rb.latencyFrames << " frames late, "
+                          << rb.requestMs << " ms on this thread, " << rb.handlerMs << " ms on the worker, ";
+            }
+            if (paced && options.glStats && GLTrace::installed()) {
+                const GLTraceFrame& gl = GLTrace::lastFrame();
+                std::cout << "GL " << gl.calls << " calls, " << gl.draws << " draws, " << gl.binds << " binds ("
+                          << gl.redundantBinds << " redundant), " << gl.uniformUploads << " uniforms, "
+                          << gl.bytesUploaded / 1024 << " KB uploaded, " << gl.driverMs << " ms in the driver, ";
+            }
+            if (scaling) {
+                DynamicResolutionStats res = dynamicRes.takeStats();
+                std::cout << "resolution " << res.scale * 100.0f << "% (" << res.sceneWidth << "x" << res.sceneHeight
+                          << "), scene " << res.gpuMs << " ms of " << options.dynamicResBudget << ", " << res.changes
+                          << " changes, ";
+            }
+            std::cout << cpuFrames / (display.time() - lastReport) << " frames/s, "
+                      << (updateTime + submitTime) * 1000.0 / cpuFrames << " ms CPU per frame (update "
+                      << updateTime * 1000.0 / cpuFrames << " ms, submit " << submitTime * 1000.0 / cpuFrames
+                      << " ms)" << std::endl;
+            updateTime = submitTime = 0.0;
+            cpuFrames = 0;
+            lastReport = display.time();
+        }
+
+        if (options.pacingStats && display.time() - lastPacingReport > 2.0) {
+            PacingStats stats = pacer.takeStats();
+            if (stats.frames > 0) {
+                std::cout << "pacing: " << 1.0 / stats.meanFrameTime << " frames/s, frame time "
+                          << stats.meanFrameTime * 1000.0 << " ms +- " << stats.frameTimeStdDev * 1000.0 << " (min "
+                          << stats.minFrameTime * 1000.0 << ", max " << stats.maxFrameTime * 1000.0 << "), input to GPU done "
+                          << stats.meanLatency * 1000.0 << " ms (max " << stats.maxLatency * 1000.0 << ", "
+                          << stats.latencySamples << " samples), limiter " << stats.limiterTime * 1000.0 / stats.frames
+                          << " ms, fence waits " << stats.fenceWaitTime * 1000.0 / stats.frames << " ms per frame" << std::endl;
+            }
+            lastPacingReport = display.time();
+        }
+
+        if (paced) {
+            if (scaling) dynamicRes.endScene(display.framebuffer());
+            if (useGraph) graph.execute();
+            if (readbackReady) {
+                int fbWidth, fbHeight;
+                display.framebufferSize(fbWidth, fbHeight);
+                bool screenshotKey = display.keyDown(GLFW_KEY_F12);
+                if (screenshotKey && !screenshotKeyDown) {
+                    std::string path = "screenshot-" + std::to_string(frame) + ".ppm";
+                    readback.request(display.framebuffer(), fbWidth, fbHeight, frame, [path](const ReadbackFrame& pixels) {
+                        if (writePPM(path.c_str(), pixels)) std::cout << "Wrote " << path << std::endl;
+                        else std::cout << "Failed to write the screenshot " << path << std::endl;
+                    });
+                }
+                screenshotKeyDown = screenshotKey;
+                if (options.capture) {
+                    // FNV-1a a word at a time plus the tail bytes, over every frame in order (the worker takes them in order)
+                    readback.request(display.framebuffer(), fbWidth, fbHeight, frame, [&](const ReadbackFrame& pixels) {
+                        size_t bytes = (size_t)pixels.width * pixels.height * 4, i = 0;
+                        uint64_t h = captureHash;
+                        for (; i + 8 <= bytes; i += 8) {
+                            uint64_t word;
+                            memcpy(&word, pixels.pixels + i, 8);
+                            h = (h ^ word) * 1099511628211ull;
+                        }
+                        for (; i < bytes; ++i) h = (h ^ pixels.pixels[i]) * 1099511628211ull;
+                        captureHash = h;
+                        ++capturedFrames;
+                    });
+                }
+                if (recording) {
+                    // Waits for a slot rather than dropping: a video with holes is no use
+                    readback.request(display.framebuffer(), fbWidth, fbHeight, frame, [&video](const ReadbackFrame& pixels) {
+                        video.addFrame(pixels);
+                    }, true);
+                }
+                readback.update();
+            }
+            if (bench) {
+                recorder.endFrame();
+                if (frame + 1 == options.frames) {
+                    std::vector<unsigned char> pixels;
+                    display.readPixels(pixels, false);
+                    benchResult.framebufferHash = hashBytes(pixels);
+                }
+            }
+            Profiler::gpuEnd();
+            Profiler::endFrame();
+            GLTrace::endFrame();
+            debugLog.endFrame();
+            {
+                PROFILE_SCOPE("swap");
+                display.swapBuffers();
+            }
+            pacer.endFrame();
+            if (!pacer.lowLatency()) display.pollEvents();
+        }
+        else {
+            display.pollEvents();
+        }
+        ++frame;
+        if (options.frames > 0 && frame >= options.frames) display.close();
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // Back on this thread for the cleanup
+    renderThread.stop();
+    if (!options.screenshotPath.empty() && display.saveScreenshot(options.screenshotPath.c_str())) {
+        std::cout << "Wrote the last frame to " << options.screenshotPath << std::endl;
+    }
+    if (!options.jobTracePath.empty() && jobs.writeTrace(options.jobTracePath.c_str())) {
+        std::cout << "Wrote the job trace to " << options.jobTracePath << std::endl;
+    }
+    if (Profiler::enabled() && Profiler::writeTrace(options.profilePath.c_str())) {
+        std::cout << "Wrote the profile to " << options.profilePath << std::endl;
+    }
+    if (readbackReady) {
+        readback.destroy();
+        if (options.capture) {
+            std::cout << "capture: " << capturedFrames << " frames, hash " << std::hex << captureHash << std::dec << std::endl;
+        }
+    }
+    if (recording) {
+        video.close();
+        double seconds = display.time() - recordStart;
+        VideoRecorderStats stats = video.stats();
+        std::cout << "record: " << stats.frames << " frames to " << options.recordPath << " ("
+                  << (video.y4m() ? "Y4M" : "raw RGBA") << ", " << stats.bytes / (1024 * 1024) << " MB), convert "
+                  << stats.convertMs << " ms/frame (" << (video.y4m() ? mathPathName(yuvConvertPath()) : "flip")
+                  << "), write " << stats.writeMs << " ms/frame, " << stats.stalls << " stalls, " << stats.outOfOrder
+                  << " out of order, " << stats.wrongSize << " wrong size, " << stats.frames / seconds << " frames/s"
+                  << std::endl;
+    }
+    if (options.glStats) GLTrace::printSummary(std::cout, 15);
+    if (debugLog.enabled()) {
+        size_t messages = debugLog.messageCount(), distinct = debugLog.distinctCount();
+        size_t performance = debugLog.performanceWarnings();
+        debugLog.destroy();
+        std::cout << "GL debug: " << messages << " messages (" << distinct << " distinct, " << performance
+                  << " performance warnings), wrote " << options.glDebugPath << std::endl;
+    }
+    if (bench) {
+        recorder.finish();
+        if (options.stressCount > 0) benchResult.scene = options.naive ? "stress naive" : "stress instanced";
+        else if (options.spriteCount > 0) benchResult.scene = "sprites";
+        else if (options.indirectCount > 0) benchResult.scene = options.cull ? "indirect culled" : "indirect";
+        else if (options.materialCount > 0) benchResult.scene = options.noSort ? "materials unsorted" : "materials";
+        else benchResult.scene = drawMesh ? "mesh" : "quad";
+        for (int i = 1; i < argc; ++i) benchResult.arguments += std::string(i > 1 ? " " : "") + argv[i];
+        benchResult.renderer = (const char*)glGetString(GL_RENDERER);
+        display.framebufferSize(benchResult.width, benchResult.height);
+        benchResult.simulatedFrameTime = kBenchFrameTime;
+        if (options.benchOutPath.empty()) {
+            recorder.writeJson(std::cout, benchResult);
+        }
+        else {
+            std::ofstream out(options.benchOutPath.c_str());
+            recorder.writeJson(out, benchResult);
+            Percentiles cpu = percentiles(recorder.cpuTimes()), gpu = percentiles(recorder.gpuTimes());
+            if (out) {
+                std::cout << "bench: " << recorder.cpuTimes().size() << " frames, CPU p50 " << cpu.p50 << " p95 " << cpu.p95 << " p99 "
+                          << cpu.p99 << " max " << cpu.max << " ms, GPU p50 " << gpu.p50 << " p95 " << gpu.p95 << " p99 "
+                          << gpu.p99 << " max " << gpu.max << " ms, wrote " << options.benchOutPath << std::endl;
+            }
+            else {
+                std::cout << "Failed to write the benchmark results to " << options.benchOutPath << std::endl;
+            }
+        }
     }
 
     // delete stuff
+    dynamicRes.destroy();
+    graph.destroy();
+    postChain.destroy();
+    if (postVAO) glDeleteVertexArrays(1, &postVAO);
+    pacer.destroy();
+    recorder.destroy();
+    Profiler::destroyGpu();
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glfwTerminate();
+    mesh.destroy();
+    instanced.destroy();
+    spriteBatch.destroy();
+    indirect.destroy();
+    if (!materialTextures.empty()) glDeleteTextures((GLsizei)materialTextures.size(), materialTextures.data());
+    display.destroy();
     return 0;
 }
 
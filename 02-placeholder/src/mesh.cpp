@@ -0,0 +1,997 @@
+#include "../include/utilities/mesh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include "../include/utilities/gl_debug.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MESH_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    if (s.size() < n) return false;
+    for (size_t i = 0; i < n; ++i) {
+        if (tolower((unsigned char)s[s.size() - n + i]) != suffix[i]) return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Streaming tokenizer. Everything works on [p, end) pointers into the mapped file: no
+// std::string per token, no istringstream, no locale lookups.
+
+inline void skipBlanks(const char*& p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+}
+
+inline void skipLine(const char*& p, const char* end) {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    p = nl ? nl + 1 : end;
+}
+
+inline bool parseInt(const char*& p, const char* end, int& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    if (p >= end || *p < '0' || *p > '9') return false;
+    int v = 0;
+    while (p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    out = negative ? -v : v;
+    return true;
+}
+
+// Good to ~7 significant digits, which is all a float holds anyway. Way faster than strtof.
+inline float parseFloat(const char*& p, const char* end) {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    double mantissa = 0.0;
+    while (p < end && *p >= '0' && *p <= '9') mantissa = mantissa * 10.0 + (*p++ - '0');
+    if (p < end && *p == '.') {
+        ++p;
+        double fraction = 0.0;
+        int digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 18) {
+                fraction = fraction * 10.0 + (*p - '0');
+                ++digits;
+            }
+            ++p;
+        }
+        mantissa += fraction / powers[digits];
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        int exponent = 0;
+        if (parseInt(p, end, exponent)) {
+            double scale = 1.0;
+            int e = exponent < 0 ? -exponent : exponent;
+            while (e >= 18) { scale *= 1e18; e -= 18; }
+            scale *= powers[e];
+            mantissa = exponent < 0 ? mantissa / scale : mantissa * scale;
+        }
+    }
+    return (float)(negative ? -mantissa : mantissa);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Hashed welder: open addressing table that only stores vertex ids, the keys themselves live
+// in a dense array next to the output vertices. Grows at 50% load.
+
+const unsigned int kEmptySlot = 0xFFFFFFFFu;
+
+template <typename Key, typename Hash>
+class Welder {
+public:
+    explicit Welder(size_t expected) {
+        size_t capacity = 1024;
+        while (capacity < expected * 2) capacity <<= 1;
+        slots.assign(capacity, kEmptySlot);
+        keys.reserve(expected);
+    }
+
+    // Returns the id of key, inserting it if it's new
+    unsigned int insert(const Key& key, bool& inserted) {
+        if ((keys.size() + 1) * 2 > slots.size()) grow();
+        size_t mask = slots.size() - 1;
+        size_t i = Hash()(key) & mask;
+        while (true) {
+            unsigned int id = slots[i];
+            if (id == kEmptySlot) {
+                id = (unsigned int)keys.size();
+                slots[i] = id;
+                keys.push_back(key);
+                inserted = true;
+                return id;
+            }
+            if (memcmp(&keys[id], &key, sizeof(Key)) == 0) {
+                inserted = false;
+                return id;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+    size_t size() const { return keys.size(); }
+
+private:
+    void grow() {
+        std::vector<unsigned int> bigger(slots.size() * 2, kEmptySlot);
+        size_t mask = bigger.size() - 1;
+        for (unsigned int id = 0; id < keys.size(); ++id) {
+            size_t i = Hash()(keys[id]) & mask;
+            while (bigger[i] != kEmptySlot) i = (i + 1) & mask;
+            bigger[i] = id;
+        }
+        slots.swap(bigger);
+    }
+
+    std::vector<unsigned int> slots;
+    std::vector<Key> keys;
+};
+
+inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+struct CornerKey {
+    int p, t, n;
+};
+
+struct CornerHash {
+    size_t operator()(const CornerKey& k) const {
+        return (size_t)mix64(((uint64_t)(uint32_t)k.p << 32) ^ ((uint64_t)(uint32_t)k.t << 16) ^ (uint32_t)k.n);
+    }
+};
+
+struct VertexHash {
+    size_t operator()(const Vertex& v) const {
+        uint32_t words[8];
+        memcpy(words, &v, sizeof(words));
+        uint64_t h = 0x9E3779B97F4A7C15ULL;
+        for (int i = 0; i < 8; ++i) h = mix64(h ^ words[i]);
+        return (size_t)h;
+    }
+};
+
+// Merges bit-identical vertices and rewrites the index buffer accordingly
+void weldVertices(MeshData& mesh) {
+    Welder<Vertex, VertexHash> welder(mesh.vertices.size());
+    std::vector<Vertex> unique;
+    unique.reserve(mesh.vertices.size());
+    std::vector<unsigned int> remap(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        bool inserted;
+        remap[i] = welder.insert(mesh.vertices[i], inserted);
+        if (inserted) unique.push_back(mesh.vertices[i]);
+    }
+    for (size_t i = 0; i < mesh.indices.size(); ++i) mesh.indices[i] = remap[mesh.indices[i]];
+    mesh.vertices.swap(unique);
+}
+
+// ---------------------------------------------------------------------------------------------
+// OBJ. The file is split in line-aligned chunks, one per worker. Since OBJ indices are global
+// (or relative to the current count), each chunk stores them encoded and they're resolved once
+// every chunk knows how many v/vt/vn came before it.
+
+const int kMissing = INT_MIN;
+// Relative indices are stored biased into the negative range, so they can still point to
+// an earlier chunk (rel < 0) and be told apart from the absolute ones
+const int kRelativeBias = INT_MIN + 1 + (1 << 29);
+
+struct ObjChunk {
+    std::vector<float> positions, texCoords, normals;
+    std::vector<int> corners; // (p, t, n) triplets, already fan-triangulated
+};
+
+inline int encodeIndex(int idx, size_t localCount) {
+    if (idx > 0) return idx - 1;
+    if (idx < 0) return kRelativeBias + ((int)localCount + idx);
+    return kMissing;
+}
+
+inline int decodeIndex(int encoded, size_t base) {
+    if (encoded == kMissing || encoded >= 0) return encoded;
+    return (int)base + (encoded - kRelativeBias);
+}
+
+void parseObjChunk(const char* p, const char* end, ObjChunk& chunk) {
+    std::vector<int> face; // (p, t, n) per corner, reused so big polygons don't allocate per face
+    while (p < end) {
+        skipBlanks(p, end);
+        if (p >= end) break;
+        if (p[0] == 'v' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            for (int i = 0; i < 3; ++i) {
+                skipBlanks(p, end);
+                chunk.positions.push_back(parseFloat(p, end));
+            }
+        }
+        else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 3;
+            for (int i = 0; i < 2; ++i) {
+                skipBlanks(p, end);
+                chunk.texCoords.push_back(parseFloat(p, end));
+            }
+        }
+        else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 3;
+            for (int i = 0; i < 3; ++i) {
+                skipBlanks(p, end);
+                chunk.normals.push_back(parseFloat(p, end));
+            }
+        }
+        else if (p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            face.clear();
+            int count = 0;
+            for (;;) {
+                skipBlanks(p, end);
+                int v, t = 0, n = 0;
+                if (!parseInt(p, end, v)) break;
+                if (p < end && *p == '/') {
+                    ++p;
+                    if (p < end && *p != '/') parseInt(p, end, t);
+                    if (p < end && *p == '/') {
+                        ++p;
+                        parseInt(p, end, n);
+                    }
+                }
+                face.push_back(encodeIndex(v, chunk.positions.size() / 3));
+                face.push_back(encodeIndex(t, chunk.texCoords.size() / 2));
+                face.push_back(encodeIndex(n, chunk.normals.size() / 3));
+                ++count;
+            }
+            // Polygons become a fan around the first corner
+            const int* corners = face.data();
+            for (int i = 1; i + 1 < count; ++i) {
+                chunk.corners.insert(chunk.corners.end(), corners, corners + 3);
+                chunk.corners.insert(chunk.corners.end(), corners + i * 3, corners + i * 3 + 3);
+                chunk.corners.insert(chunk.corners.end(), corners + (i + 1) * 3, corners + (i + 1) * 3 + 3);
+            }
+        }
+        // comments, o/g/s/usemtl/mtllib... are ignored for now
+        skipLine(p, end);
+    }
+}
+
+template <typename Fn>
+void runWorkers(unsigned int count, Fn fn) {
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < count; ++i) workers.push_back(std::thread(fn, i));
+    fn(0u);
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Just enough JSON to read a glTF header. The JSON part is tiny next to the binary buffers,
+// so a plain DOM is fine here.
+
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    double number = 0.0;
+    bool boolean = false;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue> > object;
+
+    const JsonValue* get(const char* key) const {
+        for (size_t i = 0; i < object.size(); ++i) {
+            if (object[i].first == key) return &object[i].second;
+        }
+        return nullptr;
+    }
+    const JsonValue* at(size_t i) const { return i < array.size() ? &array[i] : nullptr; }
+    double numberOr(const char* key, double fallback) const {
+        const JsonValue* v = get(key);
+        return (v && v->type == Number) ? v->number : fallback;
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+    bool parse(JsonValue& out) {
+        return value(out);
+    }
+
+private:
+    const char* p;
+    const char* end;
+
+    void ws() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+
+    bool literal(const char* word) {
+        size_t n = strlen(word);
+        if ((size_t)(end - p) < n || strncmp(p, word, n) != 0) return false;
+        p += n;
+        return true;
+    }
+
+    bool str(std::string& out) {
+        if (p >= end || *p != '"') return false;
+        ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\' && p + 1 < end) {
+                ++p;
+                switch (*p) {
+                    case 'n': out += '\n'; break;
+                    case 't': out += '\t'; break;
+                    case 'r': out += '\r'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'u': out += '?'; p += 4; break; // names we care about are plain ASCII
+                    default: out += *p; break;
+                }
+                ++p;
+            }
+            else {
+                out += *p++;
+            }
+        }
+        if (p >= end) return false;
+        ++p;
+        return true;
+    }
+
+    bool value(JsonValue& out) {
+        ws();
+        if (p >= end) return false;
+        if (*p == '{') {
+            ++p;
+            out.type = JsonValue::Object;
+            ws();
+            if (p < end && *p == '}') { ++p; return true; }
+            while (true) {
+                ws();
+                std::pair<std::string, JsonValue> member;
+                if (!str(member.first)) return false;
+                ws();
+                if (p >= end || *p != ':') return false;
+                ++p;
+                if (!value(member.second)) return false;
+                out.object.push_back(std::move(member));
+                ws();
+                if (p < end && *p == ',') { ++p; continue; }
+                if (p < end && *p == '}') { ++p; return true; }
+                return false;
+            }
+        }
+        if (*p == '[') {
+            ++p;
+            out.type = JsonValue::Array;
+            ws();
+            if (p < end && *p == ']') { ++p; return true; }
+            while (true) {
+                out.array.push_back(JsonValue());
+                if (!value(out.array.back())) return false;
+                ws();
+                if (p < end && *p == ',') { ++p; continue; }
+                if (p < end && *p == ']') { ++p; return true; }
+                return false;
+            }
+        }
+        if (*p == '"') {
+            out.type = JsonValue::String;
+            return str(out.string);
+        }
+        if (literal("true")) { out.type = JsonValue::Bool; out.boolean = true; return true; }
+        if (literal("false")) { out.type = JsonValue::Bool; out.boolean = false; return true; }
+        if (literal("null")) { out.type = JsonValue::Null; return true; }
+
+        // strtod wants a terminated string and the GLB chunk isn't one: copy the number out first
+        char number[64];
+        size_t length = 0;
+        while (p + length < end && length + 1 < sizeof(number) && strchr("+-.0123456789eE", p[length]) && p[length]) {
+            number[length] = p[length];
+            ++length;
+        }
+        number[length] = '\0';
+        char* numberEnd = nullptr;
+        out.type = JsonValue::Number;
+        out.number = strtod(number, &numberEnd);
+        if (numberEnd == number) return false;
+        p += numberEnd - number;
+        return true;
+    }
+};
+
+bool readWholeFile(const std::string& path, std::vector<char>& out) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to open file " << path << std::endl;
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    out.resize((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(out.data(), out.size());
+    return true;
+}
+
+bool decodeBase64(const char* p, const char* end, std::vector<char>& out) {
+    static int table[256];
+    static bool init = false;
+    if (!init) {
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 256; ++i) table[i] = -1;
+        for (int i = 0; i < 64; ++i) table[(unsigned char)alphabet[i]] = i;
+        init = true;
+    }
+    unsigned int acc = 0;
+    int bits = 0;
+    for (; p < end && *p != '='; ++p) {
+        int v = table[(unsigned char)*p];
+        if (v < 0) return false;
+        acc = (acc << 6) | (unsigned int)v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((char)((acc >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+struct GltfAccessor {
+    const char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+};
+
+int componentsOf(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+size_t componentSize(int componentType) {
+    switch (componentType) {
+        case 5120: case 5121: return 1; // (unsigned) byte
+        case 5122: case 5123: return 2; // (unsigned) short
+        case 5125: case 5126: return 4; // unsigned int, float
+        default: return 0;
+    }
+}
+
+bool resolveAccessor(const JsonValue& root, const std::vector<std::vector<char> >& buffers, int index, GltfAccessor& out) {
+    const JsonValue* accessors = root.get("accessors");
+    const JsonValue* views = root.get("bufferViews");
+    const JsonValue* accessor = accessors ? accessors->at(index) : nullptr;
+    if (!accessor || !views) return false;
+    const JsonValue* viewIndex = accessor->get("bufferView");
+    const JsonValue* type = accessor->get("type");
+    if (!viewIndex || !type) return false; // sparse-only accessors aren't supported
+    const JsonValue* view = views->at((size_t)viewIndex->number);
+    if (!view) return false;
+
+    size_t buffer = (size_t)view->numberOr("buffer", 0);
+    if (buffer >= buffers.size()) return false;
+
+    out.componentType = (int)accessor->numberOr("componentType", 0);
+    out.components = componentsOf(type->string);
+    out.count = (size_t)accessor->numberOr("count", 0);
+    size_t elementSize = componentSize(out.componentType) * out.components;
+    out.stride = (size_t)view->numberOr("byteStride", 0);
+    if (out.stride == 0) out.stride = elementSize;
+
+    size_t offset = (size_t)view->numberOr("byteOffset", 0) + (size_t)accessor->numberOr("byteOffset", 0);
+    if (elementSize == 0 || (out.count > 0 && offset + (out.count - 1) * out.stride + elementSize > buffers[buffer].size())) {
+        return false;
+    }
+    out.data = buffers[buffer].data() + offset;
+    return true;
+}
+
+// Decodes one triangle primitive into its own MeshData (the workers run this in parallel)
+bool decodePrimitive(const JsonValue& root, const std::vector<std::vector<char> >& buffers,
+                     const JsonValue& primitive, MeshData& out) {
+    if (primitive.numberOr("mode", 4) != 4) return true; // only triangle lists, skip the rest
+    const JsonValue* attributes = primitive.get("attributes");
+    const JsonValue* position = attributes ? attributes->get("POSITION") : nullptr;
+    if (!position) return false;
+
+    GltfAccessor pos, nrm, uv;
+    if (!resolveAccessor(root, buffers, (int)position->number, pos) || pos.componentType != 5126 || pos.components != 3) {
+        return false;
+    }
+    const JsonValue* normal = attributes->get("NORMAL");
+    bool hasNormal = normal && resolveAccessor(root, buffers, (int)normal->number, nrm) &&
+                     nrm.componentType == 5126 && nrm.count == pos.count;
+    const JsonValue* texCoord = attributes->get("TEXCOORD_0");
+    bool hasUV = texCoord && resolveAccessor(root, buffers, (int)texCoord->number, uv) &&
+                 uv.componentType == 5126 && uv.count == pos.count;
+
+    out.vertices.resize(pos.count);
+    for (size_t i = 0; i < pos.count; ++i) {
+        Vertex& v = out.vertices[i];
+        memcpy(v.position, pos.data + i * pos.stride, sizeof(v.position));
+        if (hasNormal) memcpy(v.normal, nrm.data + i * nrm.stride, sizeof(v.normal));
+        else v.normal[0] = v.normal[1] = v.normal[2] = 0.0f;
+        if (hasUV) memcpy(v.texCoord, uv.data + i * uv.stride, sizeof(v.texCoord));
+        else v.texCoord[0] = v.texCoord[1] = 0.0f;
+    }
+
+    const JsonValue* indices = primitive.get("indices");
+    if (!indices) {
+        out.indices.resize(pos.count);
+        for (size_t i = 0; i < pos.count; ++i) out.indices[i] = (unsigned int)i;
+        return true;
+    }
+    GltfAccessor idx;
+    if (!resolveAccessor(root, buffers, (int)indices->number, idx)) return false;
+    out.indices.resize(idx.count);
+    for (size_t i = 0; i < idx.count; ++i) {
+        const char* src = idx.data + i * idx.stride;
+        unsigned int value;
+        if (idx.componentType == 5121) value = *(const uint8_t*)src;
+        else if (idx.componentType == 5123) { uint16_t s; memcpy(&s, src, 2); value = s; }
+        else if (idx.componentType == 5125) memcpy(&value, src, 4);
+        else return false;
+        if (value >= pos.count) return false;
+        out.indices[i] = value;
+    }
+    return true;
+}
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+};
+
+const uint32_t kCacheVersion = 1;
+
+bool statFile(const char* path, uint64_t& size, int64_t& mtime) {
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+    size = (uint64_t)info.st_size;
+    mtime = (int64_t)info.st_mtime;
+    return true;
+}
+
+bool validHeader(const char* data, size_t size, CacheHeader& header) {
+    if (size < sizeof(CacheHeader)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "OGLM", 4) != 0 || header.version != kCacheVersion) return false;
+    // One section at a time against what's left, so corrupt counts can't wrap the sum
+    size_t left = size - sizeof(CacheHeader);
+    if (header.vertexCount > left / sizeof(Vertex)) return false;
+    left -= (size_t)header.vertexCount * sizeof(Vertex);
+    return header.indexCount <= left / sizeof(unsigned int);
+}
+
+} // namespace
+
+// =============================================================================================
+
+MeshData makePolygonMesh(int sides) {
+    MeshData mesh;
+    Vertex center = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.5f, 0.5f}};
+    mesh.vertices.push_back(center);
+    for (int i = 0; i < sides; ++i) {
+        float angle = 6.2831853f * i / sides;
+        Vertex v = {{0.5f * std::cos(angle), 0.5f * std::sin(angle), 0.0f}, {0.0f, 0.0f, 1.0f},
+                    {0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle)}};
+        mesh.vertices.push_back(v);
+        mesh.indices.push_back(0);
+        mesh.indices.push_back(1 + i);
+        mesh.indices.push_back(1 + (i + 1) % sides);
+    }
+    return mesh;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char* path) {
+    close();
+#ifdef MESH_HAS_MMAP
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (mapped == MAP_FAILED) return false;
+    madvise(mapped, (size_t)info.st_size, MADV_SEQUENTIAL);
+    ptr = (const char*)mapped;
+    length = (size_t)info.st_size;
+    return true;
+#else
+    if (!readWholeFile(path, fallback) || fallback.empty()) return false;
+    ptr = fallback.data();
+    length = fallback.size();
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef MESH_HAS_MMAP
+    if (ptr) munmap((void*)ptr, length);
+#endif
+    fallback.clear();
+    ptr = nullptr;
+    length = 0;
+}
+
+// =============================================================================================
+
+MeshLoader::MeshLoader(unsigned int threads) : threads(threads) {
+    if (this->threads == 0) this->threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::string MeshLoader::cachePath(const char* sourcePath) {
+    return std::string(sourcePath) + ".meshcache";
+}
+
+bool MeshLoader::load(const char* path, MeshData& out) {
+    std::string cache = cachePath(path);
+    if (isCacheValid(cache.c_str(), path)) {
+        Clock::time_point start = Clock::now();
+        if (readCache(cache.c_str(), out)) {
+            stats = MeshLoadStats();
+            stats.fromCache = true;
+            stats.readMs = msSince(start);
+            stats.vertices = out.vertices.size();
+            stats.triangles = out.indices.size() / 3;
+            return true;
+        }
+    }
+
+    std::string name(path);
+    bool ok;
+    if (endsWith(name, ".obj")) ok = loadOBJ(path, out);
+    else if (endsWith(name, ".gltf") || endsWith(name, ".glb")) ok = loadGLTF(path, out);
+    else {
+        std::cout << "Unknown mesh format " << path << std::endl;
+        return false;
+    }
+
+    if (ok && !writeCache(cache.c_str(), path, out)) {
+        std::cout << "Failed to write mesh cache " << cache << std::endl;
+    }
+    return ok;
+}
+
+bool MeshLoader::loadOBJ(const char* path, MeshData& out) {
+    stats = MeshLoadStats();
+    Clock::time_point start = Clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cout << "Failed to open file " << path << std::endl;
+        return false;
+    }
+    stats.readMs = msSince(start);
+
+    // Line-aligned chunks, small files just get one
+    start = Clock::now();
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    unsigned int chunkCount = (unsigned int)std::min<size_t>(threads, file.size() / (64 * 1024) + 1);
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds[0] = begin;
+    for (unsigned int i = 1; i < chunkCount; ++i) {
+        const char* p = std::max(bounds[i - 1], begin + file.size() / chunkCount * i);
+        skipLine(p, end);
+        bounds[i] = p;
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    runWorkers(chunkCount, [&](unsigned int i) {
+        parseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+    });
+    stats.parseMs = msSince(start);
+
+    // Stitch the attribute arrays together and weld (p, t, n) corners into unique vertices
+    start = Clock::now();
+    std::vector<float> positions, texCoords, normals;
+    std::vector<size_t> posBase(chunkCount), uvBase(chunkCount), nrmBase(chunkCount);
+    size_t corners = 0;
+    for (unsigned int i = 0; i < chunkCount; ++i) {
+        posBase[i] = positions.size() / 3;
+        uvBase[i] = texCoords.size() / 2;
+        nrmBase[i] = normals.size() / 3;
+        positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+        texCoords.insert(texCoords.end(), chunks[i].texCoords.begin(), chunks[i].texCoords.end());
+        normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+        std::vector<float>().swap(chunks[i].positions);
+        std::vector<float>().swap(chunks[i].texCoords);
+        std::vector<float>().swap(chunks[i].normals);
+        corners += chunks[i].corners.size() / 3;
+    }
+    const int positionCount = (int)(positions.size() / 3);
+    const int uvCount = (int)(texCoords.size() / 2);
+    const int normalCount = (int)(normals.size() / 3);
+
+    out.vertices.clear();
+    out.indices.clear();
+    out.indices.reserve(corners);
+    out.vertices.reserve(positionCount);
+    Welder<CornerKey, CornerHash> welder(positionCount);
+    for (unsigned int c = 0; c < chunkCount; ++c) {
+        const std::vector<int>& list = chunks[c].corners;
+        for (size_t i = 0; i < list.size(); i += 3) {
+            CornerKey key;
+            key.p = decodeIndex(list[i], posBase[c]);
+            key.t = decodeIndex(list[i + 1], uvBase[c]);
+            key.n = decodeIndex(list[i + 2], nrmBase[c]);
+            if (key.p < 0 || key.p >= positionCount) {
+                std::cout << "Invalid vertex index in " << path << std::endl;
+                return false;
+            }
+            if (key.t < 0 || key.t >= uvCount) key.t = kMissing;
+            if (key.n < 0 || key.n >= normalCount) key.n = kMissing;
+
+            bool inserted;
+            unsigned int id = welder.insert(key, inserted);
+            if (inserted) {
+                Vertex v;
+                memcpy(v.position, &positions[key.p * 3], sizeof(v.position));
+                if (key.n != kMissing) memcpy(v.normal, &normals[key.n * 3], sizeof(v.normal));
+                else v.normal[0] = v.normal[1] = v.normal[2] = 0.0f;
+                if (key.t != kMissing) memcpy(v.texCoord, &texCoords[key.t * 2], sizeof(v.texCoord));
+                else v.texCoord[0] = v.texCoord[1] = 0.0f;
+                out.vertices.push_back(v);
+            }
+            out.indices.push_back(id);
+        }
+    }
+    stats.weldMs = msSince(start);
+    stats.corners = corners;
+    stats.vertices = out.vertices.size();
+    stats.triangles = out.indices.size() / 3;
+    return true;
+}
+
+bool MeshLoader::loadGLTF(const char* path, MeshData& out) {
+    stats = MeshLoadStats();
+    Clock::time_point start = Clock::now();
+    std::vector<char> file;
+    if (!readWholeFile(path, file)) return false;
+
+    const char* jsonBegin = file.data();
+    const char* jsonEnd = file.data() + file.size();
+    std::vector<std::vector<char> > buffers;
+    bool binary = file.size() >= 4 && memcmp(file.data(), "glTF", 4) == 0;
+    std::vector<char> glbBuffer;
+    if (binary) {
+        // GLB: 12 byte header, then a JSON chunk (8 byte header: length, "JSON") and an optional BIN chunk
+        uint32_t jsonLength, binLength = 0;
+        if (file.size() < 20 || memcmp(file.data() + 16, "JSON", 4) != 0) {
+            std::cout << "Failed to read GLB " << path << ": no JSON chunk" << std::endl;
+            return false;
+        }
+        memcpy(&jsonLength, file.data() + 12, 4);
+        if (jsonLength > file.size() - 20) {
+            std::cout << "Failed to read GLB " << path << ": truncated JSON chunk" << std::endl;
+            return false;
+        }
+        jsonBegin = file.data() + 20;
+        jsonEnd = jsonBegin + jsonLength;
+        // Only a BIN chunk is the buffer, anything else after the JSON is ignored
+        if (jsonEnd + 8 <= file.data() + file.size() && memcmp(jsonEnd + 4, "BIN\0", 4) == 0) {
+            memcpy(&binLength, jsonEnd, 4);
+            if (binLength <= (size_t)(file.data() + file.size() - (jsonEnd + 8))) {
+                glbBuffer.assign(jsonEnd + 8, jsonEnd + 8 + binLength);
+            }
+        }
+    }
+
+    JsonValue root;
+    JsonParser parser(jsonBegin, jsonEnd);
+    if (!parser.parse(root) || root.type != JsonValue::Object) {
+        std::cout << "Failed to parse glTF json " << path << std::endl;
+        return false;
+    }
+
+    std::string directory(path);
+    size_t slash = directory.find_last_of("/\\");
+    directory = (slash == std::string::npos) ? std::string() : directory.substr(0, slash + 1);
+
+    const JsonValue* bufferList = root.get("buffers");
+    for (size_t i = 0; bufferList && i < bufferList->array.size(); ++i) {
+        const JsonValue* uri = bufferList->array[i].get("uri");
+        buffers.push_back(std::vector<char>());
+        if (!uri) {
+            buffers.back().swap(glbBuffer);
+        }
+        else if (uri->string.compare(0, 5, "data:") == 0) {
+            size_t comma = uri->string.find(',');
+            if (comma == std::string::npos ||
+                !decodeBase64(uri->string.c_str() + comma + 1, uri->string.c_str() + uri->string.size(), buffers.back())) {
+                std::cout << "Bad data uri in " << path << std::endl;
+                return false;
+            }
+        }
+        else if (!readWholeFile(directory + uri->string, buffers.back())) {
+            return false;
+        }
+    }
+    stats.readMs = msSince(start);
+
+    // Every primitive of every mesh, node transforms are not applied
+    start = Clock::now();
+    std::vector<const JsonValue*> primitives;
+    const JsonValue* meshes = root.get("meshes");
+    for (size_t m = 0; meshes && m < meshes->array.size(); ++m) {
+        const JsonValue* list = meshes->array[m].get("primitives");
+        for (size_t p = 0; list && p < list->array.size(); ++p) primitives.push_back(&list->array[p]);
+    }
+
+    std::vector<MeshData> parts(primitives.size());
+    std::vector<char> partOk(primitives.size(), 0);
+    std::atomic<size_t> next(0);
+    runWorkers(std::min<unsigned int>(threads, (unsigned int)std::max<size_t>(1, primitives.size())), [&](unsigned int) {
+        for (size_t i = next++; i < primitives.size(); i = next++) {
+            partOk[i] = decodePrimitive(root, buffers, *primitives[i], parts[i]) ? 1 : 0;
+        }
+    });
+    stats.parseMs = msSince(start);
+
+    start = Clock::now();
+    out.vertices.clear();
+    out.indices.clear();
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (!partOk[i]) {
+            std::cout << "Unsupported glTF primitive in " << path << std::endl;
+            return false;
+        }
+        unsigned int base = (unsigned int)out.vertices.size();
+        out.vertices.insert(out.vertices.end(), parts[i].vertices.begin(), parts[i].vertices.end());
+        for (size_t j = 0; j < parts[i].indices.size(); ++j) out.indices.push_back(parts[i].indices[j] + base);
+    }
+    stats.corners = out.vertices.size();
+    weldVertices(out);
+    stats.weldMs = msSince(start);
+    stats.vertices = out.vertices.size();
+    stats.triangles = out.indices.size() / 3;
+    return true;
+}
+
+bool MeshLoader::writeCache(const char* cachePath, const char* sourcePath, const MeshData& mesh) {
+    CacheHeader header;
+    memcpy(header.magic, "OGLM", 4);
+    header.version = kCacheVersion;
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    if (!statFile(sourcePath, header.sourceSize, header.sourceMtime)) return false;
+
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    // Big unformatted writes, one per array
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+    file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    return (bool)file;
+}
+
+bool MeshLoader::isCacheValid(const char* cachePath, const char* sourcePath) {
+    std::ifstream file(cachePath, std::ios::binary);
+    CacheHeader header;
+    if (!file.is_open() || !file.read((char*)&header, sizeof(header))) return false;
+    if (memcmp(header.magic, "OGLM", 4) != 0 || header.version != kCacheVersion) return false;
+    uint64_t size;
+    int64_t mtime;
+    if (!statFile(sourcePath, size, mtime)) return true; // source gone, the cache is all we have
+    return size == header.sourceSize && mtime == header.sourceMtime;
+}
+
+bool MeshLoader::readCache(const char* cachePath, MeshData& out) {
+    MappedFile file;
+    CacheHeader header;
+    if (!file.open(cachePath) || !validHeader(file.data(), file.size(), header)) return false;
+    const Vertex* vertices = (const Vertex*)(file.data() + sizeof(CacheHeader));
+    const unsigned int* indices = (const unsigned int*)(vertices + header.vertexCount);
+    out.vertices.assign(vertices, vertices + header.vertexCount);
+    out.indices.assign(indices, indices + header.indexCount);
+    return true;
+}
+
+// =============================================================================================
+
+Mesh::~Mesh() {
+    destroy();
+}
+
+void Mesh::destroy() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+    indexCount = 0;
+}
+
+void Mesh::setup(const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes) {
+    if (!VAO) {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+    }
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    GLDebugLog::label(GL_VERTEX_ARRAY, VAO, "mesh");
+    GLDebugLog::label(GL_BUFFER, VBO, "mesh vertices");
+    GLDebugLog::label(GL_BUFFER, EBO, "mesh indices");
+    indexCount = (GLsizei)(indexBytes / sizeof(unsigned int));
+}
+
+void Mesh::upload(const MeshData& mesh) {
+    setup(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex),
+          mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+}
+
+bool Mesh::uploadFromCache(const char* cachePath) {
+    MappedFile file;
+    CacheHeader header;
+    if (!file.open(cachePath) || !validHeader(file.data(), file.size(), header)) return false;
+    const char* vertices = file.data() + sizeof(CacheHeader);
+    const char* indices = vertices + header.vertexCount * sizeof(Vertex);
+    setup(vertices, header.vertexCount * sizeof(Vertex), indices, header.indexCount * sizeof(unsigned int));
+    return true;
+}
+
+void Mesh::draw() const {
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+}
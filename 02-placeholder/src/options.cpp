@@ -0,0 +1,195 @@
+#include "../include/utilities/options.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --mesh <file>   load an .obj/.gltf/.glb and draw it instead of the quad\n"
+              << "  --stress <n>    draw n textured quads per frame (instanced) and print CPU time per frame\n"
+              << "  --naive         with --stress, one draw call per quad like the plain render loop\n"
+              << "  --sprites <n>   draw n moving sprites through the sprite batcher and print draws/flush\n"
+              << "  --indirect <n>  draw n objects from a CPU-built indirect command buffer\n"
+              << "  --no-mdi        with --indirect, replay the commands in a loop instead of one multi-draw\n"
+              << "  --cull          with --indirect, fly a camera over the scene and frustum cull before drawing\n"
+              << "  --materials <n> draw n quads over 64 materials through the sorted render queue\n"
+              << "  --no-sort       with --materials, submit in scene order to compare state changes\n"
+              << "  --tick-rate <n> simulation ticks per second (default 60)\n"
+              << "  --max-ticks <n> most simulation ticks per frame when catching up (default 5)\n"
+              << "  --tick-stats    print tick and frame timing every couple of seconds\n"
+              << "  --swap-interval <n> glfwSwapInterval (0 off, 1 vsync, -1 adaptive), default: the driver's\n"
+              << "  --fps <n>       limit the frame rate (sleep, then spin to the deadline)\n"
+              << "  --frames-in-flight <n> let the GPU fall at most n frames behind (fences)\n"
+              << "  --low-latency   wait before reading input instead of after the swap\n"
+              << "  --pacing-stats  print frame time variance and input latency every couple of seconds\n"
+              << "  --job-trace <file> write a chrome://tracing JSON of every job run to file on exit\n"
+              << "  --render-thread submit GL from a render thread while the main thread simulates the next frame\n"
+              << "  --profile <file> time CPU scopes and GPU passes, P or exit writes them to file as a Chrome trace\n"
+              << "  --headless      render into an offscreen framebuffer through EGL, no window or display needed\n"
+              << "  --size <w>x<h>  window or offscreen framebuffer size (default 800x600)\n"
+              << "  --frames <n>    quit after n frames\n"
+              << "  --screenshot <file> write the last frame to file (PPM) on exit\n"
+              << "  --bench <n>     render n frames on a fixed 60 Hz clock, print CPU/GPU frame time percentiles\n"
+              << "                  and a hash of the last frame as JSON\n"
+              << "  --bench-out <file> with --bench, write the JSON to file instead of stdout\n"
+              << "  --gl-stats      count GL calls, draws, binds, uploads and driver time (GL_TRACE builds)\n"
+              << "  --gl-record <file> log every GL call of the setup and the first frames to file (GL_TRACE builds)\n"
+              << "  --gl-record-frames <n> frames --gl-record covers (default 2)\n"
+              << "  --gl-debug <file> debug context, log the driver's debug messages (errors, performance warnings) to file\n"
+              << "  --dynamic-res <ms> render the scene at a lower resolution when its GPU time goes over ms, then upscale\n"
+              << "  --min-scale <s> with --dynamic-res, the lowest scale of the window size (default 0.5)\n"
+              << "  --sharpen <s>   with --dynamic-res, sharpen the upscale (0 off, ~0.5 noticeable)\n"
+              << "  --render-graph  draw the frame through the render graph (scene, bloom, composite), print its plan\n"
+              << "  --bloom <s>     with --render-graph, bloom strength (default 0.5, 0 culls the bloom passes)\n"
+              << "  --post <list>   post-process the scene, e.g. tonemap,grade,vignette,sharpen (implies --render-graph)\n"
+              << "  --post-unfused  with --post, one pass per effect instead of fusing them into generated shaders\n"
+              << "  --capture       read every frame back through a ring of pack buffers and hash it on a worker thread\n"
+              << "  --sync-readback read back (--capture, F12 screenshots) with a blocking glReadPixels instead\n"
+              << "  --readback-slots <n> pack buffers in the readback ring (default 3)\n"
+              << "  --record <file> write every frame to file (.y4m: YUV 4:2:0, else raw RGBA) on background threads\n"
+              << "  --record-fps <n> frame rate of --record, also the fixed simulation step (default 60)\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--mesh") == 0 && hasValue) {
+            options.meshPath = argv[++i];
+        }
+        else if (strcmp(arg, "--stress") == 0 && hasValue) {
+            options.stressCount = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--naive") == 0) {
+            options.naive = true;
+        }
+        else if (strcmp(arg, "--sprites") == 0 && hasValue) {
+            options.spriteCount = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--indirect") == 0 && hasValue) {
+            options.indirectCount = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--no-mdi") == 0) {
+            options.noMultiDraw = true;
+        }
+        else if (strcmp(arg, "--cull") == 0) {
+            options.cull = true;
+        }
+        else if (strcmp(arg, "--materials") == 0 && hasValue) {
+            options.materialCount = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--no-sort") == 0) {
+            options.noSort = true;
+        }
+        else if (strcmp(arg, "--tick-rate") == 0 && hasValue) {
+            options.tickRate = std::max(1.0, atof(argv[++i]));
+        }
+        else if (strcmp(arg, "--max-ticks") == 0 && hasValue) {
+            options.maxTicks = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--tick-stats") == 0) {
+            options.tickStats = true;
+        }
+        else if (strcmp(arg, "--swap-interval") == 0 && hasValue) {
+            options.swapInterval = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--fps") == 0 && hasValue) {
+            options.targetFps = std::max(0.0, atof(argv[++i]));
+        }
+        else if (strcmp(arg, "--frames-in-flight") == 0 && hasValue) {
+            options.framesInFlight = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "--low-latency") == 0) {
+            options.lowLatency = true;
+        }
+        else if (strcmp(arg, "--pacing-stats") == 0) {
+            options.pacingStats = true;
+        }
+        else if (strcmp(arg, "--job-trace") == 0 && hasValue) {
+            options.jobTracePath = argv[++i];
+        }
+        else if (strcmp(arg, "--render-thread") == 0) {
+            options.renderThread = true;
+        }
+        else if (strcmp(arg, "--profile") == 0 && hasValue) {
+            options.profilePath = argv[++i];
+        }
+        else if (strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        }
+        else if (strcmp(arg, "--size") == 0 && hasValue &&
+                 sscanf(argv[i + 1], "%dx%d", &options.width, &options.height) == 2 && options.width > 0 &&
+                 options.height > 0) {
+            ++i;
+        }
+        else if (strcmp(arg, "--frames") == 0 && hasValue) {
+            options.frames = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(arg, "--screenshot") == 0 && hasValue) {
+            options.screenshotPath = argv[++i];
+        }
+        else if (strcmp(arg, "--bench") == 0 && hasValue) {
+            options.benchFrames = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(arg, "--bench-out") == 0 && hasValue) {
+            options.benchOutPath = argv[++i];
+        }
+        else if (strcmp(arg, "--gl-stats") == 0) {
+            options.glStats = true;
+        }
+        else if (strcmp(arg, "--gl-record") == 0 && hasValue) {
+            options.glRecordPath = argv[++i];
+        }
+        else if (strcmp(arg, "--gl-record-frames") == 0 && hasValue) {
+            options.glRecordFrames = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(arg, "--gl-debug") == 0 && hasValue) {
+            options.glDebugPath = argv[++i];
+        }
+        else if (strcmp(arg, "--dynamic-res") == 0 && hasValue) {
+            options.dynamicResBudget = std::max(0.0, atof(argv[++i]));
+        }
+        else if (strcmp(arg, "--min-scale") == 0 && hasValue) {
+            options.minScale = (float)atof(argv[++i]);
+        }
+        else if (strcmp(arg, "--sharpen") == 0 && hasValue) {
+            options.sharpen = std::max(0.0f, (float)atof(argv[++i]));
+        }
+        else if (strcmp(arg, "--render-graph") == 0) {
+            options.renderGraph = true;
+        }
+        else if (strcmp(arg, "--bloom") == 0 && hasValue) {
+            options.bloom = std::max(0.0f, (float)atof(argv[++i]));
+        }
+        else if (strcmp(arg, "--post") == 0 && hasValue) {
+            options.postEffects = argv[++i];
+            options.renderGraph = true;
+        }
+        else if (strcmp(arg, "--post-unfused") == 0) {
+            options.postUnfused = true;
+        }
+        else if (strcmp(arg, "--capture") == 0) {
+            options.capture = true;
+        }
+        else if (strcmp(arg, "--sync-readback") == 0) {
+            options.syncReadback = true;
+        }
+        else if (strcmp(arg, "--readback-slots") == 0 && hasValue) {
+            options.readbackSlots = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(arg, "--record") == 0 && hasValue) {
+            options.recordPath = argv[++i];
+        }
+        else if (strcmp(arg, "--record-fps") == 0 && hasValue) {
+            options.recordFps = std::max(1, atoi(argv[++i]));
+        }
+        else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,228 @@
+#include "../include/utilities/post_process.h"
+#include "../include/utilities/shaders.h"
+
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// GLSL of one effect: its uniforms, a function, and the line main() calls it with. Uniform names
+// are unique across effects, so any mix of them fits in one shader.
+struct EffectCode {
+    PostEffect effect;
+    const char* name;
+    bool neighbourhood; // samples around the pixel: reads source directly, must come first in a pass
+    const char* uniforms;
+    const char* function;
+    const char* call;
+};
+
+const EffectCode kEffects[] = {
+    {PostEffect::Tonemap, "tonemap", false,
+     "uniform float exposure;\n",
+     "vec3 tonemap(vec3 c) {\n"
+     "    c *= exposure;\n"
+     "    // ACES filmic curve, Narkowicz's fit\n"
+     "    return clamp((c * (2.51 * c + 0.03)) / (c * (2.43 * c + 0.59) + 0.14), 0.0, 1.0);\n"
+     "}\n",
+     "    color = tonemap(color);\n"},
+    {PostEffect::Grade, "grade", false,
+     "uniform float contrast;\nuniform float saturation;\nuniform vec3 tint;\n",
+     "vec3 grade(vec3 c) {\n"
+     "    c = (c - 0.5) * contrast + 0.5;\n"
+     "    float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));\n"
+     "    return clamp(mix(vec3(luma), c, saturation) * tint, 0.0, 1.0);\n"
+     "}\n",
+     "    color = grade(color);\n"},
+    {PostEffect::Vignette, "vignette", false,
+     "uniform float vignetteStrength;\n",
+     "vec3 vignette(vec3 c, vec2 uv) {\n"
+     "    float d = length(uv - 0.5) * 1.4142;\n"
+     "    return c * (1.0 - vignetteStrength * smoothstep(0.4, 1.0, d));\n"
+     "}\n",
+     "    color = vignette(color, TexCoord);\n"},
+    {PostEffect::Sharpen, "sharpen", true,
+     "uniform float sharpenAmount;\n",
+     "vec3 sharpen(sampler2D image, vec2 uv) {\n"
+     "    vec2 texel = 1.0 / vec2(textureSize(image, 0));\n"
+     "    vec3 c = texture(image, uv).rgb;\n"
+     "    vec3 blur = texture(image, uv + vec2(texel.x, 0.0)).rgb + texture(image, uv - vec2(texel.x, 0.0)).rgb\n"
+     "              + texture(image, uv + vec2(0.0, texel.y)).rgb + texture(image, uv - vec2(0.0, texel.y)).rgb;\n"
+     "    return max(c + sharpenAmount * (c - blur * 0.25), 0.0);\n"
+     "}\n",
+     "    color = sharpen(source, TexCoord);\n"},
+};
+
+const EffectCode& code(PostEffect effect) {
+    for (const EffectCode& e : kEffects) {
+        if (e.effect == effect) return e;
+    }
+    return kEffects[0];
+}
+
+std::string generateShader(const std::vector<PostEffect>& effects) {
+    std::ostringstream out;
+    out << "#version 330 core\n"
+        << "// Generated by PostChain: " ;
+    for (size_t i = 0; i < effects.size(); ++i) out << (i ? " + " : "") << code(effects[i]).name;
+    out << "\nout vec4 FragColor;\nin vec2 TexCoord;\n\nuniform sampler2D source;\n";
+    for (PostEffect e : effects) out << code(e).uniforms;
+    out << "\n";
+    for (PostEffect e : effects) out << code(e).function << "\n";
+    out << "void main() {\n";
+    if (!code(effects[0]).neighbourhood) out << "    vec3 color = texture(source, TexCoord).rgb;\n";
+    else out << "    vec3 color;\n";
+    for (PostEffect e : effects) out << code(e).call;
+    out << "    FragColor = vec4(color, 1.0);\n}\n";
+    return out.str();
+}
+
+// Targets stay 16 bit float until the tone mapper is through
+size_t bytesPerPixel(bool hdr) {
+    return hdr ? 8 : 4;
+}
+
+} // namespace
+
+const char* postEffectName(PostEffect effect) {
+    return code(effect).name;
+}
+
+bool parsePostEffects(const std::string& list, std::vector<PostEffect>& effects) {
+    effects.clear();
+    std::stringstream in(list);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        bool found = false;
+        for (const EffectCode& e : kEffects) {
+            if (name != e.name) continue;
+            for (PostEffect seen : effects) {
+                if (seen == e.effect) return false;
+            }
+            effects.push_back(e.effect);
+            found = true;
+        }
+        if (!found) return false;
+    }
+    return !effects.empty();
+}
+
+PostChain::~PostChain() {
+    destroy();
+}
+
+std::vector<PostChain::Stage> PostChain::group(const std::vector<PostEffect>& effects, bool fuse) {
+    std::vector<Stage> stages;
+    for (PostEffect e : effects) {
+        if (stages.empty() || !fuse || code(e).neighbourhood) stages.push_back(Stage());
+        stages.back().effects.push_back(e);
+    }
+    for (Stage& stage : stages) {
+        stage.name = "post:";
+        for (size_t i = 0; i < stage.effects.size(); ++i) stage.name += std::string(i ? " + " : " ") + code(stage.effects[i]).name;
+    }
+    return stages;
+}
+
+bool PostChain::init(const std::vector<PostEffect>& list, const PostSettings& s, bool fuse) {
+    destroy();
+    effects = list;
+    settings = s;
+    fused = fuse;
+    stages = group(effects, fused);
+    for (Stage& stage : stages) {
+        stage.program.reset(new Shader("../assets/fullscreen_vertex.glsl", generateShader(stage.effects), stage.name));
+        setUniforms(stage);
+    }
+    glGenVertexArrays(1, &emptyVAO);
+    return !stages.empty();
+}
+
+void PostChain::destroy() {
+    stages.clear();
+    if (emptyVAO) glDeleteVertexArrays(1, &emptyVAO);
+    emptyVAO = 0;
+}
+
+void PostChain::setUniforms(Stage& stage) {
+    Shader& program = *stage.program;
+    program.activate();
+    program.setInt("source", 0);
+    for (PostEffect e : stage.effects) {
+        switch (e) {
+        case PostEffect::Tonemap:
+            program.setFloat("exposure", settings.exposure);
+            break;
+        case PostEffect::Grade:
+            program.setFloat("contrast", settings.contrast);
+            program.setFloat("saturation", settings.saturation);
+            glUniform3fv(glGetUniformLocation(program.id, "tint"), 1, settings.tint);
+            break;
+        case PostEffect::Vignette:
+            program.setFloat("vignetteStrength", settings.vignette);
+            break;
+        case PostEffect::Sharpen:
+            program.setFloat("sharpenAmount", settings.sharpen);
+            break;
+        }
+    }
+}
+
+void PostChain::addPasses(RenderGraph& graph, RGTexture input, RGTexture output, int width, int height) {
+    bool hdr = true;
+    RGTexture source = input;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        Stage& stage = stages[i];
+        for (PostEffect e : stage.effects) {
+            if (e == PostEffect::Tonemap) hdr = false;
+        }
+        RGTexture target = output;
+        if (i + 1 < stages.size()) {
+            RGTextureDesc desc;
+            desc.width = width;
+            desc.height = height;
+            desc.format = hdr ? GL_RGBA16F : GL_RGBA8;
+            target = graph.createTexture("post target", desc);
+        }
+        Shader* program = stage.program.get();
+        GLuint vao = emptyVAO;
+        graph.addPass(stage.name.c_str(), [program, vao, source](RenderGraphContext& context) {
+            program->activate();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, context.texture(source));
+            glBindVertexArray(vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }).read(source).write(target);
+        source = target;
+    }
+}
+
+PostTraffic PostChain::traffic(const std::vector<Stage>& stages, int width, int height) {
+    PostTraffic t;
+    size_t pixels = (size_t)width * height;
+    bool hdr = true;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        // The input is the scene's HDR target or the previous pass's
+        t.bytesRead += pixels * bytesPerPixel(hdr);
+        for (PostEffect e : stages[i].effects) {
+            if (e == PostEffect::Tonemap) hdr = false;
+        }
+        t.bytesWritten += pixels * (i + 1 < stages.size() ? bytesPerPixel(hdr) : 4);
+    }
+    t.passes = (int)stages.size();
+    return t;
+}
+
+PostTraffic PostChain::traffic(int width, int height) const {
+    return traffic(stages, width, height);
+}
+
+void PostChain::printPlan(std::ostream& out, int width, int height) const {
+    PostTraffic mine = traffic(width, height);
+    PostTraffic other = traffic(group(effects, !fused), width, height);
+    out << "post chain (" << (fused ? "fused" : "one pass per effect") << "): ";
+    for (size_t i = 0; i < stages.size(); ++i) out << (i ? ", " : "") << "[" << stages[i].name.substr(6) << "]";
+    out << ", " << mine.passes << " passes, " << mine.bytes() / (1024 * 1024) << " MB per frame at " << width << "x"
+        << height << " (" << (fused ? "unfused" : "fused") << ": " << other.passes << " passes, "
+        << other.bytes() / (1024 * 1024) << " MB)" << std::endl;
+}
@@ -0,0 +1,206 @@
+#include "../include/utilities/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+const uint64_t kRingSize = 1 << 15;  // events per thread, a power of two
+const int kGpuFrames = 3;
+
+struct Event {
+    const char* name;
+    double start, end;  // microseconds
+};
+
+// Written by one thread at a time, read by writeTrace()
+struct Ring {
+    std::unique_ptr<Event[]> events;  // allocated by the first event, threads that never record cost nothing
+    std::atomic<uint64_t> written{0};
+    std::string name;
+
+    void add(const char* name, double start, double end) {
+        if (!events) events.reset(new Event[kRingSize]);
+        uint64_t n = written.load(std::memory_order_relaxed);
+        Event& e = events[n & (kRingSize - 1)];
+        e.name = name;
+        e.start = start;
+        e.end = end;
+        written.store(n + 1, std::memory_order_release);
+    }
+};
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+std::mutex ringsMutex;  // guards the list, not the rings
+std::vector<std::unique_ptr<Ring> > rings;
+thread_local Ring* threadRing = nullptr;
+Ring gpuRing;
+
+Ring& currentRing() {
+    if (!threadRing) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::unique_ptr<Ring>(new Ring()));
+        threadRing = rings.back().get();
+        threadRing->name = "thread " + std::to_string(rings.size());
+    }
+    return *threadRing;
+}
+
+// GPU side, only touched by the thread that has the context
+struct GpuRange {
+    const char* name;
+    int depth;
+    GLuint begin, end;
+};
+struct GpuFrame {
+    std::vector<GLuint> queries;  // grows to what the busiest frame needed, then gets reused
+    size_t used = 0;
+    std::vector<GpuRange> ranges;
+};
+
+bool gpuReady = false;
+GpuFrame gpuFrames[kGpuFrames];
+int gpuCurrent = 0;
+std::vector<size_t> openRanges;
+double gpuOffset = 0.0;  // CPU microseconds - GPU microseconds
+std::vector<GpuTiming> gpuLast;
+int gpuDropped = 0;
+
+GLuint timestamp(GpuFrame& frame) {
+    if (frame.used == frame.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    GLuint query = frame.queries[frame.used++];
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+}
+
+void resolve(GpuFrame& frame) {
+    // Queries finish in order, if the last one is there they all are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        ++gpuDropped;
+        return;
+    }
+    gpuLast.clear();
+    for (const GpuRange& range : frame.ranges) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(range.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(range.end, GL_QUERY_RESULT, &end);
+        GpuTiming timing = {range.name, range.depth, (end - begin) * 1e-6};
+        gpuLast.push_back(timing);
+        gpuRing.add(range.name, begin * 1e-3 + gpuOffset, end * 1e-3 + gpuOffset);
+    }
+}
+
+void writeEvents(std::ostream& out, const Ring& ring, int tid) {
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\""
+        << ring.name << "\"}}";
+    uint64_t written = ring.written.load(std::memory_order_acquire);
+    if (!ring.events) return;
+    for (uint64_t n = written - std::min(written, kRingSize); n < written; ++n) {
+        const Event& e = ring.events[n & (kRingSize - 1)];
+        out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << e.start
+            << ",\"dur\":" << e.end - e.start << "}";
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Profiler::on{false};
+
+void Profiler::setEnabled(bool enabled) {
+    on = enabled;
+}
+
+double Profiler::now() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    Ring& ring = currentRing();
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    ring.name = name;
+}
+
+void Profiler::recordCpu(const char* name, double start, double end) {
+    currentRing().add(name, start, end);
+}
+
+void Profiler::initGpu() {
+    if (gpuReady || !enabled()) return;
+    // Where the GPU clock is now, to line its timestamps up with the CPU scopes
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuOffset = now() - gpuNow * 1e-3;
+    gpuRing.name = "GPU";
+    gpuReady = true;
+}
+
+void Profiler::destroyGpu() {
+    for (GpuFrame& frame : gpuFrames) {
+        if (!frame.queries.empty()) glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+        frame = GpuFrame();
+    }
+    openRanges.clear();
+    gpuReady = false;
+}
+
+void Profiler::gpuBegin(const char* name) {
+    if (!gpuReady) return;
+    GpuFrame& frame = gpuFrames[gpuCurrent];
+    GpuRange range = {name, (int)openRanges.size(), timestamp(frame), 0};
+    openRanges.push_back(frame.ranges.size());
+    frame.ranges.push_back(range);
+}
+
+void Profiler::gpuEnd() {
+    if (!gpuReady || openRanges.empty()) return;
+    GpuFrame& frame = gpuFrames[gpuCurrent];
+    frame.ranges[openRanges.back()].end = timestamp(frame);
+    openRanges.pop_back();
+}
+
+void Profiler::endFrame() {
+    if (!gpuReady) return;
+    // Close whatever is still open so the frame's ranges all have an end
+    while (!openRanges.empty()) gpuEnd();
+    gpuCurrent = (gpuCurrent + 1) % kGpuFrames;
+    GpuFrame& oldest = gpuFrames[gpuCurrent];
+    if (oldest.used > 0) resolve(oldest);
+    oldest.used = 0;
+    oldest.ranges.clear();
+}
+
+const std::vector<GpuTiming>& Profiler::lastGpuFrame() {
+    return gpuLast;
+}
+
+int Profiler::droppedGpuFrames() {
+    return gpuDropped;
+}
+
+bool Profiler::writeTrace(const char* path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cout << "Failed to write the profile " << path << std::endl;
+        return false;
+    }
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n"
+        << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"openGL_project\"}}";
+    writeEvents(out, gpuRing, 0);
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (size_t i = 0; i < rings.size(); ++i) writeEvents(out, *rings[i], (int)i + 1);
+    out << "\n]}\n";
+    return (bool)out;
+}
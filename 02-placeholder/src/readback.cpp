@@ -0,0 +1,238 @@
+#include "../include/utilities/readback.h"
+#include "../include/utilities/gl_debug.h"
+#include "../include/utilities/profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+double seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void readInto(GLuint framebuffer, int width, int height, void* pixels) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+} // namespace
+
+AsyncReadback::~AsyncReadback() {
+    destroy();
+}
+
+void AsyncReadback::init(int count, bool synchronous) {
+    destroy();
+    sync = synchronous;
+    stats = ReadbackStats();
+    latencySum = handlerSeconds = 0.0;
+    latencyCount = handlerCount = 0;
+    if (sync) return;
+    for (int i = 0; i < count; ++i) {
+        slots.emplace_back(new Slot());
+        glGenBuffers(1, &slots.back()->buffer);
+    }
+    stopping = false;
+    worker = std::thread(&AsyncReadback::workerLoop, this);
+}
+
+void AsyncReadback::destroy() {
+    flush();
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+    for (auto& slot : slots) glDeleteBuffers(1, &slot->buffer);
+    slots.clear();
+    reading.clear();
+    syncPixels.clear();
+}
+
+bool AsyncReadback::request(GLuint framebuffer, int width, int height, int frame, ReadbackHandler handler, bool wait) {
+    PROFILE_SCOPE("readback request");
+    double start = seconds();
+    ++stats.requested;
+    ReadbackFrame pixels;
+    pixels.frame = frame;
+    pixels.width = width;
+    pixels.height = height;
+    size_t bytes = (size_t)width * height * 4;
+
+    if (sync) {
+        syncPixels.resize(bytes);
+        readInto(framebuffer, width, height, syncPixels.data());
+        pixels.pixels = syncPixels.data();
+        double handlerStart = seconds();
+        handler(pixels);
+        handlerSeconds += seconds() - handlerStart;
+        ++handlerCount;
+        ++stats.handled;
+        latencyCount++;
+        stats.requestMs += (seconds() - start) * 1000.0;
+        return true;
+    }
+
+    Slot* slot = freeSlot();
+    if (!slot && wait) {
+        // Same as flush(): the frame still gets through, the render loop pays for it
+        PROFILE_SCOPE("readback wait");
+        glFlush();
+        while (!(slot = freeSlot())) {
+            poll();
+            std::this_thread::yield();
+        }
+        ++stats.waited;
+    }
+    if (!slot) {
+        ++stats.dropped;
+        return false;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    if (slot->bytes != bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        slot->bytes = bytes;
+        GLDebugLog::label(GL_BUFFER, slot->buffer, "readback");
+    }
+    // With a pack buffer bound the pointer is an offset into it, the call returns right away
+    readInto(framebuffer, width, height, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->frame = pixels;
+    slot->handler = std::move(handler);
+    slot->requestUpdate = updates;
+    slot->state.store(State::Reading, std::memory_order_release);
+    reading.push_back(slot);
+    stats.requestMs += (seconds() - start) * 1000.0;
+    return true;
+}
+
+AsyncReadback::Slot* AsyncReadback::freeSlot() {
+    for (auto& s : slots) {
+        if (s->state.load(std::memory_order_acquire) == State::Free) return s.get();
+    }
+    return nullptr;
+}
+
+void AsyncReadback::update() {
+    if (sync) return;
+    PROFILE_SCOPE("readback update");
+    double start = seconds();
+    ++updates;
+    poll();
+    stats.requestMs += (seconds() - start) * 1000.0;
+}
+
+void AsyncReadback::poll() {
+    for (auto& s : slots) {
+        Slot& slot = *s;
+        if (slot.state.load(std::memory_order_acquire) != State::Handled) continue;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        slot.handler = nullptr;
+        slot.state.store(State::Free, std::memory_order_release);
+    }
+    // Oldest request first, and nothing overtakes it: slots are reused in any order, and a newer
+    // fence can signal in the same poll as an older one, but handlers must see frames in order
+    while (!reading.empty()) {
+        Slot& slot = *reading.front();
+        // Zero timeout: only asks whether the copy is done
+        GLenum result = glClientWaitSync(slot.fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+        reading.pop_front();
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        slot.frame.pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+        latencySum += updates - slot.requestUpdate;
+        ++latencyCount;
+        if (!slot.frame.pixels) {
+            std::cout << "Failed to map a readback buffer" << std::endl;
+            slot.state.store(State::Free, std::memory_order_release);
+            continue;
+        }
+        slot.state.store(State::Mapped, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(&slot);
+        }
+        wake.notify_one();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool AsyncReadback::idle() const {
+    for (const auto& slot : slots) {
+        if (slot->state.load(std::memory_order_acquire) != State::Free) return false;
+    }
+    return true;
+}
+
+void AsyncReadback::flush() {
+    if (slots.empty()) return;
+    glFlush();
+    while (!idle()) {
+        update();
+        std::this_thread::yield();
+    }
+}
+
+void AsyncReadback::workerLoop() {
+    Profiler::setThreadName("readback");
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+        Slot* slot = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        double start = seconds();
+        {
+            PROFILE_SCOPE("readback handler");
+            slot->handler(slot->frame);
+        }
+        double elapsed = seconds() - start;
+        lock.lock();
+        handlerSeconds += elapsed;
+        ++handlerCount;
+        ++stats.handled;
+        slot->state.store(State::Handled, std::memory_order_release);
+    }
+}
+
+ReadbackStats AsyncReadback::takeStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReadbackStats result = stats;
+    result.latencyFrames = latencyCount ? latencySum / latencyCount : 0.0;
+    result.requestMs = stats.requested ? stats.requestMs / stats.requested : 0.0;
+    result.handlerMs = handlerCount ? handlerSeconds * 1000.0 / handlerCount : 0.0;
+    stats = ReadbackStats();
+    latencySum = handlerSeconds = 0.0;
+    latencyCount = handlerCount = 0;
+    return result;
+}
+
+bool writePPM(const char* path, const ReadbackFrame& frame) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", frame.width, frame.height);
+    std::vector<unsigned char> row((size_t)frame.width * 3);
+    // GL rows go bottom-up, PPM top-down
+    for (int y = frame.height - 1; y >= 0; --y) {
+        const unsigned char* src = frame.pixels + (size_t)y * frame.width * 4;
+        for (int x = 0; x < frame.width; ++x) {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,458 @@
+#include "../include/utilities/render_graph.h"
+#include "../include/utilities/gl_debug.h"
+#include "../include/utilities/profiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+struct FormatInfo {
+    GLenum internalFormat, format, type;
+    int bytesPerPixel;
+    GLenum attachment; // 0: a color attachment
+};
+
+const FormatInfo kFormats[] = {
+    {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 0},
+    {GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 0},
+    {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, 0},
+    {GL_RGBA32F, GL_RGBA, GL_FLOAT, 16, 0},
+    {GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, 4, 0},
+    {GL_RG16F, GL_RG, GL_HALF_FLOAT, 4, 0},
+    {GL_R16F, GL_RED, GL_HALF_FLOAT, 2, 0},
+    {GL_R32F, GL_RED, GL_FLOAT, 4, 0},
+    {GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 0},
+    {GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4, GL_DEPTH_ATTACHMENT},
+    {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4, GL_DEPTH_ATTACHMENT},
+    {GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4, GL_DEPTH_STENCIL_ATTACHMENT},
+};
+
+const FormatInfo& formatInfo(GLenum internalFormat) {
+    for (const FormatInfo& f : kFormats) {
+        if (f.internalFormat == internalFormat) return f;
+    }
+    return kFormats[0];
+}
+
+bool sameDesc(const RGTextureDesc& a, const RGTextureDesc& b) {
+    return a.width == b.width && a.height == b.height && a.format == b.format;
+}
+
+} // namespace
+
+GLuint RenderGraphContext::texture(RGTexture handle) const {
+    return handle.valid() ? graph->resources[handle.index].object : 0;
+}
+
+GLuint RenderGraphContext::buffer(RGBuffer handle) const {
+    return handle.valid() ? graph->resources[handle.index].object : 0;
+}
+
+RenderPassBuilder& RenderPassBuilder::read(RGTexture texture) {
+    if (texture.valid()) graph.passes[pass].reads.push_back(texture.index);
+    return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::write(RGTexture texture) {
+    if (texture.valid()) graph.passes[pass].writes.push_back(texture.index);
+    return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::read(RGBuffer buffer) {
+    if (buffer.valid()) graph.passes[pass].reads.push_back(buffer.index);
+    return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::write(RGBuffer buffer) {
+    if (buffer.valid()) graph.passes[pass].writes.push_back(buffer.index);
+    return *this;
+}
+
+RenderPassBuilder& RenderPassBuilder::keep() {
+    graph.passes[pass].kept = true;
+    return *this;
+}
+
+RenderGraph::~RenderGraph() {
+    destroy();
+}
+
+int RenderGraph::addResource(const Resource& resource) {
+    compiled = false;
+    resources.push_back(resource);
+    return (int)resources.size() - 1;
+}
+
+RGTexture RenderGraph::createTexture(const char* name, const RGTextureDesc& desc) {
+    Resource r;
+    r.name = name;
+    r.desc = desc;
+    r.bytes = (size_t)desc.width * desc.height * formatInfo(desc.format).bytesPerPixel;
+    RGTexture handle;
+    handle.index = addResource(r);
+    return handle;
+}
+
+RGBuffer RenderGraph::createBuffer(const char* name, size_t bytes) {
+    Resource r;
+    r.name = name;
+    r.isBuffer = true;
+    r.bytes = bytes;
+    RGBuffer handle;
+    handle.index = addResource(r);
+    return handle;
+}
+
+RGTexture RenderGraph::importTexture(const char* name, GLuint texture, const RGTextureDesc& desc) {
+    Resource r;
+    r.name = name;
+    r.imported = true;
+    r.desc = desc;
+    r.object = texture;
+    RGTexture handle;
+    handle.index = addResource(r);
+    return handle;
+}
+
+RGTexture RenderGraph::importFramebuffer(const char* name, GLuint framebuffer, int width, int height) {
+    Resource r;
+    r.name = name;
+    r.imported = true;
+    r.desc.width = width;
+    r.desc.height = height;
+    r.framebuffer = framebuffer;
+    RGTexture handle;
+    handle.index = addResource(r);
+    return handle;
+}
+
+RGBuffer RenderGraph::importBuffer(const char* name, GLuint buffer, size_t bytes) {
+    Resource r;
+    r.name = name;
+    r.isBuffer = true;
+    r.imported = true;
+    r.bytes = bytes;
+    r.object = buffer;
+    RGBuffer handle;
+    handle.index = addResource(r);
+    return handle;
+}
+
+RenderPassBuilder RenderGraph::addPass(const char* name, std::function<void(RenderGraphContext&)> execute) {
+    compiled = false;
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(pass);
+    return RenderPassBuilder(*this, (int)passes.size() - 1);
+}
+
+bool RenderGraph::cullAndOrder() {
+    for (Resource& r : resources) {
+        r.readers.clear();
+        r.writers.clear();
+        r.first = r.last = r.physical = -1;
+    }
+    for (int p = 0; p < (int)passes.size(); ++p) {
+        for (int r : passes[p].reads) resources[r].readers.push_back(p);
+        for (int r : passes[p].writes) resources[r].writers.push_back(p);
+    }
+
+    // Walk back from the passes whose results leave the frame
+    std::vector<int> work;
+    for (int p = 0; p < (int)passes.size(); ++p) {
+        Pass& pass = passes[p];
+        pass.culled = !pass.kept;
+        for (int r : pass.writes) {
+            if (resources[r].imported) pass.culled = false;
+        }
+        if (!pass.culled) work.push_back(p);
+    }
+    while (!work.empty()) {
+        int p = work.back();
+        work.pop_back();
+        for (int r : passes[p].reads) {
+            for (int writer : resources[r].writers) {
+                if (passes[writer].culled) {
+                    passes[writer].culled = false;
+                    work.push_back(writer);
+                }
+            }
+        }
+    }
+
+    // Writers before readers, otherwise declaration order (Kahn's algorithm, lowest index first)
+    std::vector<int> waitingOn(passes.size(), 0);
+    for (const Resource& r : resources) {
+        for (int reader : r.readers) {
+            for (int writer : r.writers) {
+                if (writer != reader && !passes[writer].culled && !passes[reader].culled) ++waitingOn[reader];
+            }
+        }
+    }
+    order.clear();
+    std::vector<bool> done(passes.size(), false);
+    int live = 0;
+    for (const Pass& pass : passes) live += pass.culled ? 0 : 1;
+    while ((int)order.size() < live) {
+        int ready = -1;
+        for (int p = 0; p < (int)passes.size() && ready < 0; ++p) {
+            if (!passes[p].culled && !done[p] && waitingOn[p] == 0) ready = p;
+        }
+        if (ready < 0) {
+            for (int p = 0; p < (int)passes.size(); ++p) {
+                if (!passes[p].culled && !done[p]) {
+                    std::cout << "Failed to order the render graph: pass " << passes[p].name
+                              << " is part of a cycle" << std::endl;
+                    break;
+                }
+            }
+            return false;
+        }
+        done[ready] = true;
+        order.push_back(ready);
+        for (int r : passes[ready].writes) {
+            for (int reader : resources[r].readers) {
+                if (reader != ready && !passes[reader].culled) --waitingOn[reader];
+            }
+        }
+    }
+
+    // Lifetimes in execution order
+    for (int i = 0; i < (int)order.size(); ++i) {
+        const Pass& pass = passes[order[i]];
+        for (int list = 0; list < 2; ++list) {
+            for (int r : list ? pass.writes : pass.reads) {
+                Resource& resource = resources[r];
+                if (resource.first < 0) resource.first = i;
+                resource.last = i;
+            }
+        }
+    }
+    return true;
+}
+
+void RenderGraph::assignPhysical() {
+    for (Physical& p : physical) {
+        p.freeAfter = -1;
+        p.used = false;
+    }
+    std::vector<int> transients;
+    for (int r = 0; r < (int)resources.size(); ++r) {
+        if (!resources[r].imported && resources[r].first >= 0) transients.push_back(r);
+    }
+    std::stable_sort(transients.begin(), transients.end(),
+                     [this](int a, int b) { return resources[a].first < resources[b].first; });
+
+    for (int r : transients) {
+        Resource& resource = resources[r];
+        int match = -1;
+        for (int p = 0; p < (int)physical.size() && match < 0; ++p) {
+            const Physical& candidate = physical[p];
+            if (candidate.isBuffer != resource.isBuffer || candidate.freeAfter >= resource.first) continue;
+            if (resource.isBuffer || sameDesc(candidate.desc, resource.desc)) match = p;
+        }
+        if (match < 0) {
+            Physical p;
+            p.isBuffer = resource.isBuffer;
+            p.desc = resource.desc;
+            physical.push_back(p);
+            match = (int)physical.size() - 1;
+        }
+        Physical& p = physical[match];
+        if (p.isBuffer && p.bytes < resource.bytes) {
+            // Regrown below
+            if (p.object) glDeleteBuffers(1, &p.object);
+            p.object = 0;
+        }
+        p.bytes = std::max(p.bytes, resource.bytes);
+        p.freeAfter = resource.last;
+        p.used = true;
+        resource.physical = match;
+    }
+
+    // Objects nothing was put on anymore go, the indices of the rest shift down
+    std::vector<int> remap(physical.size(), -1);
+    std::vector<Physical> kept;
+    for (size_t p = 0; p < physical.size(); ++p) {
+        if (physical[p].used) {
+            remap[p] = (int)kept.size();
+            kept.push_back(physical[p]);
+        }
+        else if (physical[p].object) {
+            if (physical[p].isBuffer) glDeleteBuffers(1, &physical[p].object);
+            else glDeleteTextures(1, &physical[p].object);
+        }
+    }
+    physical.swap(kept);
+    for (int r : transients) resources[r].physical = remap[resources[r].physical];
+
+    graphStats = RenderGraphStats();
+    graphStats.passes = (int)order.size();
+    graphStats.culled = (int)(passes.size() - order.size());
+    for (int r : transients) {
+        graphStats.bytesWithoutAliasing += resources[r].bytes;
+        if (resources[r].isBuffer) ++graphStats.transientBuffers;
+        else ++graphStats.transientTextures;
+    }
+    for (const Physical& p : physical) {
+        graphStats.bytesAliased += p.bytes;
+        if (p.isBuffer) ++graphStats.physicalBuffers;
+        else ++graphStats.physicalTextures;
+    }
+    for (int i = 0; i < (int)order.size(); ++i) {
+        size_t liveBytes = 0;
+        for (int r : transients) {
+            if (resources[r].first <= i && i <= resources[r].last) liveBytes += resources[r].bytes;
+        }
+        graphStats.peakLiveBytes = std::max(graphStats.peakLiveBytes, liveBytes);
+    }
+}
+
+bool RenderGraph::createObjects() {
+    for (Physical& p : physical) {
+        if (p.object) continue;
+        if (p.isBuffer) {
+            glGenBuffers(1, &p.object);
+            glBindBuffer(GL_ARRAY_BUFFER, p.object);
+            glBufferData(GL_ARRAY_BUFFER, p.bytes, nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            continue;
+        }
+        const FormatInfo& f = formatInfo(p.desc.format);
+        glGenTextures(1, &p.object);
+        glBindTexture(GL_TEXTURE_2D, p.object);
+        glTexImage2D(GL_TEXTURE_2D, 0, f.internalFormat, p.desc.width, p.desc.height, 0, f.format, f.type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    for (Resource& r : resources) {
+        if (r.imported) continue;
+        r.object = r.physical >= 0 ? physical[r.physical].object : 0;
+        // The name of the first resource put on the object
+        if (r.physical >= 0 && r.first >= 0) GLDebugLog::label(r.isBuffer ? GL_BUFFER : GL_TEXTURE, r.object, r.name);
+    }
+
+    // A framebuffer per pass out of the textures it writes
+    bool complete = true;
+    for (int p : order) {
+        Pass& pass = passes[p];
+        std::vector<GLenum> drawBuffers;
+        for (int w : pass.writes) {
+            const Resource& r = resources[w];
+            if (r.isBuffer) continue;
+            pass.width = r.desc.width;
+            pass.height = r.desc.height;
+            if (r.framebuffer || (r.imported && !r.object)) {
+                pass.framebuffer = r.framebuffer; // the caller's, possibly 0
+                pass.ownsFramebuffer = false;
+                drawBuffers.clear();
+                break;
+            }
+            if (!pass.ownsFramebuffer) {
+                glGenFramebuffers(1, &pass.framebuffer);
+                pass.ownsFramebuffer = true;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+            GLenum attachment = formatInfo(r.desc.format).attachment;
+            if (!attachment) {
+                attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+                drawBuffers.push_back(attachment);
+            }
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, r.object, 0);
+        }
+        if (!pass.ownsFramebuffer) continue;
+        if (drawBuffers.empty()) glDrawBuffer(GL_NONE);
+        else glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Failed to create the render target of pass " << pass.name << std::endl;
+            complete = false;
+        }
+        GLDebugLog::label(GL_FRAMEBUFFER, pass.framebuffer, pass.name);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+bool RenderGraph::compile() {
+    for (Pass& pass : passes) {
+        if (pass.ownsFramebuffer) glDeleteFramebuffers(1, &pass.framebuffer);
+        pass.framebuffer = 0;
+        pass.ownsFramebuffer = false;
+    }
+    compiled = false;
+    next = 0;
+    if (!cullAndOrder()) return false;
+    assignPhysical();
+    compiled = createObjects();
+    return compiled;
+}
+
+void RenderGraph::bindTarget(Pass& pass) {
+    // Passes that only touch buffers leave whatever is bound
+    if (!pass.ownsFramebuffer && pass.width == 0) return;
+    glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+    glViewport(0, 0, pass.width, pass.height);
+}
+
+bool RenderGraph::execute() {
+    if (!compiled) return false;
+    while (next < order.size()) {
+        Pass& pass = passes[order[next++]];
+        bindTarget(pass);
+        if (!pass.execute) return true;
+        RenderGraphContext context;
+        context.graph = this;
+        context.targetWidth = pass.width;
+        context.targetHeight = pass.height;
+        GpuProfileScope scope(pass.name);
+        pass.execute(context);
+    }
+    next = 0;
+    return false;
+}
+
+void RenderGraph::clear() {
+    for (Pass& pass : passes) {
+        if (pass.ownsFramebuffer) glDeleteFramebuffers(1, &pass.framebuffer);
+    }
+    passes.clear();
+    resources.clear();
+    order.clear();
+    next = 0;
+    compiled = false;
+}
+
+void RenderGraph::destroy() {
+    clear();
+    for (Physical& p : physical) {
+        if (!p.object) continue;
+        if (p.isBuffer) glDeleteBuffers(1, &p.object);
+        else glDeleteTextures(1, &p.object);
+    }
+    physical.clear();
+}
+
+void RenderGraph::printSummary(std::ostream& out) const {
+    out << "render graph: " << order.size() << " passes";
+    for (size_t i = 0; i < order.size(); ++i) out << (i ? " -> " : ": ") << passes[order[i]].name;
+    out << "\n";
+    for (const Pass& pass : passes) {
+        if (pass.culled) out << "  culled " << pass.name << " (nothing reads what it writes)\n";
+    }
+    for (const Resource& r : resources) {
+        if (r.imported || r.first < 0) continue;
+        out << "  " << r.name << ": ";
+        if (r.isBuffer) out << r.bytes / 1024 << " KB buffer";
+        else out << r.desc.width << "x" << r.desc.height << ", " << r.bytes / 1024 << " KB";
+        out << ", passes " << r.first << "-" << r.last << ", object " << r.physical << "\n";
+    }
+    out << "  render target memory: " << graphStats.bytesWithoutAliasing / 1024 << " KB in "
+        << graphStats.transientTextures + graphStats.transientBuffers << " resources without aliasing, "
+        << graphStats.bytesAliased / 1024 << " KB in " << graphStats.physicalTextures + graphStats.physicalBuffers
+        << " objects aliased (peak live " << graphStats.peakLiveBytes / 1024 << " KB)" << std::endl;
+}
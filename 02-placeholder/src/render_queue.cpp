@@ -0,0 +1,168 @@
+#include "../include/utilities/render_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+
+const uint64_t kDepthMask = (1u << 24) - 1;
+
+// Every thread waits until all of them got here, then they go on together. Reusable.
+class SpinBarrier {
+public:
+    explicit SpinBarrier(unsigned int threads) : threads(threads) {}
+
+    void wait() {
+        unsigned int gen = generation.load(std::memory_order_acquire);
+        if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == threads) {
+            arrived.store(0, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (generation.load(std::memory_order_acquire) == gen) std::this_thread::yield();
+    }
+
+private:
+    unsigned int threads;
+    std::atomic<unsigned int> arrived{0};
+    std::atomic<unsigned int> generation{0};
+};
+
+} // namespace
+
+void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch, unsigned int threads) {
+    size_t count = entries.size();
+    if (count < 2) return;
+    scratch.resize(count);
+
+    // Bits that differ somewhere; a byte with none of them would be a pass that moves nothing
+    uint64_t allOr = 0, allAnd = ~(uint64_t)0;
+    for (const SortEntry& e : entries) {
+        allOr |= e.key;
+        allAnd &= e.key;
+    }
+    uint64_t varying = allOr ^ allAnd;
+    int passes[8], passCount = 0;
+    for (int p = 0; p < 8; ++p) {
+        if ((varying >> (p * 8)) & 0xFF) passes[passCount++] = p;
+    }
+
+    // Below a few thousand entries per thread the barriers cost more than they save
+    threads = std::max(1u, std::min<unsigned int>(threads, (unsigned int)(count / 16384 + 1)));
+    std::vector<size_t> histograms(threads * 256);
+    SpinBarrier barrier(threads);
+    SortEntry* buffers[2] = {entries.data(), scratch.data()};
+
+    auto work = [&](unsigned int t) {
+        size_t begin = count * t / threads, end = count * (t + 1) / threads;
+        size_t* histogram = &histograms[t * 256];
+        for (int pass = 0; pass < passCount; ++pass) {
+            int shift = passes[pass] * 8;
+            const SortEntry* src = buffers[pass & 1];
+            SortEntry* dst = buffers[(pass & 1) ^ 1];
+
+            std::fill(histogram, histogram + 256, (size_t)0);
+            for (size_t i = begin; i < end; ++i) ++histogram[(src[i].key >> shift) & 0xFF];
+            barrier.wait();
+
+            // Where this thread's entries for each digit start: all smaller digits, then the
+            // same digit from the threads before it (that's what keeps the sort stable)
+            size_t offsets[256];
+            size_t running = 0;
+            for (unsigned int digit = 0; digit < 256; ++digit) {
+                for (unsigned int other = 0; other < threads; ++other) {
+                    if (other == t) offsets[digit] = running;
+                    running += histograms[other * 256 + digit];
+                }
+            }
+            for (size_t i = begin; i < end; ++i) dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+            // Nobody may clear their histogram for the next pass while others still read it
+            barrier.wait();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; ++t) workers.push_back(std::thread(work, t));
+    work(0);
+    for (std::thread& w : workers) w.join();
+
+    if (passCount & 1) entries.swap(scratch);
+}
+
+// ---------------------------------------------------------------------------------------------
+
+uint64_t RenderQueue::makeKey(unsigned int layer, bool translucent, unsigned int program, unsigned int material,
+                              float depth) {
+    uint64_t d = (uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * kDepthMask);
+    uint64_t key = (uint64_t)(layer & 0xF) << 60;
+    uint64_t state = ((uint64_t)(program & 0x3FF) << 16) | (material & 0xFFFF);
+    if (translucent) {
+        // far first
+        key |= (uint64_t)1 << 59;
+        key |= (kDepthMask - d) << 35;
+        key |= state << 9;
+    }
+    else {
+        key |= state << 33;
+        key |= d << 9;
+    }
+    return key;
+}
+
+void RenderQueue::clear() {
+    commands.clear();
+    order.clear();
+}
+
+void RenderQueue::add(const DrawCommand& draw, unsigned int layer, float depth) {
+    SortEntry entry = {makeKey(layer, draw.translucent, draw.program, draw.material, depth), (uint32_t)commands.size()};
+    order.push_back(entry);
+    commands.push_back(draw);
+}
+
+void RenderQueue::sort(unsigned int threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    radixSort(order, scratch, threads);
+}
+
+void RenderQueue::submit(GLStateCache& state) {
+    unsigned int program = 0;
+    GLint transformLocation = -1;
+    for (const SortEntry& entry : order) {
+        const DrawCommand& draw = commands[entry.index];
+        state.useProgram(draw.program);
+        if (draw.program != program) {
+            // Looked up once per program switch rather than once per draw
+            program = draw.program;
+            transformLocation = glGetUniformLocation(program, "transform");
+        }
+        state.setBlend(draw.translucent);
+        state.bindTexture(0, draw.textures[0]);
+        state.bindTexture(1, draw.textures[1]);
+        state.bindVertexArray(draw.vao);
+        glUniformMatrix4fv(transformLocation, 1, GL_FALSE, glm::value_ptr(draw.transform));
+        glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_INT, 0);
+    }
+}
+
+size_t RenderQueue::countStateChanges() const {
+    // Same decisions as GLStateCache, starting from nothing bound
+    size_t changes = 0;
+    const DrawCommand* previous = nullptr;
+    for (const SortEntry& entry : order) {
+        const DrawCommand& draw = commands[entry.index];
+        if (!previous) {
+            changes += 5;
+        }
+        else {
+            changes += (draw.program != previous->program) + (draw.translucent != previous->translucent) +
+                       (draw.textures[0] != previous->textures[0]) + (draw.textures[1] != previous->textures[1]) +
+                       (draw.vao != previous->vao);
+        }
+        previous = &draw;
+    }
+    return changes;
+}
@@ -0,0 +1,97 @@
+#include "../include/utilities/render_thread.h"
+#include "../include/utilities/profiler.h"
+
+#include "../include/utilities/display.h"
+
+#include <chrono>
+
+namespace {
+
+// Spins (yielding) for a little while, then naps, so an idle side doesn't burn a whole core
+template <typename Pred>
+void waitUntil(Pred ready) {
+    for (int spins = 0; !ready(); ++spins) {
+        if (spins < 256) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+} // namespace
+
+RenderThread::~RenderThread() {
+    stop();
+}
+
+void RenderThread::start(Display& target, std::function<void(const FramePacket&)> fn) {
+    if (running()) return;
+    display = &target;
+    render = fn;
+    worker = std::thread(&RenderThread::loop, this);
+}
+
+void RenderThread::stop() {
+    if (!running()) return;
+    RenderCommand quit = {RenderCommand::Quit, 0};
+    waitUntil([&]() { return commands.push(quit); });
+    worker.join();
+    display->makeCurrent(true);
+}
+
+FramePacket& RenderThread::beginFrame() {
+    if (packetBusy[current]) {
+        double start = display->time();
+        waitUntil([&]() {
+            uint32_t done;
+            while (released.pop(done)) packetBusy[done] = false;
+            return !packetBusy[current];
+        });
+        waitTime += display->time() - start;
+    }
+    return packets[current];
+}
+
+void RenderThread::submitFrame() {
+    // At most two frames are in flight and the ring holds more, but don't rely on it
+    RenderCommand draw = {RenderCommand::DrawFrame, current};
+    packetBusy[current] = true;
+    waitUntil([&]() { return commands.push(draw); });
+    current ^= 1;
+}
+
+RenderThreadStats RenderThread::takeStats() {
+    RenderThreadStats stats;
+    stats.frames = framesDrawn.exchange(0);
+    stats.submitTime = submitMicros.exchange(0) * 1e-6;
+    stats.swapTime = swapMicros.exchange(0) * 1e-6;
+    stats.waitTime = waitTime;
+    waitTime = 0.0;
+    return stats;
+}
+
+void RenderThread::loop() {
+    display->makeCurrent(true);
+    Profiler::setThreadName("render");
+    for (;;) {
+        RenderCommand command;
+        waitUntil([&]() { return commands.pop(command); });
+        if (command.type == RenderCommand::Quit) break;
+
+        double start = display->time();
+        {
+            PROFILE_SCOPE("render");
+            render(packets[command.packet]);
+        }
+        double swapStart = display->time();
+        {
+            PROFILE_SCOPE("swap");
+            display->swapBuffers();
+        }
+        submitMicros += (int64_t)((swapStart - start) * 1e6);
+        swapMicros += (int64_t)((display->time() - swapStart) * 1e6);
+        ++framesDrawn;
+
+        // released has room for both packets, so this never spins for long
+        waitUntil([&]() { return released.push(command.packet); });
+    }
+    display->makeCurrent(false);
+}
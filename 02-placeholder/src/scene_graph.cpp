@@ -0,0 +1,187 @@
+#include "../include/utilities/scene_graph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+const uint32_t SceneGraph::kNoParent;
+
+uint32_t SceneGraph::add(uint32_t parentHandle, const glm::mat4& local) {
+    uint32_t handle = (uint32_t)slotOf.size();
+    uint32_t slot = (uint32_t)parent.size();
+    slotOf.push_back(slot);
+    handleOf.push_back(handle);
+    parent.push_back(parentHandle == kNoParent ? kNoParent : slotOf[parentHandle]);
+    subtreeEnd.push_back(slot + 1);
+    localMatrix.push_back(local);
+    worldMatrix.push_back(local);
+    dirtyFlag.push_back(1);
+    changedFlag.push_back(0);
+    anyDirty = true;
+    // Appending keeps parents before children, but the new node isn't inside its parent's range
+    if (parentHandle != kNoParent) unsorted = true;
+    // A new root needs no sort, but the task plan doesn't cover it yet
+    plannedThreads = 0;
+    return handle;
+}
+
+void SceneGraph::setLocal(uint32_t node, const glm::mat4& local) {
+    uint32_t slot = slotOf[node];
+    localMatrix[slot] = local;
+    dirtyFlag[slot] = 1;
+    anyDirty = true;
+}
+
+// Reorders every array into depth-first order (roots and siblings keep their creation order)
+void SceneGraph::sortDepthFirst() {
+    size_t count = parent.size();
+
+    // Children of each slot, grouped with a counting sort on the parent
+    std::vector<uint32_t> childStart(count + 2, 0), children(count);
+    for (size_t i = 0; i < count; ++i) ++childStart[(parent[i] == kNoParent ? count : parent[i]) + 1];
+    for (size_t i = 0; i < count + 1; ++i) childStart[i + 1] += childStart[i];
+    std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) children[fill[parent[i] == kNoParent ? count : parent[i]]++] = (uint32_t)i;
+
+    // Pre-order walk; "count" stands for a virtual root above all the real ones
+    std::vector<uint32_t> order;
+    order.reserve(count);
+    std::vector<uint32_t> stack;
+    for (uint32_t c = childStart[count + 1]; c-- > childStart[count];) stack.push_back(children[c]);
+    while (!stack.empty()) {
+        uint32_t slot = stack.back();
+        stack.pop_back();
+        order.push_back(slot);
+        for (uint32_t c = childStart[slot + 1]; c-- > childStart[slot];) stack.push_back(children[c]);
+    }
+
+    std::vector<uint32_t> newSlot(count);
+    for (size_t i = 0; i < count; ++i) newSlot[order[i]] = (uint32_t)i;
+
+    std::vector<uint32_t> newParent(count), newHandle(count);
+    std::vector<glm::mat4> newLocal(count), newWorld(count);
+    std::vector<uint8_t> newDirty(count), newChanged(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t old = order[i];
+        newParent[i] = parent[old] == kNoParent ? kNoParent : newSlot[parent[old]];
+        newHandle[i] = handleOf[old];
+        newLocal[i] = localMatrix[old];
+        newWorld[i] = worldMatrix[old];
+        newDirty[i] = dirtyFlag[old];
+        newChanged[i] = changedFlag[old];
+        slotOf[handleOf[old]] = (uint32_t)i;
+    }
+    parent.swap(newParent);
+    handleOf.swap(newHandle);
+    localMatrix.swap(newLocal);
+    worldMatrix.swap(newWorld);
+    dirtyFlag.swap(newDirty);
+    changedFlag.swap(newChanged);
+
+    // Children come after their parent, so walking backwards every subtree is complete when
+    // it's folded into its parent's range
+    for (size_t i = 0; i < count; ++i) subtreeEnd[i] = (uint32_t)(i + 1);
+    for (size_t i = count; i-- > 0;) {
+        if (parent[i] != kNoParent) subtreeEnd[parent[i]] = std::max(subtreeEnd[parent[i]], subtreeEnd[i]);
+    }
+
+    unsorted = false;
+    plannedThreads = 0;
+}
+
+// Splits the nodes into subtrees of roughly count / (threads * 8) nodes. Anything bigger is
+// opened up: its root goes to topNodes and its children are split in turn.
+void SceneGraph::planTasks(unsigned int threads) {
+    topNodes.clear();
+    tasks.clear();
+    size_t grain = std::max<size_t>(1024, parent.size() / (threads * 8));
+
+    std::vector<uint32_t> stack;
+    for (size_t i = 0; i < parent.size(); i = subtreeEnd[i]) stack.push_back((uint32_t)i);
+    while (!stack.empty()) {
+        uint32_t slot = stack.back();
+        stack.pop_back();
+        if (subtreeEnd[slot] - slot <= grain) {
+            tasks.push_back(slot);
+            continue;
+        }
+        topNodes.push_back(slot);
+        for (uint32_t c = slot + 1; c < subtreeEnd[slot]; c = subtreeEnd[c]) stack.push_back(c);
+    }
+    // Ascending slot order is parent-before-child order
+    std::sort(topNodes.begin(), topNodes.end());
+    plannedThreads = threads;
+}
+
+// One pass over a contiguous range whose parents (outside the range) are already up to date
+size_t SceneGraph::updateRange(size_t begin, size_t end) {
+    size_t count = 0;
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t p = parent[i];
+        uint8_t changed = dirtyFlag[i] | (p != kNoParent ? changedFlag[p] : 0);
+        changedFlag[i] = changed;
+        if (!changed) continue;
+        dirtyFlag[i] = 0;
+        worldMatrix[i] = p != kNoParent ? worldMatrix[p] * localMatrix[i] : localMatrix[i];
+        ++count;
+    }
+    return count;
+}
+
+bool SceneGraph::beginUpdate() {
+    updated = 0;
+    if (!anyDirty) {
+        std::fill(changedFlag.begin(), changedFlag.end(), 0);
+        return false;
+    }
+    anyDirty = false;
+    if (unsorted) sortDepthFirst();
+    return true;
+}
+
+void SceneGraph::update(unsigned int threads) {
+    if (!beginUpdate()) return;
+
+    threads = std::max(1u, std::min<unsigned int>(threads, (unsigned int)(parent.size() / 4096 + 1)));
+    if (threads == 1) {
+        updated = updateRange(0, parent.size());
+        return;
+    }
+    if (plannedThreads != threads) planTasks(threads);
+
+    for (uint32_t slot : topNodes) updated += updateRange(slot, slot + 1);
+
+    // Workers grab subtrees off a shared counter
+    std::atomic<size_t> next(0), total(0);
+    auto work = [&]() {
+        size_t count = 0;
+        for (size_t t; (t = next.fetch_add(1)) < tasks.size();) count += updateRange(tasks[t], subtreeEnd[tasks[t]]);
+        total += count;
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; ++t) workers.push_back(std::thread(work));
+    work();
+    for (std::thread& w : workers) w.join();
+    updated += total;
+}
+
+void SceneGraph::update(JobSystem& jobs) {
+    if (!beginUpdate()) return;
+
+    unsigned int threads = jobs.threadCount();
+    if (threads == 1 || parent.size() < 8192) {
+        updated = updateRange(0, parent.size());
+        return;
+    }
+    if (plannedThreads != threads) planTasks(threads);
+
+    for (uint32_t slot : topNodes) updated += updateRange(slot, slot + 1);
+
+    std::atomic<size_t> total(0);
+    jobs.parallelFor("scene graph", tasks.size(), 0, [&](size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t t = begin; t < end; ++t) count += updateRange(tasks[t], subtreeEnd[tasks[t]]);
+        total += count;
+    }, 1);
+    updated += total;
+}
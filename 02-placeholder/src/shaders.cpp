@@ -1,27 +1,40 @@
 #include "../include/utilities/shaders.h"
+#include "../include/utilities/gl_debug.h"
+#include "../include/utilities/profiler.h"
 
 Shader::Shader(const char *vertexPath, const char *fragmentPath) {
-    int success;
-    char infoLog[512];
-
+    PROFILE_SCOPE("build shader");
     GLuint vertex = compileShader(vertexPath, GL_VERTEX_SHADER);
     GLuint fragment = compileShader(fragmentPath, GL_FRAGMENT_SHADER);
+    link(vertex, fragment, std::string(vertexPath) + " + " + fragmentPath);
+}
+
+Shader::Shader(const char* vertexPath, const std::string& fragmentSource, const std::string& label) {
+    PROFILE_SCOPE("build shader");
+    GLuint vertex = compileShader(vertexPath, GL_VERTEX_SHADER);
+    GLuint fragment = compileSource(fragmentSource, GL_FRAGMENT_SHADER);
+    link(vertex, fragment, label);
+}
+
+void Shader::link(GLuint vertex, GLuint fragment, const std::string& label) {
+    int success;
+    char infoLog[512];
 
     id = glCreateProgram();
     glAttachShader(id, vertex);
     glAttachShader(id, fragment);
     glLinkProgram(id);
 
-    // Check compiling status
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+    // Check linking status (of the program, not a shader)
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
+        glGetProgramInfoLog(id, 512, nullptr, infoLog);
         std::cout << "Linking error: " << infoLog << std::endl;
     }
+    GLDebugLog::label(GL_PROGRAM, id, label.c_str());
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
-
 }
 
 void Shader::activate() {
@@ -48,10 +61,14 @@ std::string Shader::loadShaderSource(const char* filename) {
 }
 
 GLuint Shader::compileShader(const char* shaderPath, GLenum shaderType) {
+    return compileSource(loadShaderSource(shaderPath), shaderType);
+}
+
+GLuint Shader::compileSource(const std::string& shaderSource, GLenum shaderType) {
+    PROFILE_SCOPE("compile shader");
     int success;
     char infoLog[512];
     GLuint ret = glCreateShader(shaderType);
-    std::string shaderSource = loadShaderSource(shaderPath);
     const GLchar* shader = shaderSource.c_str();
     glShaderSource(ret, 1, &shader, nullptr);
     glCompileShader(ret);
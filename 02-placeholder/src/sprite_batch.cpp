@@ -0,0 +1,212 @@
+#include "../include/utilities/sprite_batch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "../include/utilities/gl_debug.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SPRITE_BATCH_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+uint32_t packColor(glm::vec4 c) {
+    uint32_t r = (uint32_t)(glm::clamp(c.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(glm::clamp(c.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(glm::clamp(c.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t a = (uint32_t)(glm::clamp(c.w, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24); // byte order in memory: r, g, b, a
+}
+
+} // namespace
+
+SpriteBatch::~SpriteBatch() {
+    destroy();
+}
+
+void SpriteBatch::init(size_t maxSprites) {
+    this->maxSprites = maxSprites;
+    ringVertices = maxSprites * 4 * 3; // room for ~3 full flushes before we orphan
+    vertices.resize(maxSprites * 4);
+
+    // Quad index pattern is the same for every sprite, so it's built once
+    std::vector<unsigned int> indices(maxSprites * 6);
+    for (size_t i = 0; i < maxSprites; ++i) {
+        unsigned int base = (unsigned int)(i * 4);
+        unsigned int quad[] = {base, base + 1, base + 2, base + 3, base + 1, base + 2};
+        memcpy(&indices[i * 6], quad, sizeof(quad));
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, ringVertices * sizeof(SpriteVertex), nullptr, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, color));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, texCoord));
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    GLDebugLog::label(GL_VERTEX_ARRAY, VAO, "sprite batch");
+    GLDebugLog::label(GL_BUFFER, VBO, "sprite vertex ring");
+    GLDebugLog::label(GL_BUFFER, EBO, "sprite indices");
+}
+
+void SpriteBatch::destroy() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+}
+
+void SpriteBatch::begin(SortMode mode) {
+    this->mode = mode;
+    sprites.clear();
+    currentStats = SpriteBatchStats();
+}
+
+void SpriteBatch::draw(unsigned int program, unsigned int texture, glm::vec2 position, glm::vec2 size, float rotation,
+                       glm::vec4 uvRect, glm::vec4 color) {
+    Sprite s;
+    s.x = position.x;
+    s.y = position.y;
+    s.halfW = size.x * 0.5f;
+    s.halfH = size.y * 0.5f;
+    s.cosR = std::cos(rotation);
+    s.sinR = std::sin(rotation);
+    s.u = uvRect.x;
+    s.v = uvRect.y;
+    s.du = uvRect.z;
+    s.dv = uvRect.w;
+    s.color = packColor(color);
+    s.program = program;
+    s.texture = texture;
+    sprites.push_back(s);
+}
+
+void SpriteBatch::end(const glm::mat4& projection) {
+    // Sort key: program (16 bits) | texture (16 bits) | submission index (32 bits).
+    // The index keeps the sort stable and tells us which sprite the key belongs to.
+    keys.resize(sprites.size());
+    for (size_t i = 0; i < sprites.size(); ++i) {
+        uint64_t state = mode == SortByState
+                         ? ((uint64_t)(sprites[i].program & 0xFFFF) << 48) | ((uint64_t)(sprites[i].texture & 0xFFFF) << 32)
+                         : 0;
+        keys[i] = state | (uint64_t)i;
+    }
+    if (mode == SortByState) std::sort(keys.begin(), keys.end());
+
+    boundProgram = boundTexture = 0;
+    for (size_t first = 0; first < keys.size(); first += maxSprites) {
+        flush(&keys[first], std::min(maxSprites, keys.size() - first), projection);
+    }
+    currentStats.sprites = sprites.size();
+    lastStats = currentStats;
+    glBindVertexArray(0);
+}
+
+// The 4 corners of one sprite at once: x and y of all corners live in one SSE register each
+void SpriteBatch::transform(const Sprite& s, SpriteVertex* out) const {
+#ifdef SPRITE_BATCH_SSE
+    // corner order: bottom left, top left, bottom right, top right (like the quad in main.cpp)
+    const __m128 signX = _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+    const __m128 signY = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    __m128 lx = _mm_mul_ps(signX, _mm_set1_ps(s.halfW));
+    __m128 ly = _mm_mul_ps(signY, _mm_set1_ps(s.halfH));
+    __m128 c = _mm_set1_ps(s.cosR), sn = _mm_set1_ps(s.sinR);
+    __m128 x = _mm_add_ps(_mm_set1_ps(s.x), _mm_sub_ps(_mm_mul_ps(lx, c), _mm_mul_ps(ly, sn)));
+    __m128 y = _mm_add_ps(_mm_set1_ps(s.y), _mm_add_ps(_mm_mul_ps(lx, sn), _mm_mul_ps(ly, c)));
+    float xs[4], ys[4];
+    _mm_storeu_ps(xs, x);
+    _mm_storeu_ps(ys, y);
+#else
+    static const float signX[4] = {-1.0f, -1.0f, 1.0f, 1.0f};
+    static const float signY[4] = {-1.0f, 1.0f, -1.0f, 1.0f};
+    float xs[4], ys[4];
+    for (int i = 0; i < 4; ++i) {
+        float lx = signX[i] * s.halfW, ly = signY[i] * s.halfH;
+        xs[i] = s.x + lx * s.cosR - ly * s.sinR;
+        ys[i] = s.y + lx * s.sinR + ly * s.cosR;
+    }
+#endif
+    static const float cornerU[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    static const float cornerV[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+    for (int i = 0; i < 4; ++i) {
+        out[i].position[0] = xs[i];
+        out[i].position[1] = ys[i];
+        out[i].color = s.color;
+        out[i].texCoord[0] = s.u + cornerU[i] * s.du;
+        out[i].texCoord[1] = s.v + cornerV[i] * s.dv;
+    }
+}
+
+void SpriteBatch::flush(const uint64_t* sortedKeys, size_t count, const glm::mat4& projection) {
+    for (size_t i = 0; i < count; ++i) {
+        transform(sprites[(uint32_t)sortedKeys[i]], &vertices[i * 4]);
+    }
+
+    // Streaming VBO: append after what earlier flushes wrote, the GPU may still be reading that.
+    // When the ring is full, orphan it and start from the top.
+    size_t vertexCount = count * 4;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (ringOffset + vertexCount > ringVertices) {
+        glBufferData(GL_ARRAY_BUFFER, ringVertices * sizeof(SpriteVertex), nullptr, GL_STREAM_DRAW);
+        ringOffset = 0;
+    }
+    void* dst = glMapBufferRange(GL_ARRAY_BUFFER, ringOffset * sizeof(SpriteVertex), vertexCount * sizeof(SpriteVertex),
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst) {
+        memcpy(dst, vertices.data(), vertexCount * sizeof(SpriteVertex));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    else {
+        glBufferSubData(GL_ARRAY_BUFFER, ringOffset * sizeof(SpriteVertex), vertexCount * sizeof(SpriteVertex), vertices.data());
+    }
+    ++currentStats.flushes;
+    currentStats.vertices += vertexCount;
+
+    // One draw per run of sprites sharing program + texture
+    size_t runStart = 0;
+    while (runStart < count) {
+        const Sprite& first = sprites[(uint32_t)sortedKeys[runStart]];
+        size_t runEnd = runStart + 1;
+        while (runEnd < count) {
+            const Sprite& next = sprites[(uint32_t)sortedKeys[runEnd]];
+            if (next.program != first.program || next.texture != first.texture) break;
+            ++runEnd;
+        }
+
+        if (first.program != boundProgram) {
+            glUseProgram(first.program);
+            glUniformMatrix4fv(glGetUniformLocation(first.program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+            boundProgram = first.program;
+            ++currentStats.stateChanges;
+        }
+        if (first.texture != boundTexture) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, first.texture);
+            boundTexture = first.texture;
+            ++currentStats.stateChanges;
+        }
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)((runEnd - runStart) * 6), GL_UNSIGNED_INT, 0,
+                                 (GLint)(ringOffset + runStart * 4));
+        ++currentStats.draws;
+        runStart = runEnd;
+    }
+    ringOffset += vertexCount;
+}
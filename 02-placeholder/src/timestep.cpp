@@ -0,0 +1,43 @@
+#include "../include/utilities/timestep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+FixedTimestep::FixedTimestep(double tickRate, int maxTicksPerFrame)
+    : dt(1.0 / tickRate), maxTicks(std::max(1, maxTicksPerFrame)) {}
+
+void FixedTimestep::update(double now, const std::function<void(double)>& tick) {
+    if (lastTime < 0.0) {
+        // First frame: run one tick so there's a previous and a current state to blend
+        lastTime = now;
+        accumulator = dt;
+    }
+    double frameTime = now - lastTime;
+    lastTime = now;
+    accumulator += std::max(0.0, frameTime);
+
+    int ran = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (accumulator >= dt && ran < maxTicks) {
+        tick(dt);
+        accumulator -= dt;
+        ++ticks;
+        ++ran;
+    }
+    current.tickCpuTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (accumulator >= dt) {
+        // Spiral of death guard: keep the fraction so alpha stays meaningful, drop whole ticks
+        double dropped = accumulator - std::fmod(accumulator, dt);
+        accumulator -= dropped;
+        current.droppedTime += dropped;
+        ++current.cappedFrames;
+    }
+
+    ++current.frames;
+    current.ticks += ran;
+    current.maxTicksInFrame = std::max(current.maxTicksInFrame, ran);
+    current.maxFrameTime = std::max(current.maxFrameTime, frameTime);
+    current.elapsed += frameTime;
+}
@@ -0,0 +1,351 @@
+#include "../include/utilities/video_recorder.h"
+#include "../include/utilities/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+// SSE2 is baseline on x86-64. The conversion is a few adds and multiplies per byte and keeps up
+// with any disk on one core, so there's no AVX2 version.
+#define VIDEO_X86 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+// BT.601 limited range, the integer form everything (ffmpeg's swscale too) uses
+inline uint8_t luma(int r, int g, int b) {
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+inline uint8_t chromaBlue(int r, int g, int b) {
+    return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+inline uint8_t chromaRed(int r, int g, int b) {
+    return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// Columns [x0, width) of one pair of output rows; x0 is even
+void convertScalar(const uint8_t* row0, const uint8_t* row1, int x0, int width, uint8_t* y0, uint8_t* y1,
+                   uint8_t* u, uint8_t* v) {
+    for (int x = x0; x < width; ++x) {
+        const uint8_t* p = row0 + x * 4;
+        const uint8_t* q = row1 + x * 4;
+        y0[x] = luma(p[0], p[1], p[2]);
+        y1[x] = luma(q[0], q[1], q[2]);
+    }
+    for (int cx = x0 / 2; cx < (width + 1) / 2; ++cx) {
+        int xa = cx * 2, xb = std::min(xa + 1, width - 1);
+        int sum[3];
+        for (int c = 0; c < 3; ++c) {
+            sum[c] = (row0[xa * 4 + c] + row0[xb * 4 + c] + row1[xa * 4 + c] + row1[xb * 4 + c] + 2) >> 2;
+        }
+        u[cx] = chromaBlue(sum[0], sum[1], sum[2]);
+        v[cx] = chromaRed(sum[0], sum[1], sum[2]);
+    }
+}
+
+#ifdef VIDEO_X86
+// 8 RGBA pixels -> R, G, B in 16 bit lanes
+inline void deinterleave(const uint8_t* p, __m128i& r, __m128i& g, __m128i& b) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i lo = _mm_loadu_si128((const __m128i*)p);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(p + 16));
+    r = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask), _mm_and_si128(_mm_srli_epi32(hi, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask), _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+}
+
+// At most 56228 before the shift: fits unsigned 16 bit, hence the logical shift
+inline __m128i luma8(__m128i r, __m128i g, __m128i b) {
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+}
+
+// Sums of horizontal pairs of two rows' lanes, averaged: 16 pixels x 2 rows -> 8 chroma samples
+inline __m128i average2x2(__m128i row0lo, __m128i row0hi, __m128i row1lo, __m128i row1hi) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i lo = _mm_madd_epi16(_mm_add_epi16(row0lo, row1lo), ones);
+    __m128i hi = _mm_madd_epi16(_mm_add_epi16(row0hi, row1hi), ones);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(lo, hi), _mm_set1_epi16(2)), 2);
+}
+
+// Within +-28688 before the shift: signed 16 bit, arithmetic shift like the scalar code
+inline __m128i chroma8(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb) {
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)), _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+    c = _mm_add_epi16(c, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)), _mm_set1_epi16(128)));
+    return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+}
+
+// 16 pixels of two rows per step, returns where the scalar code takes over
+int convertSSE(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i r0lo, g0lo, b0lo, r0hi, g0hi, b0hi, r1lo, g1lo, b1lo, r1hi, g1hi, b1hi;
+        deinterleave(row0 + x * 4, r0lo, g0lo, b0lo);
+        deinterleave(row0 + x * 4 + 32, r0hi, g0hi, b0hi);
+        deinterleave(row1 + x * 4, r1lo, g1lo, b1lo);
+        deinterleave(row1 + x * 4 + 32, r1hi, g1hi, b1hi);
+        _mm_storeu_si128((__m128i*)(y0 + x), _mm_packus_epi16(luma8(r0lo, g0lo, b0lo), luma8(r0hi, g0hi, b0hi)));
+        _mm_storeu_si128((__m128i*)(y1 + x), _mm_packus_epi16(luma8(r1lo, g1lo, b1lo), luma8(r1hi, g1hi, b1hi)));
+
+        __m128i r = average2x2(r0lo, r0hi, r1lo, r1hi);
+        __m128i g = average2x2(g0lo, g0hi, g1lo, g1hi);
+        __m128i b = average2x2(b0lo, b0hi, b1lo, b1hi);
+        __m128i zero = _mm_setzero_si128();
+        _mm_storel_epi64((__m128i*)(u + x / 2), _mm_packus_epi16(chroma8(r, g, b, -38, -74, 112), zero));
+        _mm_storel_epi64((__m128i*)(v + x / 2), _mm_packus_epi16(chroma8(r, g, b, 112, -94, -18), zero));
+    }
+    return x;
+}
+#endif
+
+uint8_t* allocateAligned(size_t size) {
+#ifdef _WIN32
+    return (uint8_t*)_aligned_malloc(size, 4096);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, 4096, size) == 0 ? (uint8_t*)p : nullptr;
+#endif
+}
+
+void freeAligned(uint8_t* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+double seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char kFrameHeader[] = "FRAME\n";
+const size_t kFrameHeaderSize = sizeof(kFrameHeader) - 1;
+
+} // namespace
+
+MathPath yuvConvertPath() {
+#ifdef VIDEO_X86
+    return MathPath::SSE;
+#else
+    return MathPath::Scalar;
+#endif
+}
+
+void convertToYUV420(const uint8_t* rgba, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v, MathPath path) {
+    bool simd = false;
+#ifdef VIDEO_X86
+    simd = path != MathPath::Scalar;
+#else
+    (void)path;
+#endif
+    int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    size_t stride = (size_t)width * 4;
+    for (int cy = 0; cy < chromaHeight; ++cy) {
+        // Output top-down, GL rows bottom-up; an odd last row pairs with itself
+        int oy0 = cy * 2, oy1 = std::min(oy0 + 1, height - 1);
+        const uint8_t* row0 = rgba + (size_t)(height - 1 - oy0) * stride;
+        const uint8_t* row1 = rgba + (size_t)(height - 1 - oy1) * stride;
+        uint8_t* y0 = y + (size_t)oy0 * width;
+        uint8_t* y1 = y + (size_t)oy1 * width;
+        uint8_t* uRow = u + (size_t)cy * chromaWidth;
+        uint8_t* vRow = v + (size_t)cy * chromaWidth;
+        int x = 0;
+#ifdef VIDEO_X86
+        if (simd) x = convertSSE(row0, row1, width, y0, y1, uRow, vRow);
+#endif
+        convertScalar(row0, row1, x, width, y0, y1, uRow, vRow);
+    }
+    (void)simd;
+}
+
+VideoRecorder::~VideoRecorder() {
+    close();
+}
+
+bool VideoRecorder::open(const char* path, int w, int h, int fps) {
+    close();
+    file = fopen(path, "wb");
+    if (!file) {
+        std::cout << "Failed to create the recording " << path << std::endl;
+        return false;
+    }
+    // Every write is already one big block
+    setvbuf(file, nullptr, _IONBF, 0);
+    std::string name(path);
+    yuv = name.size() >= 4 && name.compare(name.size() - 4, 4, ".y4m") == 0;
+    width = w;
+    height = h;
+    size_t chroma = (size_t)((w + 1) / 2) * ((h + 1) / 2);
+    frameBytes = yuv ? kFrameHeaderSize + (size_t)w * h + chroma * 2 : (size_t)w * h * 4;
+
+    block = allocateAligned(kBlockSize);
+    bool allocated = block != nullptr;
+    buffers.resize(kFrameBuffers);
+    freeBuffers.clear();
+    for (Buffer& b : buffers) {
+        b.data = allocateAligned(frameBytes);
+        b.size = frameBytes;
+        freeBuffers.push_back(&b);
+        allocated = allocated && b.data;
+    }
+    if (!allocated) {
+        std::cout << "Failed to allocate the recording buffers (" << kFrameBuffers << " x "
+                  << frameBytes / (1024 * 1024) << " MB)" << std::endl;
+        releaseBuffers();
+        fclose(file);
+        file = nullptr;
+        remove(path);
+        return false;
+    }
+    blockUsed = 0;
+    totals = VideoRecorderStats();
+    lastFrame = -1;
+    writeFailed = false;
+    if (yuv) {
+        // C420jpeg: chroma sits in the middle of each 2x2 block, which is what averaging gives
+        char header[128];
+        int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps);
+        append((const uint8_t*)header, (size_t)length);
+    }
+    stopping = false;
+    writer = std::thread(&VideoRecorder::writerLoop, this);
+    return true;
+}
+
+void VideoRecorder::close() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    if (blockUsed) writeBlock(blockUsed);
+    if (fclose(file) != 0 || writeFailed) std::cout << "Failed to write the whole recording" << std::endl;
+    file = nullptr;
+    releaseBuffers();
+}
+
+void VideoRecorder::releaseBuffers() {
+    for (Buffer& b : buffers) freeAligned(b.data);
+    buffers.clear();
+    freeBuffers.clear();
+    queue.clear();
+    freeAligned(block);
+    block = nullptr;
+}
+
+void VideoRecorder::addFrame(const ReadbackFrame& frame) {
+    if (!file) return;
+    Buffer* buffer = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (frame.width != width || frame.height != height) {
+            if (!totals.wrongSize) {
+                std::cout << "Recording got a " << frame.width << "x" << frame.height << " frame, the video is "
+                          << width << "x" << height << ", skipping it" << std::endl;
+            }
+            ++totals.wrongSize;
+            return;
+        }
+        // AsyncReadback hands frames over in request order, anything else would scramble the video
+        if (frame.frame <= lastFrame) {
+            if (!totals.outOfOrder) {
+                std::cout << "Recording got frame " << frame.frame << " after " << lastFrame << ", skipping it" << std::endl;
+            }
+            ++totals.outOfOrder;
+            return;
+        }
+        lastFrame = frame.frame;
+        if (freeBuffers.empty()) ++totals.stalls;
+        bufferFree.wait(lock, [this] { return !freeBuffers.empty(); });
+        buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+    }
+
+    double start = seconds();
+    {
+        PROFILE_SCOPE("encode frame");
+        if (yuv) {
+            memcpy(buffer->data, kFrameHeader, kFrameHeaderSize);
+            uint8_t* y = buffer->data + kFrameHeaderSize;
+            uint8_t* u = y + (size_t)width * height;
+            uint8_t* v = u + (size_t)((width + 1) / 2) * ((height + 1) / 2);
+            convertToYUV420(frame.pixels, width, height, y, u, v);
+        }
+        else {
+            size_t stride = (size_t)width * 4;
+            for (int row = 0; row < height; ++row) {
+                memcpy(buffer->data + row * stride, frame.pixels + (size_t)(height - 1 - row) * stride, stride);
+            }
+        }
+    }
+    double elapsed = seconds() - start;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        totals.convertMs += elapsed * 1000.0;
+        queue.push_back(buffer);
+    }
+    wake.notify_one();
+}
+
+void VideoRecorder::writerLoop() {
+    Profiler::setThreadName("video writer");
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+        Buffer* buffer = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        double start = seconds();
+        {
+            PROFILE_SCOPE("write frame");
+            append(buffer->data, buffer->size);
+        }
+        double elapsed = seconds() - start;
+        lock.lock();
+        totals.writeMs += elapsed * 1000.0;
+        totals.bytes += buffer->size;
+        ++totals.frames;
+        freeBuffers.push_back(buffer);
+        bufferFree.notify_one();
+    }
+}
+
+void VideoRecorder::append(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t n = std::min(size, kBlockSize - blockUsed);
+        memcpy(block + blockUsed, data, n);
+        blockUsed += n;
+        data += n;
+        size -= n;
+        if (blockUsed == kBlockSize) writeBlock(kBlockSize);
+    }
+}
+
+void VideoRecorder::writeBlock(size_t size) {
+    if (fwrite(block, 1, size, file) != size) writeFailed = true;
+    blockUsed = 0;
+}
+
+VideoRecorderStats VideoRecorder::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    VideoRecorderStats result = totals;
+    if (result.frames > 0) {
+        result.convertMs /= result.frames;
+        result.writeMs /= result.frames;
+    }
+    return result;
+}